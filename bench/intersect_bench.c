@@ -0,0 +1,638 @@
+/*
+** intersect_bench.c -- Microbenchmark for the intersect_* kernels.
+**
+** Usage: make bench
+**        bench/intersect_bench [-n RAYS] [-p PASSES] [-r RUNS] [-s SEED]
+**
+** Every kernel is timed on two ray sets against one fixed primitive:
+**   coherent   - camera-like: one origin, directions through a regular
+**                grid around the primitive, so neighbouring rays take the
+**                same branches (what a primary-ray tile looks like)
+**   incoherent - random origins in a cube around the primitive and random
+**                directions (what bounced and shadow rays look like)
+**
+** The kernels are the real objects from build/intersect/, called through a
+** direct (not inlined) call per test, exactly as the renderer calls them.
+** A run is PASSES sweeps over RAYS rays, sized to stay cache-resident so
+** the numbers measure arithmetic and branching rather than memory; the
+** best of RUNS runs is reported as ns/test.
+**
+** Every ray is also checked against a reference implementation written
+** independently below (different formulation, long double), and the table
+** lists how often the kernel agrees with it: same hit/miss, same
+** front/inside code and the same t to 1e-6 relative. Disagreements are
+** split into false hits, false misses and wrong t (or front/inside code).
+** Isolated disagreements are rays that graze a surface or an EPSILON
+** threshold; anything more points at a bug.
+**
+** intersect_box tests the ray's whole line against the box (it does not
+** require the box to be in front of the origin) and the reference does the
+** same. As a culling test it may be conservative: false hits are reported
+** but do not fail the benchmark. Its counters in g_tls_stats are part of
+** its cost.
+**
+** Exit status is 1 if any kernel has false misses, or false hits where not
+** allowed, on more than 0.1% of the rays.
+*/
+
+#include "rt.h"
+
+/* The kernels use these; the renderer defines them in main.c. */
+t_stats							g_stats;
+_Thread_local t_thread_stats	g_tls_stats;
+
+typedef struct	s_lvec
+{
+	long double	x;
+	long double	y;
+	long double	z;
+}				t_lvec;
+
+/*
+** t_kernel -- One benchmarked kernel.
+**   - loop:   run the real kernel on n rays, return the number of hits
+**   - test:   run the real kernel on one ray (for the agreement check)
+**   - ref:    reference implementation: 0 miss, 1 front hit, 2 inside hit
+**   - obj:    the primitive (t_prim, t_face or t_vector[2])
+**   - target: centre of the coherent ray grid; spread: its half-width
+**   - conservative: false hits are allowed (culling tests)
+*/
+typedef struct	s_kernel
+{
+	const char	*name;
+	size_t		(*loop)(t_ray *r, size_t n, void *o);
+	int			(*test)(t_ray *r, void *o, double *t);
+	int			(*ref)(t_ray *r, void *o, long double *t);
+	void		*obj;
+	t_vector	target;
+	double		spread;
+	int			conservative;
+}				t_kernel;
+
+typedef struct	s_agree
+{
+	size_t		agree;
+	size_t		false_hits;
+	size_t		false_misses;
+	size_t		wrong_t;
+}				t_agree;
+
+/*
+** BENCH_KERNEL -- Define the timing loop and single-ray adapter for one
+** kernel: call_i is the kernel call on ray r[i] with output t, call_1 the
+** same call on ray *r with output *t. p is the object under test.
+*/
+#define BENCH_KERNEL(name, type, call_i, call_1) \
+static size_t	loop_##name(t_ray *r, size_t n, void *o) \
+{ \
+	type	*p; \
+	size_t	i; \
+	size_t	hits; \
+	double	t; \
+\
+	p = (type *)o; \
+	hits = 0; \
+	i = -1; \
+	while (++i < n) \
+		hits += (call_i) != 0; \
+	(void)t; \
+	return (hits); \
+} \
+static int		test_##name(t_ray *r, void *o, double *t) \
+{ \
+	type	*p; \
+\
+	p = (type *)o; \
+	return (call_1); \
+}
+
+BENCH_KERNEL(sphere, t_prim, intersect_sphere(&r[i], p, &t),
+	intersect_sphere(r, p, t))
+BENCH_KERNEL(hemi_sphere, t_prim, intersect_hemi_sphere(&r[i], p, &t),
+	intersect_hemi_sphere(r, p, t))
+BENCH_KERNEL(plane, t_prim, intersect_plane(&r[i], p, &t),
+	intersect_plane(r, p, t))
+BENCH_KERNEL(cylinder, t_prim, intersect_cylinder(&r[i], p, &t),
+	intersect_cylinder(r, p, t))
+BENCH_KERNEL(cone, t_prim, intersect_cone(&r[i], p, &t),
+	intersect_cone(r, p, t))
+BENCH_KERNEL(disk, t_prim, intersect_disk(&r[i], p, &t),
+	intersect_disk(r, p, t))
+BENCH_KERNEL(triangle, t_face, intersect_triangle(&r[i], p, &t),
+	intersect_triangle(r, p, t))
+BENCH_KERNEL(box, t_vector, intersect_box(&r[i], p),
+	(*t = 0, intersect_box(r, p)))
+
+/* --- long double vector helpers for the references --- */
+
+static t_lvec	lv(t_vector v)
+{
+	return ((t_lvec){v.x, v.y, v.z});
+}
+
+static t_lvec	lsub(t_lvec a, t_lvec b)
+{
+	return ((t_lvec){a.x - b.x, a.y - b.y, a.z - b.z});
+}
+
+static long double	ldot(t_lvec a, t_lvec b)
+{
+	return (a.x * b.x + a.y * b.y + a.z * b.z);
+}
+
+static t_lvec	lcross(t_lvec a, t_lvec b)
+{
+	return ((t_lvec){a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+		a.x * b.y - a.y * b.x});
+}
+
+static t_lvec	lunit(t_lvec a)
+{
+	long double	l;
+
+	l = sqrtl(ldot(a, a));
+	return ((t_lvec){a.x / l, a.y / l, a.z / l});
+}
+
+/* Point on the ray at t. */
+static t_lvec	lat(t_ray *r, long double t)
+{
+	return ((t_lvec){r->loc.x + t * r->dir.x, r->loc.y + t * r->dir.y,
+		r->loc.z + t * r->dir.z});
+}
+
+/* An orthonormal basis {u, v} perpendicular to the unit axis a. */
+static void		lbasis(t_lvec a, t_lvec *u, t_lvec *v)
+{
+	*u = lunit(lcross(a, fabsl(a.x) < 0.9L ? (t_lvec){1, 0, 0} :
+		(t_lvec){0, 1, 0}));
+	*v = lcross(a, *u);
+}
+
+/*
+** Real roots of a*t^2 + b*t + c in ascending order, using the cancellation-
+** free form q = -(b + sign(b) sqrt(disc)) / 2, roots q/a and c/q.
+*/
+static int		lquadratic(long double a, long double b, long double c,
+					long double root[2])
+{
+	long double	disc;
+	long double	q;
+	long double	s;
+
+	disc = b * b - 4.0L * a * c;
+	if (disc < 0 || a == 0)
+		return (0);
+	q = -0.5L * (b + copysignl(sqrtl(disc), b));
+	root[0] = q / a;
+	root[1] = q != 0 ? c / q : root[0];
+	if (root[0] > root[1])
+	{
+		s = root[0];
+		root[0] = root[1];
+		root[1] = s;
+	}
+	return (1);
+}
+
+/*
+** Pick the first root in front of the origin that passes keep(): 1 if it
+** is the nearer root, 2 if the farther, the same codes as the kernels.
+*/
+static int		lpick(t_ray *r, t_prim *p, long double root[2], long double *t,
+					int (*keep)(t_ray *r, t_prim *p, long double t))
+{
+	int		i;
+
+	i = -1;
+	while (++i < 2)
+		if (root[i] > EPSILON && (!keep || keep(r, p, root[i])))
+		{
+			*t = root[i];
+			return (i + 1);
+		}
+	return (0);
+}
+
+/* Axial coordinate of the hit point within [-limit, limit] (or no limit). */
+static int		keep_limit(t_ray *r, t_prim *p, long double t)
+{
+	long double	h;
+
+	h = ldot(lsub(lat(r, t), lv(p->loc)), lv(p->dir));
+	return (p->limit == -1 || fabsl(h) <= p->limit);
+}
+
+/* Hemisphere: keep the half opposite to dir. */
+static int		keep_bowl(t_ray *r, t_prim *p, long double t)
+{
+	return (ldot(lsub(lat(r, t), lv(p->loc)), lv(p->dir)) <= 0);
+}
+
+/*
+** Sphere roots by the geometric method: project the centre onto the ray
+** (tca), then step back and forth by the half-chord thc.
+*/
+static int		lsphere_roots(t_ray *r, t_prim *p, long double root[2])
+{
+	t_lvec		d;
+	t_lvec		l;
+	long double	len;
+	long double	tca;
+	long double	d2;
+
+	len = sqrtl(ldot(lv(r->dir), lv(r->dir)));
+	d = lunit(lv(r->dir));
+	l = lsub(lv(p->loc), lv(r->loc));
+	tca = ldot(l, d);
+	d2 = ldot(l, l) - tca * tca;
+	if (d2 > (long double)p->radius * p->radius)
+		return (0);
+	root[0] = (tca - sqrtl(p->radius * p->radius - d2)) / len;
+	root[1] = (tca + sqrtl(p->radius * p->radius - d2)) / len;
+	return (1);
+}
+
+static int		ref_sphere(t_ray *r, void *o, long double *t)
+{
+	long double	root[2];
+
+	if (!lsphere_roots(r, o, root))
+		return (0);
+	return (lpick(r, o, root, t, NULL));
+}
+
+static int		ref_hemi_sphere(t_ray *r, void *o, long double *t)
+{
+	long double	root[2];
+
+	if (!lsphere_roots(r, o, root))
+		return (0);
+	return (lpick(r, o, root, t, keep_bowl));
+}
+
+static int		ref_plane(t_ray *r, void *o, long double *t)
+{
+	t_prim		*p;
+	long double	den;
+
+	p = o;
+	if (!(den = ldot(lv(r->dir), lv(p->normal))))
+		return (0);
+	*t = ldot(lsub(lv(p->loc), lv(r->loc)), lv(p->normal)) / den;
+	return (*t > EPSILON);
+}
+
+/*
+** Cylinder and cone in the primitive's own frame: (x, y) across the axis
+** and h along it. Cylinder: x^2 + y^2 = r^2. Cone (both nappes):
+** (x^2 + y^2) cos^2 = h^2 sin^2.
+*/
+static int		ref_quadric(t_ray *r, t_prim *p, long double *t, int cone)
+{
+	t_lvec		u;
+	t_lvec		v;
+	t_lvec		o;
+	long double	q[3];
+	long double	root[2];
+
+	lbasis(lv(p->dir), &u, &v);
+	o = lsub(lv(r->loc), lv(p->loc));
+	o = (t_lvec){ldot(o, u), ldot(o, v), ldot(o, lv(p->dir))};
+	u = (t_lvec){ldot(lv(r->dir), u), ldot(lv(r->dir), v),
+		ldot(lv(r->dir), lv(p->dir))};
+	q[0] = u.x * u.x + u.y * u.y;
+	q[1] = 2.0L * (o.x * u.x + o.y * u.y);
+	q[2] = o.x * o.x + o.y * o.y - (long double)p->radius * p->radius;
+	if (cone)
+	{
+		v.x = (long double)p->cos_angle * p->cos_angle;
+		v.y = (long double)p->sin_angle * p->sin_angle;
+		q[0] = q[0] * v.x - u.z * u.z * v.y;
+		q[1] = q[1] * v.x - 2.0L * o.z * u.z * v.y;
+		q[2] = (o.x * o.x + o.y * o.y) * v.x - o.z * o.z * v.y;
+	}
+	if (!lquadratic(q[0], q[1], q[2], root))
+		return (0);
+	return (lpick(r, p, root, t, keep_limit));
+}
+
+static int		ref_cylinder(t_ray *r, void *o, long double *t)
+{
+	return (ref_quadric(r, o, t, 0));
+}
+
+static int		ref_cone(t_ray *r, void *o, long double *t)
+{
+	return (ref_quadric(r, o, t, 1));
+}
+
+static int		ref_disk(t_ray *r, void *o, long double *t)
+{
+	t_prim	*p;
+	t_lvec	d;
+
+	p = o;
+	if (!ref_plane(r, o, t))
+		return (0);
+	d = lsub(lat(r, *t), lv(p->loc));
+	return (ldot(d, d) <= (long double)p->radius * p->radius);
+}
+
+/*
+** Triangle: intersect the supporting plane, then require the hit point to
+** be on the inner side of all three edges (edge functions).
+*/
+static int		ref_triangle(t_ray *r, void *o, long double *t)
+{
+	t_face	*f;
+	t_lvec	v[3];
+	t_lvec	n;
+	t_lvec	h;
+	int		i;
+
+	f = o;
+	v[0] = lv(*f->v0);
+	v[1] = lv(*f->v1);
+	v[2] = lv(*f->v2);
+	n = lcross(lsub(v[1], v[0]), lsub(v[2], v[0]));
+	if (!ldot(lv(r->dir), n))
+		return (0);
+	*t = ldot(lsub(v[0], lv(r->loc)), n) / ldot(lv(r->dir), n);
+	if (*t <= EPSILON)
+		return (0);
+	h = lat(r, *t);
+	i = -1;
+	while (++i < 3)
+		if (ldot(lcross(lsub(v[(i + 1) % 3], v[i]), lsub(h, v[i])), n) < 0)
+			return (0);
+	return (1);
+}
+
+/* Box: classic slab test over the whole line, axis by axis. */
+static int		ref_box(t_ray *r, void *o, long double *t)
+{
+	t_vector	*b;
+	long double	lo;
+	long double	hi;
+	long double	s[2];
+	int			i;
+
+	b = o;
+	*t = 0;
+	lo = -INFINITY;
+	hi = INFINITY;
+	i = -1;
+	while (++i < 3)
+	{
+		s[0] = ((&b[0].x)[i] - (&r->loc.x)[i]) / (long double)(&r->dir.x)[i];
+		s[1] = ((&b[1].x)[i] - (&r->loc.x)[i]) / (long double)(&r->dir.x)[i];
+		if ((&r->dir.x)[i] == 0 && ((&r->loc.x)[i] < (&b[0].x)[i] ||
+			(&r->loc.x)[i] > (&b[1].x)[i]))
+			return (0);
+		if ((&r->dir.x)[i] == 0)
+			continue ;
+		lo = fmaxl(lo, fminl(s[0], s[1]));
+		hi = fminl(hi, fmaxl(s[0], s[1]));
+	}
+	return (lo <= hi);
+}
+
+/* --- the kernels under test --- */
+
+static t_prim		g_prim[6];
+static t_vector		g_vert[3];
+static t_face		g_face;
+static t_vector		g_box[2];
+
+static t_kernel		g_kernels[] = {
+	{"sphere", loop_sphere, test_sphere, ref_sphere, &g_prim[0],
+		{0, 0, 0}, 1.5, 0},
+	{"hemi_sphere", loop_hemi_sphere, test_hemi_sphere, ref_hemi_sphere,
+		&g_prim[1], {0, 0, 0}, 1.5, 0},
+	{"plane", loop_plane, test_plane, ref_plane, &g_prim[2],
+		{0, -1, 0}, 1.5, 0},
+	{"cylinder", loop_cylinder, test_cylinder, ref_cylinder, &g_prim[3],
+		{0, 0, 0}, 1.5, 0},
+	{"cone", loop_cone, test_cone, ref_cone, &g_prim[4], {0, 0, 0}, 1.5, 0},
+	{"disk", loop_disk, test_disk, ref_disk, &g_prim[5], {0, 0, 0}, 1.5, 0},
+	{"triangle", loop_triangle, test_triangle, ref_triangle, &g_face,
+		{0, 0, 0}, 1.5, 0},
+	{"box", loop_box, test_box, ref_box, g_box, {0, 0, 0}, 1.5, 1},
+	{NULL, NULL, NULL, NULL, NULL, {0, 0, 0}, 0, 0}};
+
+/* --- ray sets --- */
+
+/* xorshift64*: fast, seedable, identical on every platform. */
+static double	rnd(uint64_t *s)
+{
+	*s ^= *s >> 12;
+	*s ^= *s << 25;
+	*s ^= *s >> 27;
+	return ((double)((*s * 2685821657736338717ULL) >> 11) / 9007199254740992.0);
+}
+
+/* Uniform random unit vector (rejection sampling in the unit ball). */
+static t_vector	rnd_dir(uint64_t *s)
+{
+	t_vector	v;
+
+	v = (t_vector){rnd(s) * 2 - 1, rnd(s) * 2 - 1, rnd(s) * 2 - 1};
+	while (vdot(v, v) > 1 || vdot(v, v) < 1e-6)
+		v = (t_vector){rnd(s) * 2 - 1, rnd(s) * 2 - 1, rnd(s) * 2 - 1};
+	return (vunit(v));
+}
+
+/*
+** Coherent rays: from one eye point through a square grid centred on the
+** kernel's target, filled row by row so consecutive rays are neighbours.
+*/
+static void		coherent_rays(t_ray *r, size_t n, t_kernel *k)
+{
+	t_vector	eye;
+	size_t		side;
+	size_t		i;
+
+	eye = (t_vector){0.4, 0.7, -6.0};
+	side = (size_t)ceil(sqrt((double)n));
+	i = -1;
+	while (++i < n)
+	{
+		memset(&r[i], 0, sizeof(t_ray));
+		r[i].ior = 1.0;
+		r[i].loc = eye;
+		r[i].dir = vunit(vsub(vadd(k->target, (t_vector){
+			k->spread * (2.0 * (i % side) / (side - 1) - 1.0),
+			k->spread * (2.0 * (i / side) / (side - 1) - 1.0), 0}), eye));
+	}
+}
+
+/* Incoherent rays: random origins in [-3, 3]^3, random directions. */
+static void		incoherent_rays(t_ray *r, size_t n, uint64_t *seed)
+{
+	size_t	i;
+
+	i = -1;
+	while (++i < n)
+	{
+		memset(&r[i], 0, sizeof(t_ray));
+		r[i].ior = 1.0;
+		r[i].loc = (t_vector){rnd(seed) * 6 - 3, rnd(seed) * 6 - 3,
+			rnd(seed) * 6 - 3};
+		r[i].dir = rnd_dir(seed);
+	}
+}
+
+/* --- measurement --- */
+
+/* Best-of-runs nanoseconds per kernel call; *hits from the last sweep. */
+static double	time_kernel(t_kernel *k, t_ray *r, size_t n, size_t passes,
+					size_t runs, size_t *hits)
+{
+	double	best;
+	double	start;
+	double	ms;
+	size_t	p;
+
+	best = INFINITY;
+	while (runs--)
+	{
+		start = clock_ms();
+		p = -1;
+		while (++p < passes)
+			*hits = k->loop(r, n, k->obj);
+		ms = clock_ms() - start;
+		best = fmin(best, ms);
+	}
+	return (best * 1e6 / ((double)n * passes));
+}
+
+/* Compare kernel and reference on every ray. */
+static t_agree	agreement(t_kernel *k, t_ray *r, size_t n)
+{
+	t_agree		a;
+	double		t;
+	long double	tr;
+	int			got;
+	int			want;
+
+	memset(&a, 0, sizeof(t_agree));
+	while (n--)
+	{
+		t = 0;
+		tr = 0;
+		got = k->test(&r[n], k->obj, &t);
+		want = k->ref(&r[n], k->obj, &tr);
+		if (got && !want)
+			++a.false_hits;
+		else if (!got && want)
+			++a.false_misses;
+		else if (got != want || (got && fabsl(t - tr) > 1e-6L *
+			fmaxl(1.0L, fabsl(tr))))
+			++a.wrong_t;
+		else
+			++a.agree;
+	}
+	return (a);
+}
+
+/* Print one table row; returns 1 if the kernel fails the agreement check. */
+static int		report(t_kernel *k, const char *set, t_ray *r, size_t n,
+					size_t passes, size_t runs)
+{
+	t_agree	a;
+	double	ns;
+	size_t	hits;
+	size_t	bad;
+
+	hits = 0;
+	ns = time_kernel(k, r, n, passes, runs, &hits);
+	memset(&g_tls_stats, 0, sizeof(t_thread_stats));
+	a = agreement(k, r, n);
+	printf("%-12s %-11s %8.2f %7.1f%% %8.3f%% %7zu %7zu %7zu\n", k->name, set,
+		ns, 100.0 * hits / n, 100.0 * a.agree / n, a.false_hits,
+		a.false_misses, a.wrong_t);
+	bad = a.false_misses + a.wrong_t + (k->conservative ? 0 : a.false_hits);
+	return (bad * 1000 > n);
+}
+
+/* Parse -n/-p/-r/-s; anything else prints the usage and exits. */
+static void		parse_args(int ac, char **av, size_t v[4])
+{
+	const char	*flags;
+	int			i;
+
+	flags = "nprs";
+	i = 1;
+	while (i + 1 < ac && av[i][0] == '-' && av[i][1] &&
+		strchr(flags, av[i][1]) && !av[i][2] && atol(av[i + 1]) > 0)
+	{
+		v[strchr(flags, av[i][1]) - flags] = (size_t)atol(av[i + 1]);
+		i += 2;
+	}
+	if (i != ac)
+	{
+		fputs("usage: intersect_bench [-n RAYS] [-p PASSES] [-r RUNS] "
+			"[-s SEED]\n", stderr);
+		exit(2);
+	}
+}
+
+/*
+** setup_objects -- The primitives under test: each sits around the origin,
+** about two units across, with axes and normals tilted away from the
+** coordinate axes so no kernel gets an easy special case.
+*/
+static void		setup_objects(void)
+{
+	g_prim[0] = (t_prim){.radius = 1.0, .limit = -1};
+	g_prim[1] = (t_prim){.dir = {0, 0.6, 0.8}, .radius = 1.0, .limit = -1};
+	g_prim[2] = (t_prim){.loc = {0, -1, 0}, .normal = {0, 1, 0}, .limit = -1};
+	g_prim[3] = (t_prim){.dir = vunit((t_vector){0.2, 1, 0.1}), .radius = 0.7,
+		.limit = 1.2};
+	g_prim[4] = (t_prim){.dir = vunit((t_vector){0.2, 1, 0.1}),
+		.cos_angle = cos(25 * M_PI / 180), .sin_angle = sin(25 * M_PI / 180),
+		.limit = 1.2};
+	g_prim[5] = (t_prim){.normal = vunit((t_vector){0, 0.3, -1}), .radius = 1,
+		.limit = -1};
+	g_vert[0] = (t_vector){-1, -1, 0};
+	g_vert[1] = (t_vector){1, -1, 0.2};
+	g_vert[2] = (t_vector){0, 1.2, -0.1};
+	g_face = (t_face){&g_vert[0], &g_vert[1], &g_vert[2], NULL};
+	g_box[0] = (t_vector){-1, -0.8, -0.5};
+	g_box[1] = (t_vector){1, 0.9, 0.6};
+}
+
+int				main(int ac, char **av)
+{
+	t_kernel	*k;
+	t_ray		*rays;
+	size_t		v[4];
+	uint64_t	seed;
+	int			fail;
+
+	v[0] = 8192;
+	v[1] = 64;
+	v[2] = 5;
+	v[3] = 42;
+	parse_args(ac, av, v);
+	setup_objects();
+	if (!(rays = (t_ray *)malloc(v[0] * sizeof(t_ray))))
+		return (2);
+	printf("%zu rays x %zu passes, best of %zu runs, seed %zu\n\n",
+		v[0], v[1], v[2], v[3]);
+	printf("%-12s %-11s %8s %8s %9s %7s %7s %7s\n", "kernel", "rays",
+		"ns/test", "hit", "agree", "f.hits", "f.miss", "wrong_t");
+	fail = 0;
+	seed = v[3];
+	k = g_kernels - 1;
+	while ((++k)->name)
+	{
+		coherent_rays(rays, v[0], k);
+		fail |= report(k, "coherent", rays, v[0], v[1], v[2]);
+		incoherent_rays(rays, v[0], &seed);
+		fail |= report(k, "incoherent", rays, v[0], v[1], v[2]);
+	}
+	free(rays);
+	return (fail);
+}
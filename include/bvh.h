@@ -0,0 +1,61 @@
+/*
+** bvh.h -- The ray/node test shared by the BVH traversals: mesh faces
+** (intersect_object.c) and primitive batches (intersect_batch.c).
+**
+** Inline, like vec_math.h, because it runs once per node visited.
+*/
+
+#ifndef BVH_H
+# define BVH_H
+
+# include "rt.h"
+
+/*
+** bvh_slab -- Narrow the range r of ray distances inside a box to its slab
+** [b0, b1] on one axis (origin o, reciprocal direction inv). A ray
+** parallel to the slab is inside it everywhere or nowhere. Returns 0 if
+** nowhere.
+*/
+static inline int	bvh_slab(double b0, double b1, double o, double inv,
+		double r[2])
+{
+	double	t0;
+	double	t1;
+
+	if (isinf(inv))
+		return (o >= b0 && o <= b1);
+	t0 = (b0 - o) * inv;
+	t1 = (b1 - o) * inv;
+	if (t0 > t1)
+	{
+		r[0] = MAX(r[0], t1);
+		r[1] = MIN(r[1], t0);
+	}
+	else
+	{
+		r[0] = MAX(r[0], t0);
+		r[1] = MIN(r[1], t1);
+	}
+	return (1);
+}
+
+/*
+** bvh_enter -- Whether the ray (origin org, reciprocal direction inv)
+** enters node n's box before tmax. The far end is widened by a relative
+** 1e-9 so that rounding cannot cull a box the ray only grazes.
+*/
+static inline int	bvh_enter(t_bvh_node *n, t_vector org, t_vector inv,
+		double tmax)
+{
+	double	r[2];
+
+	r[0] = 0.0;
+	r[1] = tmax;
+	if (!bvh_slab(n->lo[0], n->hi[0], org.x, inv.x, r) ||
+		!bvh_slab(n->lo[1], n->hi[1], org.y, inv.y, r) ||
+		!bvh_slab(n->lo[2], n->hi[2], org.z, inv.z, r))
+		return (0);
+	return (r[0] <= r[1] + fabs(r[1]) * 1e-9);
+}
+
+#endif
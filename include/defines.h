@@ -9,6 +9,10 @@
 **   5. Hit type IDs (primitive vs. mesh face)
 **   6. Error codes (system errors < 16, format errors >= 16, usage = 32)
 **   7. Key/mode flag bitmasks (each flag occupies one unique bit position)
+**   8. Render tiling and run modes (local, distributed worker/coordinator)
+**   9. Statistics array sizes, hardware counter slots, trace ring size
+**  10. Primitive batch block size
+**  11. Mesh BVH leaf size and traversal stack depth
 */
 
 #ifndef DEFINES_H
@@ -39,9 +43,9 @@
 
 /*
 ** Primitive type IDs.
-** Each geometric primitive type has a unique integer ID used to dispatch
-** to the correct intersection routine (intersect_sphere, intersect_plane,
-** etc.) via a switch/if-else chain in the intersection code.
+** Each geometric primitive type has a unique integer ID. Primitives are
+** grouped into one batch per ID for intersection (e->batch[type]);
+** PRIM_TYPES is the number of batch slots (IDs are 1-based).
 */
 # define PRIM_SPHERE		1
 # define PRIM_PLANE			2
@@ -50,6 +54,7 @@
 # define PRIM_TRIANGLE		5
 # define PRIM_DISK			6
 # define PRIM_HEMI_SPHERE	7
+# define PRIM_TYPES			8
 
 /*
 ** Hit type IDs.
@@ -69,6 +74,7 @@
 # define FILE_OPEN_ERROR	0
 # define MALLOC_ERROR		1
 # define FREE_ERROR			2
+# define SOCKET_ERROR		3
 # define FILE_FORMAT_ERROR	16
 # define USAGE_ERROR		32
 
@@ -95,6 +101,12 @@
 # define KEY_CTRL			(1 << 10)
 # define KEY_SPACE			(1 << 11)
 # define KEY_MID_CLICK		(1 << 12)
+# define KEY_B				(1 << 14)
+
+/*
+** CAM_KEYS: the camera movement keys of middle-click mode (cam_move).
+*/
+# define CAM_KEYS	(KEY_W | KEY_S | KEY_A | KEY_D | KEY_CTRL | KEY_SPACE)
 
 /*
 ** RAY_INSIDE: flag indicating the current ray is traveling inside a
@@ -103,4 +115,186 @@
 */
 # define RAY_INSIDE			(1 << 13)
 
+/*
+** CHUNK_SIZE: edge length in pixels of the square tiles the frame is split
+** into. make_chunks renders one tile per thread; the distributed
+** coordinator hands the same tiles out to worker processes.
+*/
+# define CHUNK_SIZE			64
+
+/*
+** PRESENT_RECTS: how many tiles the window can be updated with at once
+** (src/render_thread.c). More, finished between two updates, are merged
+** into their bounding box.
+*/
+# define PRESENT_RECTS		64
+
+/*
+** FRAME_RATE: iterations per second of the event loop (src/loop.c), and
+** the default for --fps, the most frames per second it asks for. Held
+** camera keys move the camera FRAME_RATE units per second.
+*/
+# define FRAME_RATE			60
+
+/*
+** Run modes, selected on the command line (stored in e->opt.mode).
+**   RUN_LOCAL:       the normal interactive renderer.
+**   RUN_WORKER:      headless process that renders tiles for a coordinator.
+**   RUN_COORDINATOR: hands tiles to connected workers and assembles the
+**                    frame, then continues as the interactive renderer.
+*/
+# define RUN_LOCAL			0
+# define RUN_WORKER			1
+# define RUN_COORDINATOR	2
+
+/*
+** Statistics (see t_stats):
+**   STATS_PRIM_TYPES: per-type counter slots, indexed directly by PRIM_* id
+**   STATS_DEPTH_BINS: ray depth histogram bins; deeper rays land in the last
+*/
+# define STATS_PRIM_TYPES	8
+# define STATS_DEPTH_BINS	16
+
+/*
+** Hardware performance counter slots (--perf, src/perf_counters.c).
+*/
+# define PERF_CYCLES		0
+# define PERF_INSTRUCTIONS	1
+# define PERF_CACHE_MISSES	2
+# define PERF_BRANCH_MISSES	3
+# define PERF_COUNTERS		4
+
+/*
+** Trace ring capacities (--trace, src/trace.c): events a thread can hold
+** per frame before the oldest are overwritten. The thread drawing frames
+** records several events per tile (join wait, blit), a tile thread only
+** a handful.
+*/
+# define TRACE_RING_MAIN	16384
+# define TRACE_RING_SIZE	64
+
+/*
+** Primitive batches (src/intersect/intersect_batch.c): spheres and planes
+** are tested BATCH_BLOCK at a time, first a branch-free pass over the whole
+** block (which the compiler vectorises), then the few candidates that pass.
+*/
+# define BATCH_BLOCK		32
+
+/*
+** Primitive BVHs (src/bvh/prim_bvh.c): a batch with PRIM_BVH_MIN bounded
+** primitives or more gets a BVH over them. When primitives move, it is
+** refit, and rebuilt only once its SAH cost exceeds PRIM_BVH_REBUILD
+** times what it was when built.
+*/
+# define PRIM_BVH_MIN		16
+# define PRIM_BVH_REBUILD	1.5
+
+/*
+** Scene parsing (src/read_scene/scene_lexer.c): only the first
+** SCENE_WORDS words of a value are kept, which covers every attribute (a
+** vector has three). The scene arrays start with room for SCENE_GROW
+** elements and double when full.
+*/
+# define SCENE_WORDS		4
+# define SCENE_GROW			16
+
+/*
+** Scene blocks, as timed by read_scene (t_parse_times.block_ms), and the
+** initial size of the material name index (a power of two).
+*/
+# define PARSE_CAMERA		0
+# define PARSE_LIGHT		1
+# define PARSE_MATERIAL		2
+# define PARSE_PRIMITIVE	3
+# define PARSE_OBJECT		4
+# define PARSE_BLOCKS		5
+# define MAT_INDEX_SIZE		64
+
+/*
+** Mesh BVH (src/bvh/bvh_build.c): a node with at most BVH_LEAF_SIZE faces
+** becomes a leaf, as does one with at most BVH_MAX_LEAF that no split
+** improves. BVH_STACK bounds the traversal stack, and with it the tree
+** depth the builder may produce.
+**   BVH_BINS:      candidate split positions per axis, plus one
+**   BVH_COST_BOX:  SAH cost of a node's box test...
+**   BVH_COST_FACE: ...relative to a face test
+**   BVH_PAR_BINS:  faces per thread when a node is binned in parallel
+**   BVH_PAR_TASK:  faces each half needs for a subtree thread of its own
+*/
+# define BVH_LEAF_SIZE		4
+# define BVH_MAX_LEAF		16
+# define BVH_STACK			64
+# define BVH_BINS			16
+# define BVH_COST_BOX		1.0
+# define BVH_COST_FACE		1.0
+# define BVH_PAR_BINS		65536
+# define BVH_PAR_TASK		4096
+
+/*
+** BVH cache (src/bvh/bvh_cache.c): BVH_CACHE_MAGIC opens every cache
+** file. Bump BVH_CACHE_VERSION whenever the tree built for a given OBJ
+** file changes, so that older cache files stop matching.
+*/
+# define BVH_CACHE_MAGIC	"RTBVHC\0\0"
+# define BVH_CACHE_VERSION	1
+
+/*
+** Scene hot-reload (--watch, src/reload): what a reload changed in the
+** live scene, as a mask of RELOAD_* bits.
+**   RELOAD_SETTINGS:  MAXDEPTH or SUPER
+**   RELOAD_CAMERA:    the camera
+**   RELOAD_LIGHTS:    the lights
+**   RELOAD_MATERIALS: the materials
+**   RELOAD_PRIMS:     primitives moved or edited in place (batches refit)
+**   RELOAD_PRIM_SET:  primitives added, removed or retyped (batches rebuilt)
+**   RELOAD_OBJECTS:   mesh instances or their meshes
+*/
+# define RELOAD_SETTINGS	(1 << 0)
+# define RELOAD_CAMERA		(1 << 1)
+# define RELOAD_LIGHTS		(1 << 2)
+# define RELOAD_MATERIALS	(1 << 3)
+# define RELOAD_PRIMS		(1 << 4)
+# define RELOAD_PRIM_SET	(1 << 5)
+# define RELOAD_OBJECTS		(1 << 6)
+# define RELOAD_KINDS		7
+
+/*
+** Shadows kept per light for each primary sample (src/gbuffer.c), two
+** bits each, VIS_PER_WORD lights to a word:
+**   VIS_UNKNOWN: not traced since the sample's hit was
+**   VIS_LIT:     nothing between the hit and the light (in_shadow 0)
+**   VIS_BLOCKED: something opaque is (in_shadow 1)
+**   VIS_PARTIAL: only transparent objects are; traced every time
+*/
+# define VIS_UNKNOWN		0
+# define VIS_LIT			1
+# define VIS_BLOCKED		2
+# define VIS_PARTIAL		3
+# define VIS_PER_WORD		16
+
+/*
+** The edge-aware denoiser (--denoise, src/denoise.c):
+**   DENOISE_PASSES:   a-trous passes; pass k spaces its taps 2^k apart.
+**                     The noise left at a few samples per pixel is edge
+**                     aliasing a pixel or two wide: one pass removes most
+**                     of it, and wider passes blur texture and detail
+**   DENOISE_SIGMA_C:  colour distance (in [0, 1] per channel) at which a
+**                     tap's weight falls to 1/e in the first pass; the
+**                     variance halves with every pass
+**   DENOISE_SIGMA_Z:  depth difference, relative to the pixel's depth and
+**                     per pixel of tap spacing, likewise
+**   DENOISE_SIGMA_A:  albedo distance, likewise
+**   DENOISE_NORMAL_SQUARES: the normal weight is max(0, n.n') raised to
+**                     2^DENOISE_NORMAL_SQUARES
+**   DENOISE_FAR:      the depth given to the background
+**   DENOISE_MAX_THREADS: most threads a pass runs on
+*/
+# define DENOISE_PASSES			1
+# define DENOISE_SIGMA_C		0.15f
+# define DENOISE_SIGMA_Z		0.02f
+# define DENOISE_SIGMA_A		0.1f
+# define DENOISE_NORMAL_SQUARES	5
+# define DENOISE_FAR			1e6f
+# define DENOISE_MAX_THREADS	64
+
 #endif
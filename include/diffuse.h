@@ -34,6 +34,7 @@ typedef struct	s_diffuse
 {
 	t_material	*mat;		/* Material of the surface being shaded           */
 	t_light		*light;		/* Current light source being evaluated            */
+	size_t		index;		/* Its index in e->light                           */
 	t_vector	colour;		/* Accumulated RGB (uses x,y,z as r,g,b channels) */
 	t_vector	n;			/* Surface normal at hit point                     */
 	t_vector	p;			/* World-space position of the hit point           */
@@ -32,6 +32,17 @@
 ** stopx -- Right edge of this tile, clamped to image width.
 ** stopy -- Bottom edge of this tile, clamped to image height.
 ** x     -- Current x pixel position during iteration within the tile.
+** id    -- Tile index in the image's grid of tiles (slot in e->heat->tile).
+** clip  -- The region of the frame; render_chunk narrows it to the part
+**          inside this tile, the only pixels it traces.
+** g     -- The G-buffer slot of the next primary sample, or NULL when
+**          there is no G-buffer (src/gbuffer.c).
+** reuse -- The current pixel's samples are taken from the G-buffer
+**          instead of traced.
+** gen   -- Frame generation the tile belongs to; it stops early once
+**          g_frame_gen moves on.
+** m     -- The frame's t_make_chunks, told when the tile is done (NULL for
+**          tiles rendered outside draw, e.g. by a distributed worker).
 */
 typedef struct	s_chunk
 {
@@ -42,18 +53,29 @@ typedef struct	s_chunk
 	int				stopx;
 	int				stopy;
 	int				x;
+	size_t			id;
+	SDL_Rect		clip;
+	t_gsample		*g;
+	int				reuse;
+	size_t			gen;
+	struct s_make_chunks	*m;
 }				t_chunk;
 
 /*
 ** t_make_chunks: State for the chunk-spawning loop.
 **
 ** tids    -- Total number of tiles (and therefore threads) to spawn.
-**            Computed as ceil(width/64) * ceil(height/64).
+**            The tiles of the image's grid that overlap the region drawn:
+**            ceil(width/64) * ceil(height/64) for a full frame.
 ** thread  -- Index of the next thread to create / join.
 ** chunk_x -- Current tile column index in the grid (0-based).
 ** chunk_y -- Current tile row index in the grid (0-based).
 ** tid     -- Dynamically allocated array of pthread_t IDs, one per tile.
 ** c       -- Temporary pointer to the current t_chunk being constructed.
+** lock, cond, done -- Tiles finished so far; each tile thread counts
+**            itself and signals cond, so p_join wakes for every one.
+** stopped -- Some tile stopped early: the frame was cancelled.
+** rect    -- The tiles in the order they finished (the first done).
 */
 typedef struct	s_make_chunks
 {
@@ -63,6 +85,17 @@ typedef struct	s_make_chunks
 	size_t			chunk_y;
 	pthread_t		*tid;
 	t_chunk			*c;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	size_t			done;
+	int				stopped;
+	SDL_Rect		*rect;
 }				t_make_chunks;
 
+/*
+** render_chunk: render one tile synchronously on the calling thread.
+** Used by the per-tile threads in draw.c and by distributed workers.
+*/
+void			render_chunk(t_chunk *c);
+
 #endif
@@ -0,0 +1,34 @@
+/*
+** intersect_batch.h -- State of one ray's pass over the primitive batches.
+**
+** The same per-type loops serve both kinds of query:
+**   - nearest hit (intersect_scene): t, id and inter track the closest
+**     primitive found so far; hit is set once anything was found
+**   - shadow (in_shadow): every hit closer than distance scales transmit
+**     by the primitive's refract; the pass stops once transmit < EPSILON
+** inv is the reciprocal of the ray's direction, for the BVH node tests,
+** and [from, to) the run of the batch that the loops test next.
+*/
+
+#ifndef INTERSECT_BATCH_H
+# define INTERSECT_BATCH_H
+
+# include "bvh.h"
+
+typedef struct	s_batch_ray
+{
+	t_env		*e;
+	t_ray		*r;
+	t_vector	inv;
+	size_t		from;
+	size_t		to;
+	int			shadow;
+	int			hit;
+	double		t;
+	size_t		id;
+	int			inter;
+	double		distance;
+	double		transmit;
+}				t_batch_ray;
+
+#endif
@@ -0,0 +1,134 @@
+/*
+** net.h -- Wire protocol and state for distributed tile rendering.
+**
+** A coordinator (./RT --coordinator ADDR scene) listens on ADDR and splits
+** the frame into the same CHUNK_SIZE x CHUNK_SIZE tiles make_chunks uses.
+** Workers (./RT --worker ADDR scene) connect, load the scene once, and
+** render whatever tiles they are handed, streaming the pixels back. The
+** coordinator writes each returned tile into its own image surface.
+**
+** Every message starts with a fixed-size t_net_msg header. All header
+** fields and pixel values travel in network byte order.
+**
+**   NET_HELLO   worker -> coordinator   w, h = the worker's resolution
+**   NET_TILE    coordinator -> worker   id + tile rectangle to render
+**   NET_PIXELS  worker -> coordinator   id + rectangle + rays traced,
+**                                       followed by w * h uint32 pixels
+**   NET_DONE    coordinator -> worker   frame finished, worker exits
+**
+** Scheduling is dynamic: an idle worker always gets the next pending tile.
+** When a worker dies its tile goes back to the pending pool; when nothing
+** is pending, a tile that has been out much longer than the average is
+** handed to an idle worker as well, and whichever copy returns first wins.
+*/
+
+#ifndef NET_H
+# define NET_H
+
+# include "rt.h"
+
+# define NET_HELLO			1
+# define NET_TILE			2
+# define NET_PIXELS			3
+# define NET_DONE			4
+
+/* Tile states on the coordinator. */
+# define NET_TILE_PENDING	0
+# define NET_TILE_ACTIVE	1
+# define NET_TILE_DONE		2
+
+/*
+** Tuning:
+**   NET_MAX_WORKERS     simultaneous worker connections accepted
+**   NET_POLL_MS         coordinator poll() timeout between scheduling passes
+**   NET_SLOW_FACTOR     a tile out for longer than this many average tile
+**   NET_SLOW_MIN_MS     times (and at least NET_SLOW_MIN_MS) is duplicated
+**   NET_IO_TIMEOUT      seconds a half-sent message may stall a socket
+**   NET_CONNECT_RETRIES worker connection attempts, NET_POLL_MS apart
+*/
+# define NET_MAX_WORKERS	64
+# define NET_POLL_MS		100
+# define NET_SLOW_FACTOR	4.0
+# define NET_SLOW_MIN_MS	2000.0
+# define NET_IO_TIMEOUT		10
+# define NET_CONNECT_RETRIES	50
+
+/*
+** t_net_msg: message header. Only 32-bit fields, so there is no padding
+** and the struct can be sent as-is once converted to network order.
+** rays_hi/rays_lo carry the 64-bit ray count of a NET_PIXELS tile.
+*/
+typedef struct	s_net_msg
+{
+	uint32_t	type;
+	uint32_t	id;
+	int32_t		x;
+	int32_t		y;
+	int32_t		w;
+	int32_t		h;
+	uint32_t	rays_hi;
+	uint32_t	rays_lo;
+}				t_net_msg;
+
+/*
+** t_net_tile: one tile of the coordinator's frame.
+**   d      -- tile rectangle, already clamped to the image
+**   state  -- NET_TILE_PENDING, NET_TILE_ACTIVE or NET_TILE_DONE
+**   copies -- number of workers currently rendering this tile
+**   start  -- when the tile was first handed out (ms, clock_ms)
+*/
+typedef struct	s_net_tile
+{
+	SDL_Rect	d;
+	int			state;
+	int			copies;
+	double		start;
+}				t_net_tile;
+
+/*
+** t_net_worker: one connected worker.
+**   fd     -- connected socket
+**   tile   -- index of the tile it is rendering, -1 when idle
+**   start  -- when that tile was handed to this worker (ms); until it has
+**             said hello, when it connected
+**   hello  -- its NET_HELLO has been accepted; until then it gets no tiles
+*/
+typedef struct	s_net_worker
+{
+	int			fd;
+	long		tile;
+	double		start;
+	int			hello;
+}				t_net_worker;
+
+/*
+** t_coordinator: scheduling state for one distributed frame.
+**   tile_ms    -- running mean of completed tile render times (ms)
+**   buf        -- receive buffer for one tile of pixels
+*/
+typedef struct	s_coordinator
+{
+	int				listen_fd;
+	t_net_tile		*tile;
+	size_t			tiles;
+	size_t			done;
+	t_net_worker	worker[NET_MAX_WORKERS];
+	size_t			workers;
+	size_t			connected;
+	size_t			reassigned;
+	size_t			rays;
+	double			tile_ms;
+	uint32_t		*buf;
+}				t_coordinator;
+
+/*
+** src/net/net_socket.c
+*/
+int				net_listen(t_env *e, char *addr);
+int				net_connect(t_env *e, char *addr);
+void			net_tune(int fd, int timeout);
+int				net_send_msg(int fd, t_net_msg *msg, uint32_t *px, size_t n);
+int				net_recv_msg(int fd, t_net_msg *msg);
+int				net_recv_pixels(int fd, uint32_t *px, size_t n);
+
+#endif
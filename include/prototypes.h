@@ -10,6 +10,77 @@
 ** src/loop.c
 */
 void		event_loop(t_env *e);
+void		schedule_draw(t_env *e);
+void		schedule_reshade(t_env *e);
+
+/*
+** src/options.c
+*/
+void		parse_options(t_env *e, int ac, char **av);
+void		apply_options(t_env *e);
+
+/*
+** src/clock.c
+*/
+double		clock_ms(void);
+
+/*
+** src/stats.c
+*/
+void		stats_reset(void);
+void		stats_merge(void);
+void		stats_print(void);
+void		stats_write_json(t_env *e);
+
+/*
+** src/perf_counters.c
+*/
+void		perf_begin(t_perf *p);
+void		perf_end(t_perf *p);
+void		perf_print(void);
+int			perf_valid(int i);
+
+/*
+** src/trace.c
+*/
+void		trace_init(t_env *e);
+void		trace_set_main(void);
+double		trace_now(void);
+void		trace_span(const char *name, double start, int a, int b);
+void		trace_flush(void);
+void		trace_close(void);
+
+/*
+** src/heatmap.c
+*/
+void		heatmap_begin(t_env *e);
+void		heatmap_write(t_env *e);
+void		free_heatmap(t_env *e);
+
+/*
+** src/gbuffer.c
+*/
+void		gbuf_begin(t_env *e);
+void		gbuf_store(t_env *e, t_gsample *g);
+void		gbuf_load(t_env *e, t_gsample *g);
+void		gbuf_forget_light(t_env *e, size_t light);
+void		gbuf_forget_shadows(t_env *e);
+void		free_gbuf(t_env *e);
+
+/*
+** src/denoise.c
+*/
+void		denoise_begin(t_env *e);
+void		denoise_clear(t_env *e, size_t i);
+void		denoise_gather(t_env *e, size_t i);
+void		denoise_frame(t_env *e, SDL_Rect d);
+void		free_denoise(t_env *e);
+
+/*
+** src/net
+*/
+void		run_worker(t_env *e);
+void		run_coordinator(t_env *e);
 
 /*
 ** src/init_env.c
@@ -27,32 +98,68 @@ void		exit_rt(t_env *e, int code);
 ** src/read_scene
 */
 void		read_scene(char *file, t_env *e);
-void		get_primitive_attributes(t_env *e, FILE *stream);
-void		get_object_attributes(t_env *e, FILE *stream);
-size_t		get_material_number(t_env *e, char *str);
-void		get_camera_attributes(t_env *e, FILE *stream);
-void		get_light_attributes(t_env *e, FILE *stream);
-t_colour	get_colour(t_env *e, t_split_string values);
-t_vector	get_vector(t_env *e, t_split_string values);
-t_vector	get_unit_vector(t_env *e, t_split_string values);
+void		*scene_slot(t_env *e, void *a, size_t n, size_t *cap);
+void		scene_open(t_env *e, t_scene *s, char *file);
+void		scene_close(t_scene *s);
+int			scene_line(t_env *e, t_scene *s, t_token *line);
+size_t		scene_attr(t_token line, t_token *key, t_token *value);
+t_words		scene_words(t_token value);
+t_token		tok_trim(t_token t);
+int			tok_is(t_token t, const char *str);
+double		tok_double(t_token t);
+int			tok_int(t_token t);
+char		*tok_dup(t_env *e, t_token t);
+void		get_primitive_attributes(t_env *e, t_scene *s);
+void		get_object_attributes(t_env *e, t_scene *s);
+size_t		get_material_number(t_env *e, t_token str);
+void		mat_index_add(t_env *e, size_t m);
+size_t		mat_index_find(t_env *e, t_token name);
+void		free_mat_index(t_env *e);
+void		get_camera_attributes(t_env *e, t_scene *s);
+void		get_light_attributes(t_env *e, t_scene *s);
+t_colour	get_colour(t_env *e, t_words values);
+t_vector	get_vector(t_env *e, t_words values);
+t_vector	get_unit_vector(t_env *e, t_words values);
 void		get_tri(t_env *e, t_prim *o, t_split_string *values);
-void		get_material_attributes(t_env *e, FILE *stream);
-void		read_obj(t_env *e, FILE *stream);
+void		get_material_attributes(t_env *e, t_scene *s);
+char		*read_obj(t_env *e, t_mesh *o, FILE *stream);
+
+/*
+** src/reload
+*/
+void		watch_scene(t_env *e);
+void		watch_poll(t_env *e);
+void		watch_close(t_env *e);
+void		reload_scene(t_env *e);
+t_mesh		*reuse_mesh(t_env *e, const char *file);
+int			merge_scene(t_env *e, t_env *n);
 void		init_material(t_material *m);
 
 /*
 ** src/draw.c
 */
 void		draw(t_env *e, SDL_Rect draw);
-int			intersect_prim(t_env *e, t_ray *ray, size_t prim, double *t);
+void		draw_frame(t_env *e, SDL_Rect d);
+
+/*
+** src/render_thread.c
+*/
+void		render_start(t_env *e);
+void		render_request(t_env *e, SDL_Rect d);
+void		render_pause(t_env *e);
+void		render_resume(t_env *e);
+void		render_wait(t_env *e);
+void		render_publish(t_render *r, SDL_Surface *img, SDL_Rect *d);
+void		render_present(t_env *e);
+void		render_stop(t_env *e);
 
 /*
 ** src/free
 */
 void		free_light(t_light **light, size_t num_light);
 void		free_material(t_material **material, size_t num_mat);
-void		free_obj_vert(void **v, size_t num_v);
 void		free_object(t_object **obj, size_t num_obj);
+void		free_mesh(t_mesh **mesh, size_t num_mesh);
 void		free_prim(t_prim ***prim, size_t num_prim);
 
 /*
@@ -68,6 +175,39 @@ int			intersect_disk(t_ray *r, t_prim *o, double *t);
 int			intersect_triangle(t_ray *r, t_face *f, double *t);
 int			intersect_box(t_ray *r, t_vector box[2]);
 int			intersect_object(t_env *e, t_object *o, double *t);
+t_vector	face_normal(t_object *o, size_t f);
+int			occluded_object(t_object *o, t_ray *ray, double distance);
+void		build_prim_batches(t_env *e);
+void		update_prim_batches(t_env *e);
+void		free_prim_batches(t_env *e);
+t_prim		*intersect_batches(t_env *e, t_ray *r, double *t, int *inter);
+double		shadow_batches(t_env *e, t_ray *r, double distance);
+
+/*
+** src/bvh
+*/
+int			build_tree(t_bvh *t, t_bvh_ref *ref, size_t n);
+int			build_bvh(t_mesh *m);
+int			cached_bvh(t_mesh *m, const char *dir);
+void		start_bvh_builds(t_env *e);
+void		wait_bvh_builds(t_env *e);
+void		build_prim_bvh(t_env *e, t_prim_batch *b);
+int			refit_prim_bvh(t_env *e, t_prim_batch *b);
+
+/*
+** src/mesh.c
+*/
+uint32_t	oct_encode(t_vector n);
+t_vector	oct_decode(uint32_t c);
+void		mesh_report(t_env *e);
+void		bvh_report(t_mesh *m);
+
+/*
+** src/instance.c
+*/
+void		setup_instance(t_object *o);
+void		instance_ray(t_object *o, t_ray *in, t_ray *out);
+t_vector	instance_normal(t_object *o, t_vector n);
 
 /*
 ** src/save
@@ -141,24 +281,33 @@ void		click_release(t_env *e, SDL_Event event);
 ** src/user_input/grab.c
 */
 void		grab(t_env *e, SDL_Event *event);
+void		grab_apply(t_env *e);
+void		motion_merge(SDL_Event *event);
 void		m_wheel(t_env *e, SDL_Event *event);
 void		select_all(t_env *e);
 void		deselect_all(t_env *e);
 
+/*
+** src/user_input/region.c
+*/
+void		region_key(t_env *e);
+int			region_mouse(t_env *e, SDL_Event *event);
+
 /*
 ** src/user_input/cam_transforms.c
 */
 void		cam_rot(t_env *e, SDL_Event event);
-void		cam_move(t_env *e);
+void		cam_move(t_env *e, double step);
 
 /*
 ** src/export.c
 */
 void		export(t_env *e);
+void		export_ppm(t_env *e, char *path, SDL_Rect d);
 
 /*
 ** src/half_bytes.c
 */
-void		half_bytes(SDL_Surface *s);
+void		half_bytes(SDL_Surface *s, SDL_Rect d);
 
 #endif
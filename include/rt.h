@@ -33,10 +33,9 @@ typedef struct	s_split_string
 */
 #define strdel(s) do { free(*(s)); *(s) = NULL; } while (0)
 
-/* Forward declarations for utilities defined in src/nstrsplit.c and src/strtrim.c */
+/* Forward declarations for utilities defined in src/nstrsplit.c */
 t_split_string	nstrsplit(char const *s, char c);
 void			free_split(t_split_string *split);
-char			*strtrim(char const *s);
 
 /* --- Standard library and system headers --- */
 # include "SDL.h"
@@ -44,6 +43,7 @@ char			*strtrim(char const *s);
 # include <fcntl.h>
 # include <float.h>
 # include <pthread.h>
+# include <setjmp.h>
 # include <stdatomic.h>
 # include <stdio.h>
 # include <string.h>
@@ -66,4 +66,11 @@ char			*strtrim(char const *s);
 extern t_stats			g_stats;
 extern _Thread_local	t_thread_stats	g_tls_stats;
 
+/*
+** g_frame_gen: generation of the frame being drawn. Tiles take the current
+** one when they are spawned; cancelling a frame advances it, and a tile
+** whose generation is no longer current stops (src/draw.c).
+*/
+extern _Atomic size_t	g_frame_gen;
+
 #endif
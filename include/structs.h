@@ -62,10 +62,11 @@ typedef struct	s_material
 }				t_material;
 
 /*
-** t_face -- A single triangle face from an OBJ mesh.
+** t_face -- A single triangle face, as intersect_triangle takes it.
 ** Stores pointers to three vertices (v0, v1, v2) and one face normal (n).
-** Vertices point into the parent t_object's vertex array, so they are
-** shared (not duplicated) across faces that reference the same vertex.
+** Meshes do not keep their faces in this form (see t_mesh): the mesh
+** intersection builds one on the stack, in double precision, for each
+** face it tests.
 */
 typedef struct	s_face
 {
@@ -76,29 +77,132 @@ typedef struct	s_face
 }				t_face;
 
 /*
-** t_object -- A mesh object loaded from an OBJ file.
-**   - name:      object name from the OBJ file
-**   - face:      array of triangle face pointers
+** t_vec3f -- A point in single precision, as mesh vertices are stored.
+*/
+typedef struct	s_vec3f
+{
+	float		x;
+	float		y;
+	float		z;
+}				t_vec3f;
+
+/*
+** t_bvh_node -- One node of a mesh's bounding volume hierarchy, 32 bytes
+** so that two share a cache line. Nodes are stored depth-first, so an
+** inner node's left child is the next node.
+**   - lo, hi: bounds of every face below the node. The vertices are
+**             floats, so their bounds are exact in float too.
+**   - index:  leaf: first entry of the mesh's order array;
+**             inner node: index of the right child
+**   - count:  leaf: number of faces (> 0); inner node: 0
+*/
+typedef struct	s_bvh_node
+{
+	float		lo[3];
+	float		hi[3];
+	uint32_t	index;
+	uint32_t	count;
+}				t_bvh_node;
+
+/*
+** t_bvh_ref -- One item as the BVH builder sees it: its bounds, and its
+** index among the items (a mesh face, a batch slot).
+*/
+typedef struct	s_bvh_ref
+{
+	float		lo[3];
+	float		hi[3];
+	uint32_t	item;
+}				t_bvh_ref;
+
+/*
+** t_bvh -- A bounding volume hierarchy over some items (bvh_build.c).
+**   - node:   the nodes, depth-first, nodes entries
+**   - order:  item indices in leaf order; a leaf covers a run of it
+**   - sah:    SAH cost of the tree, per ray that hits the root
+*/
+typedef struct	s_bvh
+{
+	t_bvh_node	*node;
+	size_t		nodes;
+	uint32_t	*order;
+	double		sah;
+}				t_bvh;
+
+/*
+** t_mesh -- Geometry loaded from one OBJ file, shared by every OBJECT
+** that names the same file (see object_values.c). Stored compactly, in
+** flat arrays (src/mesh.c):
+**   - file:      path the OBJ file was opened with (the sharing key)
+**   - v:         vertex positions, as floats
+**   - verticies: number of vertices (note: original spelling preserved)
+**   - idx:       three vertex indices per face
+**   - n:         face normals, octahedral-encoded in 32 bits
 **   - faces:     number of faces
+**   - vnormals:  number of vertex normals the file had (for mesh_report;
+**                they are only kept as the face normals)
+**   - box[2]:    bounds of the mesh in its own (object) space
+**   - bvh:       BVH over the faces (src/bvh/bvh_build.c); its order
+**                lists face indices
+**   - mtime, bytes: modification time and size of the OBJ file when it
+**                was loaded; a scene reload reuses the mesh while they
+**                still match (src/reload/reload_scene.c)
+**   - build_ms:  how long the BVH took to build (or to load)
+**   - cache:     --bvh-cache directory, or NULL (src/bvh/bvh_cache.c)
+**   - map, map_size: the cache file bvh is mapped from, or NULL when
+**                bvh was built and its arrays malloc'd
+**   - builder:   thread building the BVH, while building is set
+**   - ready:     set (release) once bvh is complete;
+**                until then rays test every face (src/bvh/bvh_async.c)
+*/
+typedef struct	s_mesh
+{
+	char		*file;
+	t_vec3f		*v;
+	size_t		verticies;
+	uint32_t	*idx;
+	uint32_t	*n;
+	size_t		faces;
+	size_t		vnormals;
+	t_vector	box[2];
+	t_bvh		bvh;
+	struct timespec	mtime;
+	off_t		bytes;
+	double		build_ms;
+	const char	*cache;
+	void		*map;
+	size_t		map_size;
+	pthread_t	builder;
+	int			building;
+	_Atomic int	ready;
+}				t_mesh;
+
+/*
+** t_object -- One placed instance of a mesh (an OBJECT block).
+**   - name:      OBJ file path as opened (written back by save)
+**   - mesh:      the shared geometry
 **   - material:  index into the global materials array
-**   - v:         array of vertex position pointers
-**   - verticies: number of vertices (note: original spelling preserved)
-**   - vn:        array of vertex normal pointers
-**   - vnormals:  number of vertex normals
-**   - box[2]:    axis-aligned bounding box (AABB) as two corner points
+**   - loc, rot, scale: placement from LOC, ROT (degrees, applied about
+**                X, then Y, then Z) and SCALE; object space maps to the
+**                scene by p' = loc + R * (scale * p)
+**   - identity:  non-zero when the placement is the identity, so rays are
+**                used as they are instead of being transformed
+**   - m, inv:    the linear part R * S and its inverse (src/instance.c)
+**   - box[2]:    axis-aligned bounds of the placed mesh in scene space
 **                [0] = min corner, [1] = max corner. Used for fast
-**                rejection -- if a ray misses the box, skip all faces.
+**                rejection -- if a ray misses the box, skip the mesh.
 */
 typedef struct	s_object
 {
 	char		*name;
-	t_face		**face;
-	size_t		faces;
+	t_mesh		*mesh;
 	size_t		material;
-	t_vector	**v;
-	size_t		verticies;
-	t_vector	**vn;
-	size_t		vnormals;
+	t_vector	loc;
+	t_vector	rot;
+	t_vector	scale;
+	int			identity;
+	double		m[3][3];
+	double		inv[3][3];
 	t_vector	box[2];
 }				t_object;
 
@@ -197,12 +301,99 @@ typedef struct	s_light
 	double		half;
 }				t_light;
 
+/*
+** t_token -- A run of characters in the mapped scene file (a line, key,
+** value or word). Not NUL-terminated; valid until the file is unmapped
+** at the end of read_scene (src/read_scene/scene_lexer.c).
+*/
+typedef struct	s_token
+{
+	const char	*s;
+	size_t		len;
+}				t_token;
+
+/*
+** t_words -- A value split on spaces: its first SCENE_WORDS words, and
+** how many words it had in all.
+*/
+typedef struct	s_words
+{
+	t_token		word[SCENE_WORDS];
+	size_t		words;
+}				t_words;
+
+/*
+** t_scene -- The scene file while it is read.
+**   - buf, size: the file, mapped read-only
+**   - pos:       offset of the next line
+**   - *_cap:     allocated length of e's scene arrays, which grow as
+**                blocks are read; slots past the count are NULL until
+**                their block is read
+*/
+typedef struct	s_scene
+{
+	const char	*buf;
+	size_t		size;
+	size_t		pos;
+	size_t		lights_cap;
+	size_t		materials_cap;
+	size_t		prims_cap;
+	size_t		objects_cap;
+	size_t		meshes_cap;
+}				t_scene;
+
+/*
+** t_mat_index -- Hash index of the material names, so that a MATERIAL
+** reference resolves in constant time (src/read_scene/material_index.c).
+** Open addressing with linear probing; kept at most half full.
+**   - slot: per slot, the material's index + 1, or 0 for an empty slot
+**   - size: number of slots (a power of two)
+**   - used: number of slots in use
+*/
+typedef struct	s_mat_index
+{
+	size_t		*slot;
+	size_t		size;
+	size_t		used;
+}				t_mat_index;
+
+/*
+** t_parse_times -- Where read_scene spent its time, in milliseconds.
+**   - map:      opening and mapping the scene file
+**   - globals:  the global settings before the first blank line
+**   - block_ms: each kind of block, indexed by PARSE_* (OBJECT blocks
+**               include loading their OBJ files)
+**   - obj:      loading OBJ files
+**   - total:    all of read_scene
+*/
+typedef struct	s_parse_times
+{
+	double		map_ms;
+	double		globals_ms;
+	double		block_ms[PARSE_BLOCKS];
+	double		obj_ms;
+	double		total_ms;
+}				t_parse_times;
+
 /*
 ** t_stats -- Global performance counters using C11 atomics.
 ** Incremented by multiple render threads concurrently. _Atomic ensures
 ** thread-safe updates without explicit mutexes (hardware atomic operations).
 ** Useful for profiling: how many rays were cast, how many intersection
-** tests performed, etc.
+** tests performed, etc. Reset at the start of every full frame and filled
+** by stats_merge (src/stats.c) as each tile finishes.
+**
+** Beyond the ray counts:
+**   - prim_tests/prim_hits: intersection tests and hits per primitive type,
+**     indexed by PRIM_* id (PRIM_TRIANGLE counts mesh faces)
+**   - box_tests/box_rejects: AABB tests, and how many of them missed
+**   - node_visits: acceleration-structure nodes visited during traversal
+**   - shadow_early_outs: shadow rays that stopped at an opaque occluder
+**   - depth: rays traced per recursion depth (last bin collects the rest)
+**   - perf: hardware counter totals (--perf), indexed by PERF_*;
+**     perf_tiles counts the tiles each was read on, perf_errno keeps the
+**     first perf_event_open failure
+**   - *_ms: phase timings of the last frame, written by the main thread only
 */
 typedef struct	s_stats
 {
@@ -213,6 +404,21 @@ typedef struct	s_stats
 	_Atomic size_t	shadow_rays;
 	_Atomic size_t	intersection_tests;
 	_Atomic size_t	threads;
+	_Atomic size_t	prim_tests[STATS_PRIM_TYPES];
+	_Atomic size_t	prim_hits[STATS_PRIM_TYPES];
+	_Atomic size_t	box_tests;
+	_Atomic size_t	box_rejects;
+	_Atomic size_t	node_visits;
+	_Atomic size_t	shadow_early_outs;
+	_Atomic size_t	depth[STATS_DEPTH_BINS];
+	_Atomic size_t	perf[PERF_COUNTERS];
+	_Atomic size_t	perf_tiles[PERF_COUNTERS];
+	_Atomic int		perf_errno;
+	double			camera_ms;
+	double			trace_ms;
+	double			blit_ms;
+	double			frame_ms;
+	size_t			frame;
 }				t_stats;
 
 /*
@@ -220,6 +426,7 @@ typedef struct	s_stats
 ** Each thread accumulates stats locally in _Thread_local storage,
 ** avoiding the overhead of atomic operations on every single ray.
 ** These can be aggregated into g_stats at the end of a render pass.
+** Field meanings match t_stats.
 */
 typedef struct	s_thread_stats
 {
@@ -229,8 +436,319 @@ typedef struct	s_thread_stats
 	size_t	refraction_rays;
 	size_t	shadow_rays;
 	size_t	intersection_tests;
+	size_t	prim_tests[STATS_PRIM_TYPES];
+	size_t	prim_hits[STATS_PRIM_TYPES];
+	size_t	box_tests;
+	size_t	box_rejects;
+	size_t	node_visits;
+	size_t	shadow_early_outs;
+	size_t	depth[STATS_DEPTH_BINS];
 }				t_thread_stats;
 
+/*
+** t_perf -- One render thread's open perf_event file descriptors, indexed
+** by PERF_* (-1 where the counter could not be opened).
+*/
+typedef struct	s_perf
+{
+	int		fd[PERF_COUNTERS];
+}				t_perf;
+
+/*
+** t_trace_event -- One complete ("X") event in a trace ring.
+**   - name:  static string, shown as the slice label
+**   - start, end: clock_ms() timestamps
+**   - a, b:  optional integer arguments (-1 = none)
+*/
+typedef struct	s_trace_event
+{
+	const char	*name;
+	double		start;
+	double		end;
+	int			a;
+	int			b;
+}				t_trace_event;
+
+/*
+** t_trace_ring -- One thread's events since the last flush.
+**   - size:       capacity of ev
+**   - head/count: next write slot and number of valid events
+**   - dropped:    events overwritten because the ring was full
+**   - tid:        thread id in the trace (0 = main, 1 = render thread)
+**   - gen:        frame generation the ring belongs to
+*/
+typedef struct	s_trace_ring
+{
+	size_t				size;
+	size_t				head;
+	size_t				count;
+	size_t				dropped;
+	int					tid;
+	size_t				gen;
+	struct s_trace_ring	*next;
+	t_trace_event		ev[];
+}				t_trace_ring;
+
+/*
+** t_options -- Command-line options (parsed by src/options.c).
+**   - mode:     RUN_LOCAL, RUN_WORKER or RUN_COORDINATOR (see defines.h)
+**   - headless: non-zero when no SDL window should be created
+**   - addr:     socket address for the distributed modes: "unix:/path",
+**               "host:port", or a bare "port" (the coordinator listens on
+**               every interface, a worker connects to localhost)
+**   - heatmap:  output prefix for per-frame cost heatmaps, or NULL
+**   - stats:    file that gets one JSON stats document per frame, or NULL
+**   - perf:     non-zero to read hardware performance counters per tile
+**   - trace:    Chrome trace-event output file, or NULL
+**   - output:   render one frame headlessly into this PPM and exit, or NULL
+**   - bvh_cache: directory of the on-disk mesh BVH cache, or NULL
+**   - watch:    non-zero to reload the scene whenever its file changes
+**   - crop:     the only part of the image to render (--crop); w is 0
+**               when the whole image is
+**   - denoise:  non-zero to smooth every full frame (src/denoise.c)
+**   - fps:      most frames per second drawn for interactive input
+**   - width, height, super, maxdepth: overrides for the scene's RENDER,
+**               SUPER and MAXDEPTH settings (0 = use the scene's value)
+*/
+typedef struct	s_options
+{
+	int			mode;
+	int			headless;
+	char		*addr;
+	char		*heatmap;
+	char		*stats;
+	int			perf;
+	char		*trace;
+	char		*output;
+	char		*bvh_cache;
+	int			watch;
+	SDL_Rect	crop;
+	int			denoise;
+	int			fps;
+	int			width;
+	int			height;
+	int			super;
+	int			maxdepth;
+}				t_options;
+
+/*
+** t_heat_tile -- Render cost of one CHUNK_SIZE tile.
+**   - d:     tile rectangle, clamped to the image
+**   - ms:    wall time its thread spent rendering it
+**   - rays:  rays traced (all kinds) inside the tile
+**   - tests: intersection tests performed inside the tile
+*/
+typedef struct	s_heat_tile
+{
+	SDL_Rect	d;
+	double		ms;
+	size_t		rays;
+	size_t		tests;
+}				t_heat_tile;
+
+/*
+** t_heatmap -- Per-frame cost buffers, allocated only with --heatmap.
+**   - rays, tests: one counter per pixel (row-major, e->x * e->y)
+**   - tile:        one entry per tile, in make_chunks order
+**   - tiles:       number of entries in tile
+** Each render thread writes only its own pixels and tile slot, so the
+** buffers are shared between thread copies of t_env without locking.
+*/
+typedef struct	s_heatmap
+{
+	uint32_t	*rays;
+	uint32_t	*tests;
+	t_heat_tile	*tile;
+	size_t		tiles;
+}				t_heatmap;
+
+/*
+** t_gsample -- One primary sample's hit, as intersect_scene left it
+** (src/gbuffer.c).
+**   - t:          distance to the hit, INFINITY for a miss
+**   - p_hit:      the nearest primitive hit, NULL for none
+**   - object_hit: the mesh object hit, if the nearest hit is a face
+**   - face:       that face's index in the object's mesh
+**   - hit_type:   PRIMITIVE, FACE or 0
+**   - inter:      the ray's inter (which side of the primitive was hit)
+*/
+typedef struct	s_gsample
+{
+	double		t;
+	t_prim		*p_hit;
+	t_object	*object_hit;
+	uint32_t	face;
+	uint8_t		hit_type;
+	uint8_t		inter;
+}				t_gsample;
+
+/*
+** t_gbuf -- The primary hits of the last frames traced, kept with --watch.
+**   - sample: super samples per pixel (row-major, e->x * e->y pixels)
+**   - stamp:  per pixel, the epoch its samples were traced in
+**   - epoch:  the current epoch; other stamps are stale (0 = never traced)
+**   - super:  samples per pixel the buffer was allocated for
+**   - vis:    per sample, words VIS_* codes of its shadow from each light
+**   - words:  words of vis per sample, for the lights it was laid out for
+*/
+typedef struct	s_gbuf
+{
+	t_gsample	*sample;
+	uint32_t	*stamp;
+	uint32_t	epoch;
+	size_t		super;
+	uint32_t	*vis;
+	size_t		words;
+}				t_gbuf;
+
+/*
+** t_denoise -- The denoiser's buffers (--denoise, src/denoise.c), per
+** pixel in row-major order, 3 floats per entry but depth's:
+**   - normal: the normal of the surfaces seen, averaged over the samples
+**   - depth:  their distance, likewise
+**   - albedo: their materials' diffuse colour, likewise
+**   - col:    the colour being filtered
+**   - tmp:    the result of a pass, swapped with col after it
+** Each render thread writes only its own pixels, like t_heatmap.
+*/
+typedef struct	s_denoise
+{
+	float		*normal;
+	float		*depth;
+	float		*albedo;
+	float		*col;
+	float		*tmp;
+}				t_denoise;
+
+/*
+** t_watch -- The inotify watch on the scene file (--watch,
+** src/reload/scene_watch.c). Editors often save by writing a new file and
+** renaming it over the old one, so the directory is watched and its
+** events filtered by name.
+**   - fd:   inotify descriptor, or -1 when not watching
+**   - dir:  directory of the scene file
+**   - base: file name within dir
+*/
+typedef struct	s_watch
+{
+	int			fd;
+	char		*dir;
+	char		*base;
+}				t_watch;
+
+/*
+** t_render -- The render thread of an interactive window
+** (src/render_thread.c). The event loop asks for frames; the thread draws
+** them from a snapshot of the environment, the latest request replacing
+** one not yet started.
+**   - thread:     the render thread
+**   - lock, cond: guard the fields below; cond is broadcast whenever a
+**                 frame is asked for, starts or ends
+**   - e:          the live environment, owned by the event loop
+**   - next, d:    snapshot of e and region for the requested frame
+**   - pending:    a frame is requested but not started
+**   - busy:       a frame is being drawn
+**   - paused:     the event loop is editing the scene; no frame starts
+**   - quit:       the thread is to exit
+**   - front:      finished tiles, copied out of the image being drawn;
+**                 what the window shows
+**   - show:       guards front and the dirty regions
+**   - dirty/dirties: regions of front changed since the window was last
+**                 updated
+*/
+typedef struct	s_render
+{
+	pthread_t		thread;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	struct s_env	*e;
+	struct s_env	*next;
+	SDL_Rect		d;
+	int				pending;
+	int				busy;
+	int				paused;
+	int				quit;
+	SDL_Surface		*front;
+	pthread_mutex_t	show;
+	SDL_Rect		dirty[PRESENT_RECTS];
+	size_t			dirties;
+}				t_render;
+
+/*
+** t_sched -- The event loop's frame scheduler (src/loop.c). Input handlers
+** change the scene and ask for a frame; at most once per --fps interval
+** the loop applies what they gathered and draws the latest state, once.
+**   - redraw:      a frame has been asked for since the last was drawn
+**   - retrace:     and at least one of those may see other hits, so it
+**                  cannot be reshaded from the G-buffer
+**   - interval_ms: shortest time between two frames, 1000 / --fps
+**   - last_draw:   clock_ms() when the last frame was asked for
+**   - last_tick:   clock_ms() at the loop's previous tick
+**   - grab_x, grab_y: grab-mode mouse motion not yet applied
+**   - wheel:       grab-mode wheel ticks not yet applied
+*/
+typedef struct	s_sched
+{
+	int			redraw;
+	int			retrace;
+	double		interval_ms;
+	double		last_draw;
+	double		last_tick;
+	int			grab_x;
+	int			grab_y;
+	int			wheel;
+}				t_sched;
+
+/*
+** t_prim_batch -- Every primitive of one type, as a structure of arrays
+** (see src/intersect/prim_batch.c). Element i of each array belongs to
+** e->prim[id[i]]. Only the fields a type needs are allocated; the others
+** stay NULL.
+**   - n:          number of primitives in the batch
+**   - id:         index of each primitive in e->prim
+**   - x, y, z:    centre, apex, or a point on the plane (all types)
+**   - ax, ay, az: axis (hemisphere, cylinder, cone), normal (plane, disk)
+**   - r2:         radius squared (sphere, hemisphere, cylinder)
+**   - radius:     radius (disk)
+**   - d:          loc . normal (plane, disk)
+**   - cos2, sin2: squared cosine and sine of the half-angle (cone)
+**   - limit:      half-height along the axis, -1 = unbounded (cylinder, cone)
+**
+** With PRIM_BVH_MIN or more bounded primitives, a batch also has a BVH
+** over them (src/bvh/prim_bvh.c):
+**   - bounded:    elements [0, bounded) are the bounded primitives, in
+**                 leaf order (a leaf covers a run of elements); the rest
+**                 are unbounded and tested by every ray
+**   - bvh:        the BVH (no nodes if the batch has none)
+**   - ref:        each bounded element's box, as the BVH last saw it
+**   - leaf:       the leaf node holding each bounded element
+**   - dirty:      per node: its box must be refit
+**   - built_sah:  bvh.sah when the tree was built
+*/
+typedef struct	s_prim_batch
+{
+	size_t		n;
+	size_t		*id;
+	double		*x;
+	double		*y;
+	double		*z;
+	double		*ax;
+	double		*ay;
+	double		*az;
+	double		*r2;
+	double		*radius;
+	double		*d;
+	double		*cos2;
+	double		*sin2;
+	double		*limit;
+	size_t		bounded;
+	t_bvh		bvh;
+	t_bvh_ref	*ref;
+	uint32_t	*leaf;
+	uint8_t		*dirty;
+	double		built_sah;
+}				t_prim_batch;
+
 /*
 ** t_env -- Master environment struct holding ALL application state.
 **
@@ -244,15 +762,30 @@ typedef struct	s_thread_stats
 **
 ** Scene data (arrays of pointers, dynamically allocated):
 **   - prim/prims:         geometric primitives and count
-**   - object/objects:     OBJ mesh objects and count
+**   - batch:              the primitives again, grouped by type into
+**                         arrays indexed by PRIM_* id (for intersection)
+**   - object/objects:     OBJ mesh instances (OBJECT blocks) and count
+**   - mesh/meshes:        distinct OBJ files loaded, shared by instances
 **   - light/lights:       light sources and count
 **   - material/materials: materials and count
+**   - mat_index:          hash index of the material names, kept for the
+**                         life of the scene
+**   - parse:              how long each phase of read_scene took
+**   - scene:              the scene file while read_scene reads it
+**
+** Scene reload (src/reload):
+**   - watch:     the inotify watch on the scene file
+**   - spare/spares: the live scene's meshes while a reload parses its
+**                replacement; load_mesh takes over any that are unchanged
+**   - on_error:  when set, err() jumps here instead of exiting, so that a
+**                reload that fails leaves the live scene as it was
 **
 ** Current ray state (per-thread via copy_env):
 **   - ray:        the current ray being traced
 **   - t:          nearest intersection distance (starts at INFINITY)
 **   - p_hit:      pointer to the closest primitive hit
-**   - o_hit:      pointer to the closest mesh face hit
+**   - o_hit:      index of the closest mesh face hit in its mesh
+**   - o_normal:   that face's normal, in scene space
 **   - object_hit: pointer to the mesh object owning o_hit
 **   - hit_type:   whether the hit was a primitive (PRIMITIVE) or face (FACE)
 **   - s_num:      selected primitive index (for grab mode)
@@ -262,6 +795,23 @@ typedef struct	s_thread_stats
 **   - super:     number of depth-of-field supersamples (0 = disabled)
 **   - flags:     bitmask of active key/mode flags (KEY_G, KEY_MID_CLICK, etc.)
 **   - x, y:      window/image dimensions in pixels
+**   - opt:       command-line options (run mode, headless, socket address)
+**   - heat:      per-tile/per-pixel cost buffers (NULL unless --heatmap)
+**   - gbuf:      primary hits kept for reshading (NULL unless --watch)
+**   - reshade:   the frame asked for may reuse the hits in gbuf: only
+**                lights or materials changed since the last
+**   - vis:       the shadows kept in gbuf for the primary sample being
+**                shaded, or NULL (secondary rays, no G-buffer)
+**   - denoise:   normals, depths and albedos gathered for the denoiser
+**                (NULL unless --denoise)
+**   - cancelled: the last frame was abandoned for newer input, so the
+**                image is part old frame, part new (src/draw.c)
+**   - render:    the render thread, or NULL when frames are drawn by the
+**                caller (headless processes)
+**   - sched:     the frames asked for by input, and input not yet applied
+**   - region:    the part of the image frames are drawn in: all of it,
+**                --crop, or a rectangle dragged out after pressing B
+**   - drag_x, drag_y: where the mouse went down while dragging one out
 */
 typedef struct	s_env
 {
@@ -279,20 +829,43 @@ typedef struct	s_env
 	size_t			hit_type;
 	t_prim			**prim;
 	size_t			prims;
-	t_face			*o_hit;
+	t_prim_batch	*batch;
+	size_t			o_hit;
+	t_vector		o_normal;
 	t_object		*object_hit;
 	t_object		**object;
 	size_t			objects;
+	t_mesh			**mesh;
+	size_t			meshes;
 	t_light			**light;
 	size_t			lights;
 	t_material		**material;
 	size_t			materials;
+	t_mat_index		mat_index;
+	t_parse_times	parse;
+	t_scene			scene;
+	t_watch			watch;
+	t_mesh			**spare;
+	size_t			spares;
+	jmp_buf			*on_error;
 	double			t;
 	int				maxdepth;
 	size_t			super;
 	size_t			flags;
 	size_t			x;
 	size_t			y;
+	t_options		opt;
+	t_heatmap		*heat;
+	t_gbuf			*gbuf;
+	int				reshade;
+	uint32_t		*vis;
+	t_denoise		*denoise;
+	int				cancelled;
+	t_render		*render;
+	t_sched			sched;
+	SDL_Rect		region;
+	int				drag_x;
+	int				drag_y;
 }				t_env;
 
 /*
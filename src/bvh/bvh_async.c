@@ -0,0 +1,88 @@
+/*
+** bvh_async.c -- Build the mesh BVHs in the background.
+**
+** Building a BVH takes time proportional to the mesh, and the window
+** should not wait for it. Once the scene is read, each mesh gets a
+** builder thread, and rendering starts at once. Until a mesh's BVH is
+** complete, rays test every one of its faces, as before BVHs existed
+** (intersect_object.c). Each builder fills in the mesh's node and order
+** arrays, then sets mesh->ready with release ordering; a ray that reads
+** ready (acquire) as set sees the whole tree. So each mesh switches to
+** its BVH when it is done, mid-frame if need be.
+**
+** Both paths break ties between faces the same way, so the image does
+** not depend on when a build finishes, only the render time does.
+**
+** With --bvh-cache, a builder first looks for the mesh's tree in the
+** cache and maps it if it is there (bvh_cache.c), and stores the tree it
+** builds otherwise.
+**
+** Headless runs (--output, --worker) render as soon as the builds are
+** done instead: there is no window to show early, and renders that are
+** timed (make check) should not time the builds. exit_rt joins any build
+** still running before freeing the meshes.
+*/
+
+#include "rt.h"
+
+/*
+** build_thread -- Build (or load) one mesh's BVH, publish it and report
+** it.
+*/
+static void	*build_thread(void *arg)
+{
+	t_mesh	*m;
+	double	start;
+
+	m = (t_mesh *)arg;
+	start = clock_ms();
+	if (cached_bvh(m, m->cache) == -1)
+	{
+		printf("BVH %s: out of memory, testing every face\n", m->file);
+		return (NULL);
+	}
+	m->build_ms = clock_ms() - start;
+	atomic_store_explicit(&m->ready, 1, memory_order_release);
+	bvh_report(m);
+	return (NULL);
+}
+
+/*
+** start_bvh_builds -- Start a builder thread per mesh that has no BVH and
+** no builder yet (a scene reload keeps the meshes it can). If a thread
+** cannot be created, that mesh is built here instead.
+*/
+void		start_bvh_builds(t_env *e)
+{
+	size_t	i;
+
+	i = -1;
+	while (++i < e->meshes)
+	{
+		if (!e->mesh[i]->faces || e->mesh[i]->building ||
+			atomic_load_explicit(&e->mesh[i]->ready, memory_order_acquire))
+			continue ;
+		e->mesh[i]->cache = e->opt.bvh_cache;
+		if (pthread_create(&e->mesh[i]->builder, NULL, build_thread,
+			e->mesh[i]) == 0)
+			e->mesh[i]->building = 1;
+		else
+			build_thread(e->mesh[i]);
+	}
+}
+
+/* wait_bvh_builds -- Wait for every builder thread to finish. */
+void		wait_bvh_builds(t_env *e)
+{
+	size_t	i;
+
+	if (!e->mesh)
+		return ;
+	i = -1;
+	while (++i < e->meshes)
+		if (e->mesh[i]->building)
+		{
+			pthread_join(e->mesh[i]->builder, NULL);
+			e->mesh[i]->building = 0;
+		}
+}
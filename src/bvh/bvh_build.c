@@ -0,0 +1,679 @@
+/*
+** bvh_build.c -- Build a bounding volume hierarchy over boxed items: the
+** faces of a mesh, or the bounded primitives of a batch (prim_bvh.c).
+**
+** A BVH is a binary tree of axis-aligned boxes: each node bounds the items
+** below it, and a ray that misses a node's box skips all of them. Testing
+** a ray against a mesh then costs roughly log(faces) box tests and a few
+** triangle tests instead of one triangle test per face.
+**
+** The tree is built top-down with the surface area heuristic (SAH). The
+** chance that a ray which hits a node also hits a child is about the
+** ratio of their surface areas, so a split of a node's items into L and R
+** is expected to cost
+**
+**   BVH_COST_BOX + (area(L) * |L| + area(R) * |R|) / area(node)
+**                * BVH_COST_FACE
+**
+** against |node| * BVH_COST_FACE for making the node a leaf. Rather than
+** trying every split, each node's items are sorted into BVH_BINS bins by
+** the centre of their boxes on each axis, and only the BVH_BINS - 1 splits
+** between bins are costed (binned SAH). The bins also give the bounds of
+** both halves, so each node takes one pass over its items. A node becomes
+** a leaf when it has at most BVH_LEAF_SIZE items, or at most BVH_MAX_LEAF
+** and no split is cheaper. When no bin split exists (every centre in one
+** bin) or the tree gets deep, the items are split at the median centre
+** instead, which always halves them, so the depth stays within BVH_STACK.
+**
+** The items are handled as references (t_bvh_ref): an item's box and index
+** in one small record, reordered in place as the tree is split, so each
+** pass reads memory in order instead of chasing vertex indices.
+**
+** Large builds are spread over the cores, with a thread per task as in
+** make_chunks: a node with BVH_PAR_BINS items or more per core bins them
+** in slices, one per thread; and a node whose halves both have
+** BVH_PAR_TASK items or more builds its left subtree on a new thread,
+** while the cores last. Neither changes the tree, only how fast it is
+** built.
+**
+** Nodes are stored depth-first in one array (a left child directly follows
+** its parent), and the leaves refer to runs of the tree's order array,
+** which lists item indices in leaf order. So that subtrees can be built at
+** once, each reserves the 2n - 1 nodes a tree over its n items may need;
+** the tree is packed when it is done. A mesh's tree is built once, in
+** object space, and shared by every instance (see instance.c).
+*/
+
+#include "rt.h"
+
+typedef struct	s_bvh_build
+{
+	t_bvh			*t;
+	t_bvh_ref		*ref;
+	long			threads;
+	_Atomic long	busy;
+}				t_bvh_build;
+
+/*
+** Items whose centres fall in one bin: box[0..1] bounds them, box[2..3]
+** their centres.
+*/
+typedef struct	s_bvh_bin
+{
+	t_vector	box[4];
+	size_t		count;
+}				t_bvh_bin;
+
+/*
+** t_bvh_slice -- References [start, start + count), and what a pass over
+** them learns: box[0..1] bounds the items and box[2..3] their centres, or
+** bin sorts them on each axis. A centre c falls in bin
+** (c - lo[a]) * scale[a] on axis a.
+*/
+typedef struct	s_bvh_slice
+{
+	t_bvh_build	*b;
+	size_t		start;
+	size_t		count;
+	double		lo[3];
+	double		scale[3];
+	t_vector	box[4];
+	t_bvh_bin	bin[3][BVH_BINS];
+	pthread_t	tid;
+}				t_bvh_slice;
+
+/*
+** A subtree to build: references [start, start + count) from node id.
+** box is as in t_bvh_slice.
+*/
+typedef struct	s_bvh_task
+{
+	t_bvh_build	*b;
+	size_t		start;
+	size_t		count;
+	size_t		id;
+	int			depth;
+	t_vector	box[4];
+}				t_bvh_task;
+
+/* Component a (0 x, 1 y, 2 z) of v. */
+static double	axis_of(t_vector v, int a)
+{
+	if (a == 0)
+		return (v.x);
+	return ((a == 1) ? v.y : v.z);
+}
+
+/* Make box empty, so that growing it by anything gives that thing. */
+static void		empty(t_vector box[2])
+{
+	box[0] = (t_vector){INFINITY, INFINITY, INFINITY};
+	box[1] = (t_vector){-INFINITY, -INFINITY, -INFINITY};
+}
+
+/* Grow box to contain the box [lo, hi]. */
+static void		grow(t_vector box[2], t_vector lo, t_vector hi)
+{
+	box[0].x = MIN(box[0].x, lo.x);
+	box[0].y = MIN(box[0].y, lo.y);
+	box[0].z = MIN(box[0].z, lo.z);
+	box[1].x = MAX(box[1].x, hi.x);
+	box[1].y = MAX(box[1].y, hi.y);
+	box[1].z = MAX(box[1].z, hi.z);
+}
+
+/* Surface area of box; 0 for an empty one. */
+static double	area(t_vector box[2])
+{
+	t_vector	d;
+
+	if (box[0].x > box[1].x)
+		return (0.0);
+	d = vsub(box[1], box[0]);
+	return (2.0 * (d.x * d.y + d.y * d.z + d.z * d.x));
+}
+
+/* Longest axis of box. */
+static int		longest(t_vector box[2])
+{
+	t_vector	ext;
+
+	ext = vsub(box[1], box[0]);
+	return ((ext.x >= ext.y && ext.x >= ext.z) ? 0 : 2 - (ext.y >= ext.z));
+}
+
+/* Centre of r's box on axis a, doubled (only its order matters). */
+static double	centre(t_bvh_ref *r, int a)
+{
+	return ((double)r->lo[a] + r->hi[a]);
+}
+
+/* r's box in box[0..1], and its centre (doubled) in box[2]. */
+static void		ref_box(t_bvh_ref *r, t_vector box[3])
+{
+	box[0] = (t_vector){r->lo[0], r->lo[1], r->lo[2]};
+	box[1] = (t_vector){r->hi[0], r->hi[1], r->hi[2]};
+	box[2] = vadd(box[0], box[1]);
+}
+
+/* The bin r falls in on axis a; slice_bins computes the same inline. */
+static int		bin_of(t_bvh_slice *s, t_bvh_ref *r, int a)
+{
+	int		k;
+
+	k = (int)((centre(r, a) - s->lo[a]) * s->scale[a]);
+	return (MIN(k, BVH_BINS - 1));
+}
+
+/* slice_bounds -- Set s->box (thread entry point). */
+static void		*slice_bounds(void *arg)
+{
+	t_bvh_slice	*s;
+	t_vector	box[3];
+	size_t		i;
+
+	s = (t_bvh_slice *)arg;
+	empty(s->box);
+	empty(s->box + 2);
+	i = s->start - 1;
+	while (++i < s->start + s->count)
+	{
+		ref_box(&s->b->ref[i], box);
+		grow(s->box, box[0], box[1]);
+		grow(s->box + 2, box[2], box[2]);
+	}
+	return (NULL);
+}
+
+/* slice_bins -- Fill s->bin (thread entry point). */
+static void		*slice_bins(void *arg)
+{
+	t_bvh_slice	*s;
+	t_bvh_bin	*bin;
+	t_vector	box[3];
+	size_t		i;
+	int			a;
+
+	s = (t_bvh_slice *)arg;
+	a = -1;
+	while (++a < 3 * BVH_BINS)
+	{
+		bin = &s->bin[a / BVH_BINS][a % BVH_BINS];
+		empty(bin->box);
+		empty(bin->box + 2);
+		bin->count = 0;
+	}
+	i = s->start - 1;
+	while (++i < s->start + s->count)
+	{
+		ref_box(&s->b->ref[i], box);
+		a = -1;
+		while (++a < 3)
+		{
+			bin = &s->bin[a][MIN((int)((axis_of(box[2], a) - s->lo[a]) *
+				s->scale[a]), BVH_BINS - 1)];
+			grow(bin->box, box[0], box[1]);
+			grow(bin->box + 2, box[2], box[2]);
+			++bin->count;
+		}
+	}
+	return (NULL);
+}
+
+/*
+** in_slices -- Run fn on the n slices, each but the first on a thread of
+** its own, and wait for them. A slice whose thread cannot be created is
+** run here.
+*/
+static void		in_slices(t_bvh_slice *s, size_t n, void *(*fn)(void *))
+{
+	size_t	i;
+	int		ok[n];
+
+	i = 0;
+	while (++i < n)
+		ok[i] = (pthread_create(&s[i].tid, NULL, fn, &s[i]) == 0);
+	fn(&s[0]);
+	i = 0;
+	while (++i < n)
+		if (ok[i])
+			pthread_join(s[i].tid, NULL);
+		else
+			fn(&s[i]);
+}
+
+/* merge -- Fold the n slices' bounds (or, with bins set, bins) into out. */
+static void		merge(t_bvh_slice *out, t_bvh_slice *s, size_t n, int bins)
+{
+	t_bvh_bin	*to;
+	t_bvh_bin	*from;
+	size_t		i;
+	int			k;
+
+	i = -1;
+	while (++i < n)
+	{
+		grow(out->box, s[i].box[0], s[i].box[1]);
+		grow(out->box + 2, s[i].box[2], s[i].box[3]);
+		k = -1;
+		while (bins && ++k < 3 * BVH_BINS)
+		{
+			to = &out->bin[k / BVH_BINS][k % BVH_BINS];
+			from = &s[i].bin[k / BVH_BINS][k % BVH_BINS];
+			grow(to->box, from->box[0], from->box[1]);
+			grow(to->box + 2, from->box[2], from->box[3]);
+			to->count += from->count;
+		}
+	}
+}
+
+/*
+** gather -- Run the pass fn (slice_bounds or slice_bins) over s: on this
+** thread, or for a big enough s on up to one per core, each taking a
+** slice of the references.
+*/
+static void		gather(t_bvh_slice *s, void *(*fn)(void *))
+{
+	t_bvh_slice	*part;
+	size_t		n;
+	size_t		i;
+
+	n = MIN(s->count / BVH_PAR_BINS, (size_t)s->b->threads);
+	if (n < 2 || !(part = (t_bvh_slice *)malloc(sizeof(t_bvh_slice) * n)))
+	{
+		fn(s);
+		return ;
+	}
+	i = -1;
+	while (++i < n)
+	{
+		part[i] = *s;
+		part[i].start = s->start + s->count * i / n;
+		part[i].count = s->start + s->count * (i + 1) / n - part[i].start;
+	}
+	in_slices(part, n, fn);
+	merge(&part[0], part + 1, n - 1, fn == slice_bins);
+	part[0].start = s->start;
+	part[0].count = s->count;
+	*s = part[0];
+	free(part);
+}
+
+/*
+** cost_axis -- The cheapest split of s's bins on axis a: sets *split
+** (the first bin on the right) if it beats best, and returns the new best
+** of area(L) * |L| + area(R) * |R|.
+*/
+static double	cost_axis(t_bvh_slice *s, int a, int *split, double best)
+{
+	t_vector	box[2];
+	double		right[BVH_BINS];
+	double		cost;
+	size_t		n;
+	int			k;
+
+	empty(box);
+	n = 0;
+	k = BVH_BINS;
+	while (--k > 0)
+	{
+		grow(box, s->bin[a][k].box[0], s->bin[a][k].box[1]);
+		n += s->bin[a][k].count;
+		right[k] = area(box) * n;
+	}
+	empty(box);
+	n = 0;
+	k = 0;
+	while (k < BVH_BINS - 1)
+	{
+		grow(box, s->bin[a][k].box[0], s->bin[a][k].box[1]);
+		n += s->bin[a][k++].count;
+		cost = area(box) * n + right[k];
+		if (n && n < s->count && cost < best)
+		{
+			best = cost;
+			*split = k;
+		}
+	}
+	return (best);
+}
+
+/*
+** sah_split -- Bin s's items and find the cheapest split: sets axis and
+** split and returns its SAH cost, or INFINITY if every split leaves a
+** side empty.
+*/
+static double	sah_split(t_bvh_slice *s, int *axis, int *split)
+{
+	double	best;
+	double	cost;
+	double	ext;
+	int		a;
+
+	a = -1;
+	while (++a < 3)
+	{
+		s->lo[a] = axis_of(s->box[2], a);
+		ext = axis_of(s->box[3], a) - s->lo[a];
+		s->scale[a] = (ext > 0.0) ? BVH_BINS / ext : 0.0;
+	}
+	gather(s, slice_bins);
+	best = INFINITY;
+	*axis = 0;
+	*split = 1;
+	a = -1;
+	while (++a < 3)
+		if ((cost = cost_axis(s, a, split, best)) < best)
+		{
+			best = cost;
+			*axis = a;
+		}
+	if (best == INFINITY || area(s->box) <= 0.0)
+		return (INFINITY);
+	return (BVH_COST_BOX + best / area(s->box) * BVH_COST_FACE);
+}
+
+/* Swap two references. */
+static void		swap(t_bvh_ref *a, t_bvh_ref *b)
+{
+	t_bvh_ref	tmp;
+
+	tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
+
+/*
+** partition -- Move s's items in bins below split on axis a to the front,
+** and set the bounds of both sides from the bins. Returns how many items
+** went left.
+*/
+static size_t	partition(t_bvh_slice *s, int a, int split, t_bvh_task sub[2])
+{
+	t_bvh_ref	*r;
+	t_bvh_bin	*bin;
+	size_t		i;
+	size_t		k;
+	int			j;
+
+	r = s->b->ref;
+	k = s->start;
+	i = s->start - 1;
+	while (++i < s->start + s->count)
+		if (bin_of(s, &r[i], a) < split)
+			swap(&r[i], &r[k++]);
+	j = -1;
+	while (++j < 4)
+		empty(sub[j / 2].box + (j % 2) * 2);
+	j = -1;
+	while (++j < BVH_BINS)
+	{
+		bin = &s->bin[a][j];
+		grow(sub[j >= split].box, bin->box[0], bin->box[1]);
+		grow(sub[j >= split].box + 2, bin->box[2], bin->box[3]);
+	}
+	return (k - s->start);
+}
+
+/*
+** median -- Reorder ref[lo, hi) so that no centre in the first half is
+** greater on axis a than any in the second (quickselect, with a three-way
+** partition so equal centres cannot stall it). Returns the split.
+*/
+static size_t	median(t_bvh_build *b, size_t lo, size_t hi, int a)
+{
+	t_bvh_ref	*r;
+	size_t		mid;
+	size_t		lt;
+	size_t		gt;
+	size_t		i;
+	double		pivot;
+
+	r = b->ref;
+	mid = lo + (hi - lo) / 2;
+	while (hi - lo > 1)
+	{
+		pivot = centre(&r[mid], a);
+		lt = lo;
+		i = lo;
+		gt = hi;
+		while (i < gt)
+			if (centre(&r[i], a) < pivot)
+				swap(&r[lt++], &r[i++]);
+			else if (centre(&r[i], a) > pivot)
+				swap(&r[i], &r[--gt]);
+			else
+				++i;
+		if (mid < lt)
+			hi = lt;
+		else if (mid >= gt)
+			lo = gt;
+		else
+			break ;
+	}
+	return (mid);
+}
+
+/*
+** set_node -- Fill in node n. Its bounds are unions of the refs' boxes,
+** which are already floats (a mesh's vertices, or prim_bvh.c's boxes
+** rounded outward by to_float), so narrowing them back to float is exact.
+*/
+static void		set_node(t_bvh_node *n, t_vector box[2], size_t index,
+		size_t count)
+{
+	n->lo[0] = (float)box[0].x;
+	n->lo[1] = (float)box[0].y;
+	n->lo[2] = (float)box[0].z;
+	n->hi[0] = (float)box[1].x;
+	n->hi[1] = (float)box[1].y;
+	n->hi[2] = (float)box[1].z;
+	n->index = (uint32_t)index;
+	n->count = (uint32_t)count;
+}
+
+static void		*build(void *arg);
+
+/*
+** branch -- Build both subtrees of a node: the left one on a new thread
+** if both are big enough and a core is free, else one after the other.
+*/
+static void		branch(t_bvh_build *b, t_bvh_task sub[2])
+{
+	pthread_t	tid;
+	int			spawn;
+
+	spawn = 0;
+	if (sub[0].count >= BVH_PAR_TASK && sub[1].count >= BVH_PAR_TASK)
+	{
+		if (atomic_fetch_add(&b->busy, 1) < b->threads)
+			spawn = (pthread_create(&tid, NULL, build, &sub[0]) == 0);
+		if (!spawn)
+			atomic_fetch_sub(&b->busy, 1);
+	}
+	if (!spawn)
+		build(&sub[0]);
+	build(&sub[1]);
+	if (spawn)
+	{
+		pthread_join(tid, NULL);
+		atomic_fetch_sub(&b->busy, 1);
+	}
+}
+
+/*
+** split_median -- Split s's items at the median centre on the longest
+** axis, and bound both sides. Returns how many items went left.
+*/
+static size_t	split_median(t_bvh_slice *s, t_bvh_task sub[2])
+{
+	size_t	left;
+	size_t	count;
+	int		k;
+
+	left = median(s->b, s->start, s->start + s->count, longest(s->box + 2)) -
+		s->start;
+	count = s->count;
+	s->count = left;
+	k = -1;
+	while (++k < 2)
+	{
+		gather(s, slice_bounds);
+		memcpy(sub[k].box, s->box, sizeof(s->box));
+		s->start += left;
+		s->count = count - left;
+	}
+	return (left);
+}
+
+/*
+** build -- Build task t's subtree, rooted at node t->id (thread entry
+** point). Its left subtree starts at the next node and its right one
+** after the 2 * |left| - 1 nodes reserved for the left.
+*/
+static void		*build(void *arg)
+{
+	t_bvh_task	*t;
+	t_bvh_slice	s;
+	t_bvh_task	sub[2];
+	size_t		left;
+	double		cost;
+	int			split[2];
+
+	t = (t_bvh_task *)arg;
+	if (t->count <= BVH_LEAF_SIZE)
+	{
+		set_node(&t->b->t->node[t->id], t->box, t->start, t->count);
+		return (NULL);
+	}
+	s.b = t->b;
+	s.start = t->start;
+	s.count = t->count;
+	memcpy(s.box, t->box, sizeof(s.box));
+	cost = (t->depth < BVH_STACK / 2) ?
+		sah_split(&s, &split[0], &split[1]) : INFINITY;
+	if (cost == INFINITY)
+		left = split_median(&s, sub);
+	else if (t->count <= BVH_MAX_LEAF && cost >= t->count * BVH_COST_FACE)
+	{
+		set_node(&t->b->t->node[t->id], t->box, t->start, t->count);
+		return (NULL);
+	}
+	else
+		left = partition(&s, split[0], split[1], sub);
+	set_node(&t->b->t->node[t->id], t->box, t->id + 2 * left, 0);
+	sub[0] = (t_bvh_task){t->b, t->start, left, t->id + 1, t->depth + 1,
+		{sub[0].box[0], sub[0].box[1], sub[0].box[2], sub[0].box[3]}};
+	sub[1] = (t_bvh_task){t->b, t->start + left, t->count - left,
+		t->id + 2 * left, t->depth + 1,
+		{sub[1].box[0], sub[1].box[1], sub[1].box[2], sub[1].box[3]}};
+	branch(t->b, sub);
+	return (NULL);
+}
+
+/*
+** pack -- Move the subtree at node from down to node *to onwards, closing
+** the gaps left by reservations, and add each node's cost times its area
+** to *sah. The nodes are visited in order, and none moves up, so a node
+** is always read before it is overwritten. Returns the subtree's new
+** index.
+*/
+static size_t	pack(t_bvh *t, size_t from, size_t *to, double *sah)
+{
+	t_bvh_node	n;
+	t_vector	box[2];
+	size_t		id;
+
+	n = t->node[from];
+	box[0] = (t_vector){n.lo[0], n.lo[1], n.lo[2]};
+	box[1] = (t_vector){n.hi[0], n.hi[1], n.hi[2]};
+	*sah += area(box) * ((n.count) ? n.count * BVH_COST_FACE : BVH_COST_BOX);
+	id = (*to)++;
+	if (!n.count)
+	{
+		pack(t, from + 1, to, sah);
+		n.index = (uint32_t)pack(t, n.index, to, sah);
+	}
+	t->node[id] = n;
+	return (id);
+}
+
+/*
+** build_tree -- Build t over the n items in ref (n > 0), reordering ref,
+** and set t->sah to the tree's expected cost per ray that hits its root,
+** in the units of BVH_COST_BOX and BVH_COST_FACE. Returns -1, with t
+** empty, if memory runs out.
+*/
+int				build_tree(t_bvh *t, t_bvh_ref *ref, size_t n)
+{
+	t_bvh_build	b;
+	t_bvh_slice	s;
+	t_bvh_task	root;
+	t_bvh_node	*packed;
+	size_t		i;
+
+	t->nodes = 0;
+	t->sah = 0.0;
+	b = (t_bvh_build){t, ref, MAX(sysconf(_SC_NPROCESSORS_ONLN), 1), 1};
+	t->order = (uint32_t *)malloc(sizeof(uint32_t) * n);
+	t->node = (t_bvh_node *)malloc(sizeof(t_bvh_node) * (2 * n - 1));
+	if (!t->order || !t->node)
+	{
+		free(t->order);
+		free(t->node);
+		*t = (t_bvh){NULL, 0, NULL, 0.0};
+		return (-1);
+	}
+	s.b = &b;
+	s.start = 0;
+	s.count = n;
+	gather(&s, slice_bounds);
+	root = (t_bvh_task){&b, 0, n, 0, 0,
+		{s.box[0], s.box[1], s.box[2], s.box[3]}};
+	build(&root);
+	i = -1;
+	while (++i < n)
+		t->order[i] = ref[i].item;
+	pack(t, 0, &t->nodes, &t->sah);
+	t->sah /= MAX(area(s.box), DBL_MIN);
+	if ((packed = (t_bvh_node *)realloc(t->node,
+		sizeof(t_bvh_node) * t->nodes)))
+		t->node = packed;
+	return (0);
+}
+
+/*
+** build_bvh -- Build m's BVH over its faces. Runs on a builder thread
+** (bvh_async.c), so running out of memory is not fatal: it returns -1 and
+** leaves m without a BVH.
+*/
+int				build_bvh(t_mesh *m)
+{
+	t_bvh_ref	*ref;
+	t_vec3f		*v[3];
+	size_t		f;
+	int			ret;
+
+	m->bvh = (t_bvh){NULL, 0, NULL, 0.0};
+	if (!m->faces)
+		return (0);
+	if (!(ref = (t_bvh_ref *)malloc(sizeof(t_bvh_ref) * m->faces)))
+		return (-1);
+	f = -1;
+	while (++f < m->faces)
+	{
+		v[0] = &m->v[m->idx[3 * f]];
+		v[1] = &m->v[m->idx[3 * f + 1]];
+		v[2] = &m->v[m->idx[3 * f + 2]];
+		ref[f] = (t_bvh_ref){
+			{MIN(MIN(v[0]->x, v[1]->x), v[2]->x),
+			MIN(MIN(v[0]->y, v[1]->y), v[2]->y),
+			MIN(MIN(v[0]->z, v[1]->z), v[2]->z)},
+			{MAX(MAX(v[0]->x, v[1]->x), v[2]->x),
+			MAX(MAX(v[0]->y, v[1]->y), v[2]->y),
+			MAX(MAX(v[0]->z, v[1]->z), v[2]->z)}, (uint32_t)f};
+	}
+	ret = build_tree(&m->bvh, ref, m->faces);
+	free(ref);
+	return (ret);
+}
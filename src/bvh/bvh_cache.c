@@ -0,0 +1,239 @@
+/*
+** bvh_cache.c -- On-disk cache of built mesh BVHs (--bvh-cache DIR).
+**
+** A mesh's BVH depends only on its OBJ file and on the builder's
+** parameters, so a repeat render of the same asset can reuse the tree a
+** previous run built. The cache key is a 64-bit FNV-1a hash of the
+** builder parameters (BVH_CACHE_VERSION, leaf sizes, bins, costs, node
+** size) followed by the OBJ file's bytes, and names the file DIR/<key>.bvh:
+**
+**   t_bvh_file header, then the nodes, then the face order
+**
+** A hit is mapped read-only and used in place: the mesh's node and order
+** arrays point into the mapping, and free_mesh unmaps it instead of
+** freeing them. A file that does not match (wrong magic, key or face
+** count, wrong size, a node or face index out of range, or a tree deeper
+** than the traversal stack allows) is ignored, and the tree built instead
+** replaces it. Files are written under a temporary name and renamed into
+** place, so concurrent jobs never see half of one.
+**
+** The parallel builder produces the same tree whatever the thread count,
+** so BVH_PAR_BINS and BVH_PAR_TASK are not part of the key. A change to
+** the OBJ parser or the builder that changes the tree must bump
+** BVH_CACHE_VERSION.
+**
+** Every failure here only costs the cache: the BVH is built as usual.
+*/
+
+#include "rt.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+** t_bvh_file -- Header of a cache file. The nodes follow it, then faces
+** order entries.
+*/
+typedef struct	s_bvh_file
+{
+	char		magic[8];
+	uint64_t	key;
+	uint64_t	faces;
+	uint64_t	nodes;
+	double		sah;
+}				t_bvh_file;
+
+/* FNV-1a over n bytes at p, continuing from h. */
+static uint64_t	fnv(uint64_t h, const void *p, size_t n)
+{
+	const unsigned char	*c;
+
+	c = (const unsigned char *)p;
+	while (n--)
+		h = (h ^ *c++) * 0x100000001b3ULL;
+	return (h);
+}
+
+/*
+** mesh_key -- The cache key of m: its builder parameters and the bytes of
+** its OBJ file. Returns 0 (no key) if the file cannot be read.
+*/
+static uint64_t	mesh_key(t_mesh *m)
+{
+	const double	param[] = {BVH_CACHE_VERSION, BVH_LEAF_SIZE, BVH_MAX_LEAF,
+		BVH_BINS, BVH_COST_BOX, BVH_COST_FACE, sizeof(t_bvh_node)};
+	struct stat		st;
+	void			*obj;
+	uint64_t		h;
+	int				fd;
+
+	if ((fd = open(m->file, O_RDONLY)) == -1)
+		return (0);
+	h = fnv(0xcbf29ce484222325ULL, param, sizeof(param));
+	obj = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+		obj = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (obj == MAP_FAILED)
+		return (0);
+	h = fnv(h, obj, st.st_size);
+	munmap(obj, st.st_size);
+	return (h ? h : 1);
+}
+
+/* The cache file's path for key: DIR/<key>.bvh, malloc'd. */
+static char		*cache_path(const char *dir, uint64_t key)
+{
+	char	*path;
+	size_t	len;
+
+	len = strlen(dir) + 32;
+	if ((path = (char *)malloc(len)))
+		snprintf(path, len, "%s/%016llx.bvh", dir, (unsigned long long)key);
+	return (path);
+}
+
+/*
+** shallow_tree -- Whether no leaf of the tree is more than BVH_STACK - 1
+** levels below the root, so a traversal never overflows its stack (each
+** internal node it enters pushes both children). Children always follow
+** their parent, so one pass in index order finds every node's depth, the
+** longest path to it should two parents share it.
+*/
+static int		shallow_tree(t_bvh_node *node, size_t nodes)
+{
+	uint16_t	*depth;
+	size_t		k;
+	int			ok;
+
+	if (!(depth = (uint16_t *)calloc(nodes, sizeof(uint16_t))))
+		return (0);
+	ok = 1;
+	k = -1;
+	while (ok && ++k < nodes)
+		if (!node[k].count && (ok = (depth[k] < BVH_STACK - 1)))
+		{
+			depth[k + 1] = MAX(depth[k + 1], depth[k] + 1);
+			depth[node[k].index] = MAX(depth[node[k].index], depth[k] + 1);
+		}
+	free(depth);
+	return (ok);
+}
+
+/*
+** valid_tree -- Whether every node of the mapped tree refers only to
+** nodes and order entries that exist, every order entry to a face, and
+** the tree is shallow enough to traverse.
+*/
+static int		valid_tree(t_bvh_node *node, size_t nodes, uint32_t *order,
+		size_t faces)
+{
+	size_t	k;
+
+	k = -1;
+	while (++k < nodes)
+		if ((node[k].count && (uint64_t)node[k].index + node[k].count >
+			faces) || (!node[k].count && (node[k].index <= k + 1 ||
+			node[k].index >= nodes)))
+			return (0);
+	k = -1;
+	while (++k < faces)
+		if (order[k] >= faces)
+			return (0);
+	return (shallow_tree(node, nodes));
+}
+
+/*
+** load_bvh_cache -- Map m's BVH from the cache, if the cache holds a valid
+** one for key. Returns 0 on a hit, -1 otherwise.
+*/
+static int		load_bvh_cache(t_mesh *m, char *path, uint64_t key)
+{
+	struct stat		st;
+	t_bvh_file		*h;
+	void			*map;
+	int				fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return (-1);
+	map = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(t_bvh_file))
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return (-1);
+	h = (t_bvh_file *)map;
+	if (memcmp(h->magic, BVH_CACHE_MAGIC, 8) || h->key != key ||
+		h->faces != m->faces || !h->nodes || h->nodes > 2 * m->faces - 1 ||
+		(size_t)st.st_size != sizeof(t_bvh_file) + h->nodes *
+		sizeof(t_bvh_node) + m->faces * sizeof(uint32_t) ||
+		!valid_tree((t_bvh_node *)(h + 1), h->nodes, (uint32_t *)((
+		t_bvh_node *)(h + 1) + h->nodes), m->faces))
+	{
+		munmap(map, st.st_size);
+		return (-1);
+	}
+	m->bvh = (t_bvh){(t_bvh_node *)(h + 1), h->nodes,
+		(uint32_t *)((t_bvh_node *)(h + 1) + h->nodes), h->sah};
+	m->map = map;
+	m->map_size = st.st_size;
+	return (0);
+}
+
+/*
+** save_bvh_cache -- Write m's BVH to path, through a temporary file in
+** the same directory that is renamed into place once complete.
+*/
+static void		save_bvh_cache(t_mesh *m, const char *path, uint64_t key)
+{
+	t_bvh_file	h;
+	char		*tmp;
+	int			fd;
+	int			ok;
+
+	if (!(tmp = (char *)malloc(strlen(path) + 8)))
+		return ;
+	sprintf(tmp, "%s.XXXXXX", path);
+	if ((fd = mkstemp(tmp)) == -1)
+	{
+		free(tmp);
+		return ;
+	}
+	fchmod(fd, 0644);
+	h = (t_bvh_file){{0}, key, m->faces, m->bvh.nodes, m->bvh.sah};
+	memcpy(h.magic, BVH_CACHE_MAGIC, 8);
+	ok = (write(fd, &h, sizeof(h)) == (ssize_t)sizeof(h) &&
+		write(fd, m->bvh.node, m->bvh.nodes * sizeof(t_bvh_node)) ==
+		(ssize_t)(m->bvh.nodes * sizeof(t_bvh_node)) &&
+		write(fd, m->bvh.order, m->faces * sizeof(uint32_t)) ==
+		(ssize_t)(m->faces * sizeof(uint32_t)));
+	ok = (close(fd) == 0 && ok && rename(tmp, path) == 0);
+	if (!ok)
+		unlink(tmp);
+	free(tmp);
+}
+
+/*
+** cached_bvh -- Give m its BVH from the cache in dir, or build it and
+** store it there. Returns build_bvh's result; m->map is set on a hit.
+*/
+int				cached_bvh(t_mesh *m, const char *dir)
+{
+	uint64_t	key;
+	char		*path;
+	int			ret;
+
+	if (!dir || !(key = mesh_key(m)) || !(path = cache_path(dir, key)))
+		return (build_bvh(m));
+	if (load_bvh_cache(m, path, key) == 0)
+	{
+		free(path);
+		return (0);
+	}
+	if ((ret = build_bvh(m)) == 0 && m->bvh.nodes)
+	{
+		mkdir(dir, 0777);
+		save_bvh_cache(m, path, key);
+	}
+	free(path);
+	return (ret);
+}
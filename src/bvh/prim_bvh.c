@@ -0,0 +1,290 @@
+/*
+** prim_bvh.c -- BVHs over the bounded primitives of each batch, kept up
+** to date as primitives move.
+**
+** Spheres, hemispheres, disks, and cylinders and cones with a LIMIT have
+** finite bounds; planes and unlimited cylinders and cones do not, and are
+** tested by every ray as before. A batch with PRIM_BVH_MIN bounded
+** primitives or more gets a BVH over them (bvh_build.c), and its elements
+** are put in leaf order, so that a leaf is a run of the batch's arrays and
+** intersect_batch.c runs its usual loops over the runs a ray reaches.
+**
+** Grab mode moves primitives between frames. Rather than rebuild the tree,
+** every frame compares each bounded element's box with the one the tree
+** last saw. The leaves holding those that changed are refit, and the
+** change is propagated up: a node is refit when a child was. The tree
+** keeps its shape, so it gets worse as primitives wander; once its SAH
+** cost exceeds PRIM_BVH_REBUILD times its cost when built, the batches
+** are rebuilt from scratch.
+**
+** The nearest hit does not depend on the tree, since ties go to the
+** higher primitive index whatever the order of the tests (see found() in
+** intersect_batch.c).
+*/
+
+#include "rt.h"
+
+/* Grow box to contain the box [lo, hi]. */
+static void		grow(t_vector box[2], t_vector lo, t_vector hi)
+{
+	box[0] = (t_vector){MIN(box[0].x, lo.x), MIN(box[0].y, lo.y),
+		MIN(box[0].z, lo.z)};
+	box[1] = (t_vector){MAX(box[1].x, hi.x), MAX(box[1].y, hi.y),
+		MAX(box[1].z, hi.z)};
+}
+
+/* Grow box to contain the disk at c with unit normal n and radius r. */
+static void		grow_disk(t_vector box[2], t_vector c, t_vector n, double r)
+{
+	t_vector	ext;
+
+	ext = (t_vector){r * sqrt(MAX(0.0, 1.0 - n.x * n.x)),
+		r * sqrt(MAX(0.0, 1.0 - n.y * n.y)),
+		r * sqrt(MAX(0.0, 1.0 - n.z * n.z))};
+	grow(box, vsub(c, ext), vadd(c, ext));
+}
+
+/*
+** to_float -- x rounded down to a float, or up with up set, after
+** widening it by a relative EPSILON, so that rounding in the
+** intersection tests cannot put a hit outside the box.
+*/
+static float	to_float(double x, int up)
+{
+	float	f;
+
+	x += (up ? 1.0 : -1.0) * EPSILON * (fabs(x) + 1.0);
+	f = (float)x;
+	if (up ? (double)f < x : (double)f > x)
+		f = nextafterf(f, up ? INFINITY : -INFINITY);
+	return (f);
+}
+
+/*
+** prim_ref -- Set *r to the bounds of p, as BVH item item. Returns 0 if p
+** is unbounded.
+*/
+static int		prim_ref(t_prim *p, uint32_t item, t_bvh_ref *r)
+{
+	t_vector	box[2];
+	t_vector	rad;
+	double		h;
+
+	box[0] = (t_vector){INFINITY, INFINITY, INFINITY};
+	box[1] = (t_vector){-INFINITY, -INFINITY, -INFINITY};
+	rad = (t_vector){p->radius, p->radius, p->radius};
+	h = fabs(p->limit);
+	if (p->type == PRIM_SPHERE || p->type == PRIM_HEMI_SPHERE)
+		grow(box, vsub(p->loc, rad), vadd(p->loc, rad));
+	else if (p->type == PRIM_DISK)
+		grow_disk(box, p->loc, p->normal, p->radius);
+	else if ((p->type == PRIM_CYLINDER || (p->type == PRIM_CONE &&
+		p->cos_angle > 0.0)) && p->limit != -1)
+	{
+		if (p->type == PRIM_CONE)
+			rad.x = h * p->sin_angle / p->cos_angle;
+		grow_disk(box, vadd(p->loc, vmult(p->dir, h)), p->dir, rad.x);
+		grow_disk(box, vsub(p->loc, vmult(p->dir, h)), p->dir, rad.x);
+	}
+	if (!isfinite(box[0].x + box[0].y + box[0].z + box[1].x + box[1].y +
+		box[1].z))
+		return (0);
+	*r = (t_bvh_ref){{to_float(box[0].x, 0), to_float(box[0].y, 0),
+		to_float(box[0].z, 0)}, {to_float(box[1].x, 1),
+		to_float(box[1].y, 1), to_float(box[1].z, 1)}, item};
+	return (1);
+}
+
+/*
+** order_prims -- Put b's bounded primitives first, each group in its
+** existing order, and set b->bounded.
+*/
+static void		order_prims(t_env *e, t_prim_batch *b, size_t *tmp)
+{
+	t_bvh_ref	r;
+	size_t		i;
+	size_t		k;
+
+	k = 0;
+	i = -1;
+	while (++i < b->n)
+		if (prim_ref(e->prim[b->id[i]], 0, &r))
+			tmp[k++] = b->id[i];
+	b->bounded = k;
+	i = -1;
+	while (++i < b->n)
+		if (!prim_ref(e->prim[b->id[i]], 0, &r))
+			tmp[k++] = b->id[i];
+	if (b->n)
+		memcpy(b->id, tmp, sizeof(size_t) * b->n);
+}
+
+/* Set the leaf of every element under node k. */
+static void		map_leaves(t_prim_batch *b, size_t k)
+{
+	t_bvh_node	*n;
+	size_t		i;
+
+	n = &b->bvh.node[k];
+	if (!n->count)
+	{
+		map_leaves(b, k + 1);
+		map_leaves(b, n->index);
+		return ;
+	}
+	i = (size_t)n->index - 1;
+	while (++i < (size_t)n->index + n->count)
+		b->leaf[i] = (uint32_t)k;
+}
+
+/*
+** build_prim_bvh -- Order b's elements, bounded ones first, and build a
+** BVH over the bounded ones if there are enough. The bounded elements are
+** left in leaf order; the caller copies the primitives into the reordered
+** slots.
+*/
+void			build_prim_bvh(t_env *e, t_prim_batch *b)
+{
+	size_t	*tmp;
+	size_t	i;
+
+	if (!(tmp = (size_t *)malloc(sizeof(size_t) * MAX(b->n, 1))))
+		err(MALLOC_ERROR, "build_prim_bvh", e);
+	order_prims(e, b, tmp);
+	if (b->bounded < PRIM_BVH_MIN)
+	{
+		free(tmp);
+		return ;
+	}
+	if (!(b->ref = (t_bvh_ref *)malloc(sizeof(t_bvh_ref) * b->bounded)))
+		err(MALLOC_ERROR, "build_prim_bvh", e);
+	i = -1;
+	while (++i < b->bounded)
+		prim_ref(e->prim[b->id[i]], (uint32_t)i, &b->ref[i]);
+	if (build_tree(&b->bvh, b->ref, b->bounded) == -1)
+		err(MALLOC_ERROR, "build_prim_bvh", e);
+	i = -1;
+	while (++i < b->bounded)
+		tmp[i] = b->id[b->bvh.order[i]];
+	memcpy(b->id, tmp, sizeof(size_t) * b->bounded);
+	free(tmp);
+	free(b->bvh.order);
+	b->bvh.order = NULL;
+	i = -1;
+	while (++i < b->bounded)
+		prim_ref(e->prim[b->id[i]], (uint32_t)i, &b->ref[i]);
+	b->leaf = (uint32_t *)malloc(sizeof(uint32_t) * b->bounded);
+	b->dirty = (uint8_t *)calloc(b->bvh.nodes, sizeof(uint8_t));
+	if (!b->leaf || !b->dirty)
+		err(MALLOC_ERROR, "build_prim_bvh", e);
+	map_leaves(b, 0);
+	b->built_sah = b->bvh.sah;
+}
+
+/* Surface area of node n's box. */
+static double	node_area(t_bvh_node *n)
+{
+	double	d[3];
+
+	d[0] = (double)n->hi[0] - n->lo[0];
+	d[1] = (double)n->hi[1] - n->lo[1];
+	d[2] = (double)n->hi[2] - n->lo[2];
+	return (2.0 * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]));
+}
+
+/* Grow node n's box to contain the box [lo, hi]. */
+static void		grow_node(t_bvh_node *n, float lo[3], float hi[3])
+{
+	int		a;
+
+	a = -1;
+	while (++a < 3)
+	{
+		n->lo[a] = MIN(n->lo[a], lo[a]);
+		n->hi[a] = MAX(n->hi[a], hi[a]);
+	}
+}
+
+/*
+** refit_node -- Recompute node k's box from its elements (a leaf) or its
+** children (an inner node), and mark it refit.
+*/
+static void		refit_node(t_prim_batch *b, size_t k)
+{
+	t_bvh_node	*n;
+	t_bvh_node	*left;
+	size_t		i;
+
+	n = &b->bvh.node[k];
+	left = &b->bvh.node[k + 1];
+	i = n->index;
+	if (!n->count)
+	{
+		memcpy(n->lo, left->lo, sizeof(n->lo));
+		memcpy(n->hi, left->hi, sizeof(n->hi));
+		grow_node(n, b->bvh.node[n->index].lo, b->bvh.node[n->index].hi);
+	}
+	else
+	{
+		memcpy(n->lo, b->ref[i].lo, sizeof(n->lo));
+		memcpy(n->hi, b->ref[i].hi, sizeof(n->hi));
+		while (++i < (size_t)n->index + n->count)
+			grow_node(n, b->ref[i].lo, b->ref[i].hi);
+	}
+	b->dirty[k] = 1;
+}
+
+/*
+** refit -- Refit every node marked dirty, and every inner node with a
+** dirty child, bottom-up (children come after their parent). Returns the
+** tree's SAH cost, computed as bvh_build.c does.
+*/
+static double	refit(t_prim_batch *b)
+{
+	t_bvh_node	*n;
+	size_t		k;
+	double		sah;
+
+	sah = 0.0;
+	k = b->bvh.nodes;
+	while (k--)
+	{
+		n = &b->bvh.node[k];
+		if ((n->count && b->dirty[k]) ||
+			(!n->count && (b->dirty[k + 1] || b->dirty[n->index])))
+			refit_node(b, k);
+		sah += node_area(n) * ((n->count) ? n->count * BVH_COST_FACE :
+			BVH_COST_BOX);
+	}
+	memset(b->dirty, 0, b->bvh.nodes);
+	return (sah / MAX(node_area(b->bvh.node), DBL_MIN));
+}
+
+/*
+** refit_prim_bvh -- Bring b's BVH up to date with its primitives. Returns
+** -1 if it should be rebuilt instead: a bounded primitive no longer is,
+** or the tree has degraded past PRIM_BVH_REBUILD.
+*/
+int				refit_prim_bvh(t_env *e, t_prim_batch *b)
+{
+	t_bvh_ref	r;
+	size_t		i;
+	int			moved;
+
+	moved = 0;
+	i = -1;
+	while (++i < b->bounded)
+	{
+		if (!prim_ref(e->prim[b->id[i]], (uint32_t)i, &r))
+			return (-1);
+		if (memcmp(&r, &b->ref[i], sizeof(t_bvh_ref)))
+		{
+			b->ref[i] = r;
+			b->dirty[b->leaf[i]] = 1;
+			moved = 1;
+		}
+	}
+	if (moved && (b->bvh.sah = refit(b)) > b->built_sah * PRIM_BVH_REBUILD)
+		return (-1);
+	return (0);
+}
@@ -0,0 +1,20 @@
+/*
+** clock.c -- Monotonic wall-clock helper.
+**
+** Used wherever render time is measured at a finer grain than a whole
+** frame (per-tile timing, distributed scheduling). CLOCK_MONOTONIC is
+** unaffected by system clock changes, unlike the gettimeofday() draw()
+** uses for its frame total.
+*/
+
+#include "rt.h"
+#include <time.h>
+
+/* Milliseconds since an arbitrary fixed point, with sub-ms resolution. */
+double	clock_ms(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0);
+}
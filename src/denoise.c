@@ -0,0 +1,299 @@
+/*
+** denoise.c -- Edge-aware denoising of finished frames (--denoise).
+**
+** Clean edges and soft highlights take many jittered samples per pixel,
+** and every sample is a full trace. With --denoise a frame drawn with few
+** samples is smoothed instead, by an edge-avoiding a-trous wavelet filter
+** (Dammertz et al., 2010):
+**
+**   - While tracing, each pixel gathers what its samples saw: the surface
+**     normal, the distance to it and its material's diffuse colour
+**     (denoise_gather), averaged like the colour is.
+**   - After the frame, DENOISE_PASSES passes each blur the colour with a
+**     5x5 B3-spline kernel whose taps are 1, 2, 4, ... pixels apart, so a
+**     few passes cover a wide area. Every tap is weighted down by how far
+**     its colour, normal, depth and albedo are from the pixel's: the blur
+**     stops at silhouettes, creases and material boundaries, and the
+**     colour weight tightens pass after pass, keeping shadow edges.
+**
+** It smooths the stair-stepping of edges seen with few samples; it is no
+** substitute for --super on a final render, which it slightly softens.
+**
+** The passes run on as many threads as there are cores, each over a band
+** of rows, and only over the region drawn; the result replaces the frame
+** in e->img before it is shown or exported. Grab-mode previews and
+** cancelled frames are left as they are.
+*/
+
+#include "rt.h"
+
+/* The B3-spline kernel, 1/16 (1 4 6 4 1), one axis at a time. */
+static const float	g_b3[5] = {1.0 / 16, 1.0 / 4, 3.0 / 8, 1.0 / 4,
+	1.0 / 16};
+
+/*
+** t_band -- One thread's share of a pass: rows y0 to y1 (excluded) of the
+** region d, with taps step pixels apart and colour variance var.
+*/
+typedef struct	s_band
+{
+	t_env		*e;
+	SDL_Rect	d;
+	int			y0;
+	int			y1;
+	int			step;
+	float		var;
+	pthread_t	tid;
+}				t_band;
+
+/*
+** denoise_begin -- Allocate the denoiser's buffers, the first time a frame
+** is drawn.
+*/
+void			denoise_begin(t_env *e)
+{
+	t_denoise	*n;
+	size_t		px;
+
+	if (e->denoise)
+		return ;
+	if (!(n = (t_denoise *)calloc(1, sizeof(t_denoise))))
+		err(MALLOC_ERROR, "denoise_begin", e);
+	e->denoise = n;
+	px = e->x * e->y;
+	if (!(n->normal = (float *)malloc(px * 3 * sizeof(float))) ||
+		!(n->depth = (float *)malloc(px * sizeof(float))) ||
+		!(n->albedo = (float *)malloc(px * 3 * sizeof(float))) ||
+		!(n->col = (float *)malloc(px * 3 * sizeof(float))) ||
+		!(n->tmp = (float *)malloc(px * 3 * sizeof(float))))
+		err(MALLOC_ERROR, "denoise_begin", e);
+}
+
+/* denoise_clear -- Start gathering pixel i afresh. */
+void			denoise_clear(t_env *e, size_t i)
+{
+	memset(&e->denoise->normal[i * 3], 0, 3 * sizeof(float));
+	memset(&e->denoise->albedo[i * 3], 0, 3 * sizeof(float));
+	e->denoise->depth[i] = 0;
+}
+
+/*
+** denoise_gather -- Add what the sample just intersected saw to pixel i,
+** weighted by the pixel's sample count. A miss sees the background: facing
+** the camera, DENOISE_FAR away and grey.
+*/
+void			denoise_gather(t_env *e, size_t i)
+{
+	t_vector	n;
+	t_colour	a;
+	float		w;
+	float		z;
+
+	w = 1.0 / (e->super > 1 ? e->super : 1);
+	z = DENOISE_FAR;
+	n = vneg(e->ray.dir);
+	a = (t_colour){0.5, 0.5, 0.5, 1.0};
+	if (e->hit_type)
+	{
+		z = MIN(e->t, DENOISE_FAR);
+		n = get_normal(e, vadd(e->ray.loc, vmult(e->ray.dir, e->t)));
+		a = (e->hit_type == FACE) ?
+			e->material[e->object_hit->material]->diff :
+			e->material[e->p_hit->material]->diff;
+	}
+	e->denoise->normal[i * 3] += w * n.x;
+	e->denoise->normal[i * 3 + 1] += w * n.y;
+	e->denoise->normal[i * 3 + 2] += w * n.z;
+	e->denoise->albedo[i * 3] += w * a.r;
+	e->denoise->albedo[i * 3 + 1] += w * a.g;
+	e->denoise->albedo[i * 3 + 2] += w * a.b;
+	e->denoise->depth[i] += w * z;
+}
+
+/* dist2 -- Squared distance between the 3-float entries p and q. */
+static float	dist2(const float *p, const float *q)
+{
+	return ((p[0] - q[0]) * (p[0] - q[0]) + (p[1] - q[1]) * (p[1] - q[1]) +
+		(p[2] - q[2]) * (p[2] - q[2]));
+}
+
+/*
+** tap_weight -- How much pixel q may count towards p in a pass: large for
+** neighbours of the same colour, facing the same way, at the same depth
+** and of the same material. The normal term is max(0, n.n') raised to
+** 2^DENOISE_NORMAL_SQUARES.
+*/
+static float	tap_weight(t_band *b, size_t p, size_t q)
+{
+	t_denoise	*n;
+	float		dot;
+	float		wn;
+	int			i;
+
+	n = b->e->denoise;
+	dot = n->normal[p * 3] * n->normal[q * 3] + n->normal[p * 3 + 1] *
+		n->normal[q * 3 + 1] + n->normal[p * 3 + 2] * n->normal[q * 3 + 2];
+	wn = MAX(dot, 0.0f);
+	i = DENOISE_NORMAL_SQUARES;
+	while (i--)
+		wn *= wn;
+	return (wn * expf(-dist2(&n->col[p * 3], &n->col[q * 3]) / b->var -
+		fabsf(n->depth[p] - n->depth[q]) / (DENOISE_SIGMA_Z * b->step *
+		n->depth[p] + 1e-4f) - dist2(&n->albedo[p * 3], &n->albedo[q * 3]) /
+		(DENOISE_SIGMA_A * DENOISE_SIGMA_A)));
+}
+
+/*
+** filter_pixel -- One pass at pixel (x, y): the weighted mean of its taps
+** inside the region, written to tmp.
+*/
+static void		filter_pixel(t_band *b, int x, int y)
+{
+	t_denoise	*n;
+	float		sum[4];
+	float		w;
+	size_t		p;
+	size_t		q;
+	int			k;
+
+	n = b->e->denoise;
+	p = y * b->e->x + x;
+	memset(sum, 0, sizeof(sum));
+	k = -1;
+	while (++k < 25)
+	{
+		if (x + (k % 5 - 2) * b->step < b->d.x || y + (k / 5 - 2) * b->step <
+			b->d.y || x + (k % 5 - 2) * b->step >= b->d.x + b->d.w ||
+			y + (k / 5 - 2) * b->step >= b->d.y + b->d.h)
+			continue ;
+		q = p + ((k / 5 - 2) * (int)b->e->x + k % 5 - 2) * b->step;
+		w = g_b3[k % 5] * g_b3[k / 5] * (q == p ? 1.0f : tap_weight(b, p, q));
+		sum[0] += w * n->col[q * 3];
+		sum[1] += w * n->col[q * 3 + 1];
+		sum[2] += w * n->col[q * 3 + 2];
+		sum[3] += w;
+	}
+	n->tmp[p * 3] = sum[0] / sum[3];
+	n->tmp[p * 3 + 1] = sum[1] / sum[3];
+	n->tmp[p * 3 + 2] = sum[2] / sum[3];
+}
+
+/* filter_band -- Thread entry point: one pass over the band's rows. */
+static void		*filter_band(void *q)
+{
+	t_band	*b;
+	int		x;
+	int		y;
+
+	b = (t_band *)q;
+	y = b->y0 - 1;
+	while (++y < b->y1)
+	{
+		x = b->d.x - 1;
+		while (++x < b->d.x + b->d.w)
+			filter_pixel(b, x, y);
+	}
+	return (NULL);
+}
+
+/*
+** filter_pass -- Run one pass over region d on the n bands, each but the
+** first on a thread of its own; a band whose thread cannot be created is
+** run here. The result becomes the colour for the next pass.
+*/
+static void		filter_pass(t_env *e, t_band *band, size_t n)
+{
+	float	*swap;
+	size_t	i;
+	int		ok[n];
+
+	i = 0;
+	while (++i < n)
+		ok[i] = (pthread_create(&band[i].tid, NULL, filter_band,
+			&band[i]) == 0);
+	filter_band(&band[0]);
+	i = 0;
+	while (++i < n)
+		if (ok[i])
+			pthread_join(band[i].tid, NULL);
+		else
+			filter_band(&band[i]);
+	swap = e->denoise->col;
+	e->denoise->col = e->denoise->tmp;
+	e->denoise->tmp = swap;
+}
+
+/*
+** copy_region -- Move region d of the frame into the colour buffer as
+** floats in [0, 1] (back is 0), or the filtered colour back into the frame
+** (back is 1).
+*/
+static void		copy_region(t_env *e, SDL_Rect d, int back)
+{
+	float	*c;
+	size_t	i;
+	int		x;
+	int		y;
+
+	y = d.y - 1;
+	while (++y < d.y + d.h)
+	{
+		x = d.x - 1;
+		while (++x < d.x + d.w)
+		{
+			i = y * e->x + x;
+			c = &e->denoise->col[i * 3];
+			if (back)
+				e->px[i] = (uint32_t)(MIN(c[0], 1.0f) * 255.0f + 0.5f) << 16 |
+					(uint32_t)(MIN(c[1], 1.0f) * 255.0f + 0.5f) << 8 |
+					(uint32_t)(MIN(c[2], 1.0f) * 255.0f + 0.5f);
+			else
+			{
+				c[0] = ((e->px[i] >> 16) & 0xFF) / 255.0f;
+				c[1] = ((e->px[i] >> 8) & 0xFF) / 255.0f;
+				c[2] = (e->px[i] & 0xFF) / 255.0f;
+			}
+		}
+	}
+}
+
+/*
+** denoise_frame -- Filter region d of the frame just drawn, in place:
+** DENOISE_PASSES passes, the taps twice as far apart and the colour
+** variance half as wide each time.
+*/
+void			denoise_frame(t_env *e, SDL_Rect d)
+{
+	t_band	band[DENOISE_MAX_THREADS];
+	size_t	n;
+	size_t	i;
+	int		pass;
+
+	n = (size_t)MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+	n = MIN(MIN(n, DENOISE_MAX_THREADS), (size_t)d.h);
+	copy_region(e, d, 0);
+	pass = -1;
+	while (++pass < DENOISE_PASSES)
+	{
+		i = -1;
+		while (++i < n)
+			band[i] = (t_band){e, d, d.y + d.h * i / n,
+				d.y + d.h * (i + 1) / n, 1 << pass,
+				DENOISE_SIGMA_C * DENOISE_SIGMA_C / (1 << pass), 0};
+		filter_pass(e, band, n);
+	}
+	copy_region(e, d, 1);
+}
+
+void			free_denoise(t_env *e)
+{
+	if (!e->denoise)
+		return ;
+	free(e->denoise->normal);
+	free(e->denoise->depth);
+	free(e->denoise->albedo);
+	free(e->denoise->col);
+	free(e->denoise->tmp);
+	free(e->denoise);
+	e->denoise = NULL;
+}
@@ -29,13 +29,41 @@
 ** Shadow integration: before computing a light's contribution, a shadow ray
 ** is cast. The shadow factor (0.0 = fully lit, 1.0 = fully blocked) scales
 ** the light contribution via (1 - shadow). Partially transparent objects
-** produce partial shadows.
+** produce partial shadows. For a primary sample with a G-buffer, a shadow
+** already known is taken from it instead (light_shadow).
 **
 ** After accumulating all lights, each RGB channel is clamped to [0, 1].
 */
 
 #include "diffuse.h"
 
+/*
+** light_shadow — The shadow from d->light: known for the primary sample
+** being shaded (e->vis, src/gbuffer.c), or traced, and kept there if it is
+** all or nothing.
+*/
+
+static double	light_shadow(t_env *e, t_diffuse *d)
+{
+	uint32_t	*w;
+	int			shift;
+	int			code;
+	double		shadow;
+
+	if (!e->vis)
+		return (in_shadow(e, d->light));
+	w = &e->vis[d->index / VIS_PER_WORD];
+	shift = d->index % VIS_PER_WORD * 2;
+	code = (*w >> shift) & 3;
+	if (code == VIS_LIT || code == VIS_BLOCKED)
+		return (code == VIS_LIT ? 0.0 : 1.0);
+	shadow = in_shadow(e, d->light);
+	if (code == VIS_UNKNOWN)
+		*w |= (uint32_t)(shadow == 0.0 ? VIS_LIT : shadow == 1.0 ?
+			VIS_BLOCKED : VIS_PARTIAL) << shift;
+	return (shadow);
+}
+
 /*
 ** diffuse_colour — Compute and accumulate one light's contribution.
 **
@@ -55,7 +83,7 @@ static void		diffuse_colour(t_env *e, t_diffuse *d)
 	t_vector	temp_colour;
 	double		shadow;
 
-	shadow = in_shadow(e, d->light);
+	shadow = light_shadow(e, d);
 	if (shadow < 1.0)
 	{
 		/* L = unit vector from hit point toward light source */
@@ -112,6 +140,7 @@ t_colour		prim_diffuse(t_env *e)
 	while (i--)
 	{
 		d.light = e->light[i];
+		d.index = i;
 		diffuse_colour(e, &d);
 	}
 	/* Clamp RGB to [0, 1] — multiple lights can push values above 1.0 */
@@ -135,14 +164,18 @@ t_colour		face_diffuse(t_env *e)
 
 	d.mat = e->material[e->object_hit->material];
 	d.p = vadd(e->ray.loc, vmult(e->ray.dir, e->t));
-	/* Mesh faces store a pre-computed normal; no need for get_normal() */
-	d.n = *e->o_hit->n;
+	/*
+	** Mesh faces store a pre-computed normal; no need for get_normal().
+	** intersect_object left it in scene space for this instance.
+	*/
+	d.n = e->o_normal;
 	d.colour = (t_vector){0.0, 0.0, 0.0};
 	d.intensity = 1.0;
 	i = e->lights;
 	while (i--)
 	{
 		d.light = e->light[i];
+		d.index = i;
 		diffuse_colour(e, &d);
 	}
 	d.colour.x = (d.colour.x > 1.0) ? 1.0 : d.colour.x;
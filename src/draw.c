@@ -31,6 +31,32 @@
 **    Each thread accumulates ray counts in g_tls_stats (_Thread_local),
 **    then atomically merges them into g_stats at thread exit. This avoids
 **    per-ray atomic operations that would destroy performance.
+**
+** 6. FRAME CANCELLATION
+**    With a window, frames are drawn by the render thread
+**    (src/render_thread.c), and a frame is stale as soon as a newer one is
+**    asked for: new camera or grab input will be drawn from a different
+**    view. Asking advances g_frame_gen; every tile checks its generation
+**    before each pixel and stops once it is no longer current, so the
+**    stale frame is abandoned within a pixel's work.
+**
+** 7. G-BUFFER
+**    With --watch the primary hits are kept (src/gbuffer.c), so that a
+**    frame after an edit of lights or materials only reshades: each
+**    pixel traced in the current epoch finds its hits there instead of
+**    in intersect_scene.
+**
+** 8. DENOISING
+**    With --denoise each pixel also gathers the normals, depths and
+**    albedos its samples saw, which guide an edge-aware filter over the
+**    finished frame (src/denoise.c).
+**
+** 9. REGIONS
+**    A frame may cover only part of the image (--crop, or a rectangle
+**    dragged out after pressing B). The tiles stay those of the full
+**    frame's grid, and only the ones overlapping the region are drawn,
+**    each only inside it; a tile's jitter skips the pixels left out, so
+**    every pixel drawn is the one a full frame would draw.
 */
 
 #include "draw.h"
@@ -64,7 +90,10 @@ static uint32_t	xorshift32(uint32_t *state)
 ** Steps:
 **   1. Compute the ray direction from camera through pixel (x, y) on the
 **      image plane (get_ray_dir).
-**   2. Find the nearest intersection with any object (intersect_scene).
+**   2. Find the nearest intersection with any object (intersect_scene),
+**      or take it from the G-buffer if the pixel reuses it there; a hit
+**      traced is kept in the G-buffer, if any. With --denoise, what the
+**      sample saw is gathered for the filter.
 **   3. If an object was hit:
 **      - Normal mode: compute full shading with find_colour (diffuse,
 **        specular, reflections, refractions).
@@ -80,9 +109,19 @@ static uint32_t	trace_pixel(t_chunk *c, double x, double y)
 {
 	++g_tls_stats.rays;
 	++g_tls_stats.primary_rays;
+	++g_tls_stats.depth[0];
 	c->e->p_hit = NULL;
 	get_ray_dir(c->e, x, y);
-	intersect_scene(c->e);
+	if (c->reuse)
+		gbuf_load(c->e, c->g++);
+	else
+	{
+		intersect_scene(c->e);
+		if (c->g)
+			gbuf_store(c->e, c->g++);
+	}
+	if (c->e->denoise)
+		denoise_gather(c->e, c->d.y * c->e->x + c->x);
 	return ((c->e->p_hit && !c->e->p_hit->s_bool &&
 		!(c->e->flags & KEY_G)) ?
 		find_colour(c->e) : find_base_colour(c->e));
@@ -135,167 +174,481 @@ static uint32_t	supersample(t_chunk *c, double px, double py, uint32_t *seed)
 }
 
 /*
-** draw_chunk -- Thread entry point: renders all pixels in one 64x64 tile.
-**
-** Each thread receives a t_chunk* with its own copy of the environment
-** and the bounding rectangle of its tile.
+** shade_pixel -- Colour of pixel (c->x, c->d.y), supersampled if enabled.
+** With a G-buffer, the pixel's samples are reused if the frame only
+** reshades and they were traced in the current epoch; otherwise they are
+** traced and the pixel stamped with it.
+*/
+static uint32_t	shade_pixel(t_chunk *c, uint32_t *seed)
+{
+	t_gbuf	*g;
+	size_t	i;
+
+	if (c->e->denoise)
+		denoise_clear(c->e, c->d.y * c->e->x + c->x);
+	if ((g = c->e->gbuf))
+	{
+		i = c->d.y * c->e->x + c->x;
+		c->g = &g->sample[i * g->super];
+		c->reuse = c->e->reshade && g->stamp[i] == g->epoch;
+		g->stamp[i] = g->epoch;
+	}
+	if (c->e->super > 1)
+		return (supersample(c, (double)c->x, (double)c->d.y, seed));
+	return (trace_pixel(c, (double)c->x, (double)c->d.y));
+}
+
+/*
+** heat_pixel -- Shade one pixel and record what it cost (--heatmap):
+** the growth of this thread's ray and intersection-test counters.
+*/
+static uint32_t	heat_pixel(t_chunk *c, uint32_t *seed, size_t i)
+{
+	size_t		rays;
+	size_t		tests;
+	uint32_t	col;
+
+	rays = g_tls_stats.rays;
+	tests = g_tls_stats.intersection_tests;
+	col = shade_pixel(c, seed);
+	c->e->heat->rays[i] = g_tls_stats.rays - rays;
+	c->e->heat->tests[i] = g_tls_stats.intersection_tests - tests;
+	return (col);
+}
+
+/*
+** heat_tile -- Record the tile totals for --heatmap. Called before the
+** thread-local counters are merged and cleared, so they hold exactly
+** this tile's work.
+*/
+static void		heat_tile(t_chunk *c, double start)
+{
+	t_heat_tile	*t;
+
+	t = &c->e->heat->tile[c->id];
+	t->d = c->clip;
+	t->ms = clock_ms() - start;
+	t->rays = g_tls_stats.rays;
+	t->tests = g_tls_stats.intersection_tests;
+}
+
+/* current -- Whether the tile's frame is still the one being drawn. */
+static int		current(t_chunk *c)
+{
+	return (atomic_load_explicit(&g_frame_gen, memory_order_relaxed) ==
+		c->gen);
+}
+
+/*
+** skip_pixels -- Advance the jitter seed past n pixels not drawn, as if
+** they had been supersampled (two numbers per sample).
+*/
+static void		skip_pixels(t_chunk *c, uint32_t *seed, int n)
+{
+	size_t	i;
+
+	if (c->e->super <= 1 || n <= 0)
+		return ;
+	i = 2 * c->e->super * n;
+	while (i--)
+		xorshift32(seed);
+}
+
+/*
+** clip_chunk -- Narrow c->clip to the part of the region inside the tile,
+** whose right edge, clamped to the image, is returned. stopx and stopy
+** are the clip's right and bottom edges.
+*/
+static int		clip_chunk(t_chunk *c)
+{
+	int		right;
+	int		x;
+	int		y;
+
+	right = MIN(c->d.x + c->d.w, (int)c->e->x);
+	x = MAX(c->clip.x, c->d.x);
+	y = MAX(c->clip.y, c->d.y);
+	c->stopx = MAX(MIN(c->clip.x + c->clip.w, right), x);
+	c->stopy = MAX(MIN(c->clip.y + c->clip.h,
+		MIN(c->d.y + c->d.h, (int)c->e->y)), y);
+	c->clip = (SDL_Rect){x, y, c->stopx - x, c->stopy - y};
+	return (right);
+}
+
+/*
+** render_chunk -- Render every pixel of one tile into c->px.
 **
 ** The PRNG seed is derived deterministically from the tile's (x, y)
 ** position using two primes (7919, 104729), so the same tile always
 ** produces the same jitter pattern. This makes renders reproducible
-** even though threads may execute in any order.
+** even though threads may execute in any order -- and lets distributed
+** workers (src/net/worker.c) produce bit-identical tiles.
+**
+** Only the pixels inside c->clip are drawn; the seed is advanced past the
+** others (skip_pixels), so each pixel keeps the jitter it has in a frame
+** of the whole tile.
+**
+** With --heatmap (e->heat set, not in grab mode) each pixel's cost and
+** the tile's wall time are recorded as well.
 **
-** After rendering all pixels, the thread atomically merges its local
-** ray-count statistics into the global g_stats, then cleans up.
+** A tile stops early, leaving the rest of its pixels as they were, once
+** its frame is cancelled (c->gen is no longer g_frame_gen).
+**
+** After rendering all pixels, the calling thread's local ray-count
+** statistics are atomically merged into the global g_stats.
 */
-static void		*draw_chunk(void *q)
+void			render_chunk(t_chunk *c)
 {
-	t_chunk		*c;
 	uint32_t	*px;
 	uint32_t	seed;
+	double		start;
+	int			heat;
+	int			right;
 
-	c = (t_chunk *)q;
+	heat = c->e->heat && !(c->e->flags & KEY_G);
+	start = heat ? clock_ms() : 0;
+	c->g = NULL;
+	c->reuse = 0;
 	/* Deterministic seed from tile position for reproducible jitter */
 	seed = (uint32_t)(c->d.x * 7919 + c->d.y * 104729 + 1);
-	/* Clamp tile edges to image bounds (handles partial tiles at edges) */
-	c->stopx = MIN(c->d.x + c->d.w, (int)c->e->x);
-	c->stopy = MIN(c->d.y + c->d.h, (int)c->e->y);
-	while (c->d.y < c->stopy)
+	/* Clamp to the region and the image (handles partial tiles at edges) */
+	right = clip_chunk(c);
+	skip_pixels(c, &seed, (c->clip.y - c->d.y) * (right - c->d.x));
+	c->d.y = c->clip.y;
+	while (c->d.y < c->stopy && current(c))
 	{
-		c->x = c->d.x;
-		px = &c->px[c->d.y * c->e->x + c->d.x];
-		while (c->x < c->stopx)
+		skip_pixels(c, &seed, c->clip.x - c->d.x);
+		c->x = c->clip.x;
+		px = &c->px[c->d.y * c->e->x + c->x];
+		while (c->x < c->stopx && current(c))
 		{
-			if (c->e->super > 1)
-				*px++ = supersample(c, (double)c->x,
-						(double)c->d.y, &seed);
-			else
-				*px++ = trace_pixel(c, (double)c->x,
-						(double)c->d.y);
+			*px++ = heat ? heat_pixel(c, &seed, c->d.y * c->e->x + c->x) :
+				shade_pixel(c, &seed);
 			++c->x;
 		}
+		skip_pixels(c, &seed, right - c->stopx);
 		++c->d.y;
 	}
+	if (heat)
+		heat_tile(c, start);
 	/* Merge thread-local stats into global counters atomically */
-	atomic_fetch_add(&g_stats.rays, g_tls_stats.rays);
-	atomic_fetch_add(&g_stats.primary_rays, g_tls_stats.primary_rays);
-	atomic_fetch_add(&g_stats.reflection_rays, g_tls_stats.reflection_rays);
-	atomic_fetch_add(&g_stats.refraction_rays, g_tls_stats.refraction_rays);
-	atomic_fetch_add(&g_stats.shadow_rays, g_tls_stats.shadow_rays);
-	atomic_fetch_add(&g_stats.intersection_tests, g_tls_stats.intersection_tests);
-	memset(&g_tls_stats, 0, sizeof(t_thread_stats));
+	stats_merge();
+}
+
+/*
+** draw_chunk -- Thread entry point: renders all pixels in one 64x64 tile.
+**
+** Each thread receives a t_chunk* with its own copy of the environment
+** and the bounding rectangle of its tile, renders it, then cleans up.
+** With --perf the thread's hardware counters bracket the render; with
+** --trace the tile and the whole thread lifetime are recorded. The
+** frame's count of finished tiles is then advanced, waking p_join, and a
+** tile that stopped early marks the frame cancelled.
+*/
+static void		*draw_chunk(void *q)
+{
+	t_chunk		*c;
+	t_perf		perf;
+	double		thread;
+	double		tile;
+	SDL_Rect	d;
+
+	thread = trace_now();
+	c = (t_chunk *)q;
+	d = c->d;
+	if (c->e->opt.perf)
+		perf_begin(&perf);
+	tile = trace_now();
+	render_chunk(c);
+	trace_span("tile", tile, d.x, d.y);
+	if (c->e->opt.perf)
+		perf_end(&perf);
+	if (c->m)
+	{
+		pthread_mutex_lock(&c->m->lock);
+		if (c->d.y < c->stopy)
+			c->m->stopped = 1;
+		c->m->rect[c->m->done++] = c->clip;
+		pthread_cond_signal(&c->m->cond);
+		pthread_mutex_unlock(&c->m->lock);
+	}
 	free(c->e);
 	free(c);
+	trace_span("thread", thread, d.x, d.y);
 	pthread_exit(0);
 }
 
+/*
+** wait_tiles -- Wait until more than shown tiles are done. Returns how
+** many are.
+*/
+static size_t	wait_tiles(t_make_chunks *m, size_t shown)
+{
+	size_t	done;
+
+	pthread_mutex_lock(&m->lock);
+	while (m->done <= shown)
+		pthread_cond_wait(&m->cond, &m->lock);
+	done = m->done;
+	pthread_mutex_unlock(&m->lock);
+	return (done);
+}
+
+/*
+** blit_frame -- Show the n tiles in rect, just finished, in the window:
+** copy them to the window surface and update only them. The render
+** thread leaves the window to the event loop, and only publishes them.
+*/
+static void		blit_frame(t_env *e, SDL_Surface *img, SDL_Rect *rect,
+	size_t n)
+{
+	SDL_Rect	to;
+	double		start;
+	double		span;
+	size_t		i;
+
+	if (!e->win)
+		return ;
+	start = clock_ms();
+	span = trace_now();
+	i = -1;
+	while (++i < n)
+	{
+		to = rect[i];
+		if (e->render)
+			render_publish(e->render, img, &rect[i]);
+		else
+			SDL_BlitSurface(img, &rect[i], e->win_img, &to);
+	}
+	trace_span("SDL_BlitSurface", span, n, -1);
+	if (!e->render)
+	{
+		span = trace_now();
+		SDL_UpdateWindowSurfaceRects(e->win, rect, n);
+		trace_span("SDL_UpdateWindowSurface", span, n, -1);
+	}
+	g_stats.blit_ms += clock_ms() - start;
+}
+
 /*
 ** p_join -- Wait for all rendering threads to complete.
 **
-** As each thread finishes, blit the rendered surface to the window and
-** update the display. This provides progressive rendering feedback:
-** the user sees tiles appearing one by one as threads complete.
+** Whenever tiles have finished, show them (blit_frame).
+** This provides progressive rendering feedback: the user sees tiles
+** appearing as threads complete.
+** Time spent blitting is accumulated into g_stats.blit_ms. With --trace,
+** each wait, blit and window update is a separate timeline slice.
+** Headless renders (no window) only wait.
+**
+** If any tile stopped early, the frame was cancelled: e->cancelled tells
+** draw_frame.
 */
 static void		p_join(t_env *e, SDL_Surface *img, t_make_chunks *m)
 {
-	while (m->thread--)
+	size_t	shown;
+	size_t	done;
+	double	span;
+
+	shown = 0;
+	done = 0;
+	while (done < m->tids)
 	{
-		pthread_join(m->tid[m->thread], NULL);
-		SDL_BlitSurface(img, NULL, e->win_img, NULL);
-		SDL_UpdateWindowSurface(e->win);
+		span = trace_now();
+		done = wait_tiles(m, shown);
+		trace_span("p_join wait", span, done, -1);
+		if (done > shown)
+			blit_frame(e, img, &m->rect[shown], done - shown);
+		shown = done;
 	}
+	e->cancelled = m->stopped;
+	while (m->thread--)
+		pthread_join(m->tid[m->thread], NULL);
 }
 
 /*
 ** make_chunks -- Divide the image into 64x64 tiles and spawn one thread each.
 **
-** The image (of size d->w x d->h) is partitioned into a grid of 64x64 tiles.
-** Tiles at the right and bottom edges may be smaller than 64x64 (handled by
-** clamping in draw_chunk).
+** The image is partitioned into a grid of 64x64 tiles, and the tiles that
+** overlap region d are drawn. Tiles at the right and bottom edges may be
+** smaller than 64x64, and tiles at the region's edges cover only part of
+** it (handled by clamping in render_chunk).
 **
 ** For each tile:
-**   1. Allocate a t_chunk with the tile bounds.
+**   1. Allocate a t_chunk with the tile bounds and the region.
 **   2. Copy the entire environment (copy_env) so the thread has private state.
 **   3. Point px at the SDL surface pixel buffer (threads write to disjoint
 **      regions, so no locking is needed).
-**   4. Spawn a pthread running draw_chunk.
+**   4. Spawn a pthread running draw_chunk, in the current frame
+**      generation.
 **
 ** After all threads are spawned, p_join waits for them all to finish.
 */
 static void		make_chunks(t_env *e, SDL_Rect *d, SDL_Surface *img)
 {
 	t_make_chunks	m;
+	double			span;
+	size_t			gen;
+	size_t			cols;
 
-	m.tids = ceil((double)d->w / 64.0) * ceil((double)d->h / 64.0);
+	span = trace_now();
+	cols = (e->x + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	m.tids = ((d->x + d->w - 1) / CHUNK_SIZE - d->x / CHUNK_SIZE + 1) *
+		((d->y + d->h - 1) / CHUNK_SIZE - d->y / CHUNK_SIZE + 1);
 	g_stats.threads = m.tids;
 	m.tid = (pthread_t *)malloc(sizeof(pthread_t) * m.tids);
+	m.rect = (SDL_Rect *)malloc(sizeof(SDL_Rect) * m.tids);
 	m.thread = 0;
-	m.chunk_y = 0;
-	while (m.chunk_y * 64 < (size_t)d->h)
+	m.done = 0;
+	m.stopped = 0;
+	pthread_mutex_init(&m.lock, NULL);
+	pthread_cond_init(&m.cond, NULL);
+	gen = atomic_load(&g_frame_gen);
+	m.chunk_y = d->y / CHUNK_SIZE;
+	while (m.chunk_y * CHUNK_SIZE < (size_t)(d->y + d->h))
 	{
-		m.chunk_x = 0;
-		while (m.chunk_x * 64 < (size_t)d->w)
+		m.chunk_x = d->x / CHUNK_SIZE;
+		while (m.chunk_x * CHUNK_SIZE < (size_t)(d->x + d->w))
 		{
 			m.c = (t_chunk *)malloc(sizeof(t_chunk));
 			m.c->px = (uint32_t *)img->pixels;
 			m.c->e = copy_env(e);
-			m.c->d = (SDL_Rect){m.chunk_x * 64, m.chunk_y * 64, 64, 64};
+			m.c->id = m.chunk_y * cols + m.chunk_x;
+			m.c->clip = *d;
+			m.c->gen = gen;
+			m.c->m = &m;
+			m.c->d = (SDL_Rect){m.chunk_x * CHUNK_SIZE, m.chunk_y * CHUNK_SIZE,
+				CHUNK_SIZE, CHUNK_SIZE};
 			pthread_create(&m.tid[m.thread++], NULL, draw_chunk, (void *)m.c);
 			++m.chunk_x;
 		}
 		++m.chunk_y;
 	}
+	trace_span("spawn threads", span, m.tids, -1);
 	p_join(e, img, &m);
+	pthread_cond_destroy(&m.cond);
+	pthread_mutex_destroy(&m.lock);
 	free(m.tid);
+	free(m.rect);
+}
+
+/*
+** denoise -- Filter region d of the frame just drawn and show the result
+** in place of the tiles shown while it was drawn.
+*/
+static void		denoise(t_env *e, SDL_Rect d)
+{
+	double	span;
+
+	span = trace_now();
+	denoise_frame(e, d);
+	trace_span("denoise", span, -1, -1);
+	blit_frame(e, e->img, &d, 1);
 }
 
 /*
 ** render -- Set up the camera and launch multithreaded rendering.
+** The primitive batches are brought up to date first, since grab mode and
+** key presses edit primitives between frames. Records the camera setup
+** (including that update) and tracing phase times; tracing excludes the
+** blits p_join performs while waiting for threads.
 */
 static void		render(t_env *e, SDL_Rect d)
 {
+	double	start;
+
+	start = clock_ms();
+	update_prim_batches(e);
 	setup_camera_plane(e);
+	g_stats.camera_ms = clock_ms() - start;
+	trace_span("camera setup", start, -1, -1);
+	start = clock_ms();
 	make_chunks(e, &d, e->img);
+	g_stats.trace_ms = clock_ms() - start - g_stats.blit_ms;
 }
 
 /*
-** draw -- Top-level render call. Renders a full frame and prints statistics.
+** draw_frame -- Render a full frame and print statistics.
 **
 ** In normal mode:
-**   1. Dims the previous frame (half_bytes halves every byte in the surface,
+**   1. Dims the previous frame in region d (half_bytes halves every byte,
 **      creating a fade effect so the user sees something while waiting).
-**   2. Renders the new frame with full lighting, reflections, and refractions.
-**   3. Prints render time and per-category ray counts.
+**   2. Resets the statistics, so everything reported covers this frame.
+**   3. Renders the new frame with full lighting, reflections, and refractions.
+**   4. Prints render time and per-category ray counts (src/stats.c).
+**   5. With --stats, appends the frame's JSON document; with --heatmap,
+**      writes the frame's cost heatmap (src/heatmap.c).
+** With --denoise the finished frame is filtered (src/denoise.c) and shown
+** again before its time is taken, so the time includes the filter.
+**
+** A frame cancelled for a newer one (p_join) only reports that it was:
+** its statistics cover part of a frame. Nor is the frame after one dimmed,
+** as the image is already part old, part new.
+**
+** Either way, with --trace the frame's timeline is flushed (src/trace.c).
+** With --watch the G-buffer is readied first (gbuf_begin), which starts a
+** new epoch of primary hits unless the frame only reshades.
 **
 ** In grab mode (KEY_G):
 **   Renders with flat shading only (no dimming, no stats) for fast
 **   interactive camera positioning.
 */
-void			draw(t_env *e, SDL_Rect d)
+void			draw_frame(t_env *e, SDL_Rect d)
 {
-	struct timeval	tv;
-	struct timeval	tv2;
-	size_t			sec;
+	double	start;
+	int		dim;
 
+	dim = !e->cancelled;
+	e->cancelled = 0;
+	if (e->opt.watch)
+		gbuf_begin(e);
 	if (!(e->flags & KEY_G))
 	{
-		half_bytes(e->img);
-		SDL_UpdateWindowSurface(e->win);
-		gettimeofday(&tv, NULL);
+		if (dim)
+			half_bytes(e->img, d);
+		if (dim && e->render)
+			render_publish(e->render, e->img, &d);
+		else if (e->win && dim)
+			SDL_UpdateWindowSurfaceRects(e->win, &d, 1);
+		stats_reset();
+		if (e->opt.heatmap)
+			heatmap_begin(e);
+		if (e->opt.denoise)
+			denoise_begin(e);
+		start = clock_ms();
 		render(e, d);
-		gettimeofday(&tv2, NULL);
-		sec = tv2.tv_sec * 1000000 - tv.tv_sec * 1000000;
-		sec += tv2.tv_usec - tv.tv_usec;
-		printf("Frame drawn in %zu.%06zu seconds\n", sec / 1000000,
-			sec % 1000000);
-		printf("Rendered using %zu threads\n", atomic_load(&g_stats.threads));
-		printf("Total rays: %zu\n", atomic_load(&g_stats.rays));
-		printf("Primary rays: %zu\n", atomic_load(&g_stats.primary_rays));
-		printf("Reflection rays: %zu\n", atomic_load(&g_stats.reflection_rays));
-		printf("Refraction rays: %zu\n", atomic_load(&g_stats.refraction_rays));
-		printf("Shadow rays: %zu\n", atomic_load(&g_stats.shadow_rays));
-		printf("Intersection tests: %zu\n", atomic_load(&g_stats.intersection_tests));
+		if (e->opt.denoise && !e->cancelled)
+			denoise(e, d);
+		g_stats.frame_ms = clock_ms() - start;
+		trace_span("frame", start, g_stats.frame, -1);
+		if (e->cancelled)
+		{
+			printf("Frame cancelled after %.1f ms\n", g_stats.frame_ms);
+			trace_flush();
+			return ;
+		}
+		stats_print();
+		if (e->reshade)
+			puts("Reshaded: primary hits reused from the G-buffer");
+		if (e->opt.perf)
+			perf_print();
+		if (e->opt.stats)
+			stats_write_json(e);
+		if (e->opt.heatmap)
+			heatmap_write(e);
 	}
 	else
 		render(e, d);
+	trace_flush();
+}
+
+/*
+** draw -- Top-level render call. With a window the frame is asked of the
+** render thread, and draw returns at once; otherwise it is drawn here.
+*/
+void			draw(t_env *e, SDL_Rect d)
+{
+	if (e->render)
+		render_request(e, d);
+	else
+		draw_frame(e, d);
 }
@@ -44,6 +44,7 @@ void	exit_rt(t_env *e, int code)
 {
 	if (code != USAGE_ERROR)
 	{
+		render_stop(e);
 		if (e->file_name)
 			free(e->file_name);
 		if (e->img)
@@ -54,8 +55,17 @@ void	exit_rt(t_env *e, int code)
 			SDL_DestroyWindow(e->win);
 		free_light(e->light, e->lights);
 		free_material(e->material, e->materials);
+		free_mat_index(e);
 		free_object(e->object, e->objects);
+		wait_bvh_builds(e);
+		free_mesh(e->mesh, e->meshes);
 		free_prim(&e->prim, e->prims);
+		free_prim_batches(e);
+		free_heatmap(e);
+		free_gbuf(e);
+		free_denoise(e);
+		watch_close(e);
+		trace_close();
 	}
 	SDL_Quit();
 	exit(0);
@@ -67,6 +77,9 @@ void	exit_rt(t_env *e, int code)
 ** "\e[0m" resets. System errors (code <= 15) use perror() to append
 ** the errno string (e.g., "Permission denied"). Format errors use puts().
 ** USAGE_ERROR (32) is a static string -- not heap-allocated, so not freed.
+** While a scene reload parses (e->on_error set, see reload_scene.c), the
+** error is reported the same way but jumps back to the reload instead of
+** exiting, and the live scene is kept.
 */
 void	err(int error_no, char *function, t_env *e)
 {
@@ -79,10 +92,18 @@ void	err(int error_no, char *function, t_env *e)
 		error = strjoin(function, ": Malloc error");
 	else if (error_no == FREE_ERROR)
 		error = strjoin(function, ": Free error");
+	else if (error_no == SOCKET_ERROR)
+		error = strjoin(function, ": Socket error");
 	else if (error_no == FILE_FORMAT_ERROR)
 		error = strjoin(function, ": Invalid file format");
 	else if (error_no == USAGE_ERROR)
-		error = "Invalid Usage\n    ./RT [SCENE FILE]";
+		error = "Invalid Usage\n    ./RT [--worker ADDR | --coordinator ADDR]"
+			"\n        [--heatmap PREFIX] [--stats FILE] [--perf] [--trace FILE]"
+			"\n        [--output FILE] [--crop X Y W H] [--size W H] [--super N]"
+			"\n        [--maxdepth N] [--denoise]"
+			"\n        [--bvh-cache DIR] [--watch] [--fps N] [SCENE FILE]";
+	else
+		error = strjoin(function, ": Error");
 	if (error_no > 15)
 		puts(error);
 	else
@@ -90,5 +111,7 @@ void	err(int error_no, char *function, t_env *e)
 	/* Only free heap-allocated error strings (codes < 32). */
 	if (error_no < 32)
 		strdel(&error);
+	if (e && e->on_error)
+		longjmp(*e->on_error, error_no);
 	exit_rt(e, error_no);
 }
@@ -10,23 +10,12 @@
 ** expects R, G, B byte order. The write_image function swaps the R and
 ** B channels via bit manipulation before writing 3 bytes per pixel.
 **
-** Output filename: <scene_name>_<unix_timestamp>.ppm
+** Output filename: <scene_name>_<unix_timestamp>.ppm, or the --output path
+** for headless renders (export_ppm), which write only the --crop region.
 */
 
 #include "rt.h"
 
-/* Convert an integer to a heap-allocated decimal string via snprintf. */
-char	*itoa(int n)
-{
-	char	*str;
-	int		len;
-
-	len = snprintf(NULL, 0, "%d", n);
-	str = malloc(len + 1);
-	snprintf(str, len + 1, "%d", n);
-	return (str);
-}
-
 /*
 ** Write raw pixel data in PPM P6 format.
 ** For each pixel, swap R and B channels to convert from SDL's in-memory
@@ -35,50 +24,64 @@ char	*itoa(int n)
 **   - Bits [15:8]  (G) stays in place
 **   - Bits [23:16] (R in SDL) moved to bits [7:0]   -> becomes B position
 ** Only 3 bytes are written per pixel (the alpha byte is skipped).
+** The pixels written are those of rectangle d, row by row.
 */
-static void		write_image(t_env *e, int fd)
+static void		write_image(t_env *e, int fd, SDL_Rect d)
 {
-	size_t		total;
 	size_t		index;
+	size_t		end;
 	uint32_t	px;
 	uint32_t	px_rgb;
+	int			row;
 
-	total = e->x * e->y;
-	index = 0;
-	while (index != total)
+	row = d.y - 1;
+	while (++row < d.y + d.h)
 	{
-		px = e->px[index++];
-		px_rgb = ((px & 0xFF) << 16) | (px & 0xFF00) | ((px & 0xFF0000) >> 16);
-		write(fd, &px_rgb, 3);
+		index = row * e->x + d.x;
+		end = index + d.w;
+		while (index != end)
+		{
+			px = e->px[index++];
+			px_rgb = ((px & 0xFF) << 16) | (px & 0xFF00) |
+				((px & 0xFF0000) >> 16);
+			write(fd, &px_rgb, 3);
+		}
 	}
 }
 
+/*
+** Write rectangle d of the rendered image to path as a PPM: the P6 header
+** (magic number, comment, dimensions, max color value) then the raw pixel
+** data.
+** The header goes through dprintf on the same descriptor as the pixels,
+** so it always lands in front of them.
+*/
+void			export_ppm(t_env *e, char *path, SDL_Rect d)
+{
+	int		fd;
+
+	if ((fd = open(path, O_WRONLY | O_TRUNC | O_CREAT, 0666)) == -1)
+		err(FILE_OPEN_ERROR, "Could not export rendered image", e);
+	dprintf(fd, "P6\n# Exported by the best RT project ever!\n%d %d\n255\n",
+		d.w, d.h);
+	write_image(e, fd, d);
+	close(fd);
+}
+
 /*
 ** Export the rendered image to a PPM file.
 ** Generates a unique filename using the scene name and current unix
-** timestamp. Writes the P6 header (magic number, comment, dimensions,
-** max color value) then the raw pixel data.
+** timestamp. Frames still being drawn are finished first.
 */
 void			export(t_env *e)
 {
-	int		fd;
 	char	*temp;
 
 	fputs("Exporting rendered image... ", stdout);
+	render_wait(e);
 	temp = NULL;
 	asprintf(&temp, "%s_%ld.ppm", e->file_name, time(NULL));
-	if ((fd = open(temp, O_WRONLY | O_TRUNC | O_CREAT, 0666)) == -1)
-		err(FILE_OPEN_ERROR, "Could not export rendered image", e);
+	export_ppm(e, temp, (SDL_Rect){0, 0, e->x, e->y});
 	strdel(&temp);
-	fprintf(fdopen(fd, "w"), "%s\n", "P6\n# Exported by the best RT project ever!");
-	temp = itoa(e->x);
-	fputs(temp, fdopen(fd, "w"));
-	fputs(" ", fdopen(fd, "w"));
-	strdel(&temp);
-	temp = itoa(e->y);
-	fprintf(fdopen(fd, "w"), "%s\n", temp);
-	fprintf(fdopen(fd, "w"), "%s\n", "255");
-	write_image(e, fd);
-	close(fd);
 	fputs("Done\n", stdout);
 }
@@ -0,0 +1,37 @@
+/*
+** free_mesh.c -- Deallocate the meshes loaded from OBJ files.
+**
+** Each t_mesh owns a heap-allocated file path string and flat arrays:
+** vertices, face indices, face normals, BVH nodes and the BVH face order.
+** Those are freed (a BVH loaded from the cache is unmapped instead), then
+** the mesh struct itself, then the top-level array.
+*/
+
+#include "rt.h"
+#include <sys/mman.h>
+
+void	free_mesh(t_mesh **mesh, size_t num_mesh)
+{
+	if (mesh)
+	{
+		while (num_mesh--)
+			if (mesh[num_mesh])
+			{
+				free(mesh[num_mesh]->file);
+				free(mesh[num_mesh]->v);
+				free(mesh[num_mesh]->idx);
+				free(mesh[num_mesh]->n);
+				if (mesh[num_mesh]->map)
+					munmap(mesh[num_mesh]->map, mesh[num_mesh]->map_size);
+				else
+				{
+					free(mesh[num_mesh]->bvh.node);
+					free(mesh[num_mesh]->bvh.order);
+				}
+				free(mesh[num_mesh]);
+				mesh[num_mesh] = NULL;
+			}
+		free(mesh);
+		mesh = NULL;
+	}
+}
@@ -0,0 +1,166 @@
+/*
+** gbuffer.c -- Primary hits kept from frame to frame (--watch).
+**
+** Tuning lights and materials in the scene file changes nothing a primary
+** ray hits, yet every frame would trace every one of them again. With
+** --watch each primary sample's hit is kept in a G-buffer: what
+** intersect_scene left in the environment (the distance, the primitive
+** and mesh face hit, and the side of the primitive), per sample and in
+** the order the samples are drawn. A reload that changed only lights or
+** materials asks for a frame that only reshades (schedule_reshade):
+** pixels whose samples are in the G-buffer are shaded from them, with
+** the normals and materials looked up again, instead of being traced.
+**
+** Every other frame retraces: it starts a new epoch, and a pixel's
+** samples count only once stamped with the current one. A frame cut short
+** leaves the pixels it did not reach unstamped, to be traced next time.
+** The buffer belongs to the thread drawing, like the heatmap buffers.
+**
+** Alongside each sample's hit, its shadow from each light is kept as two
+** bits (VIS_*): lit and blocked are exact, so a reshade skips the shadow
+** rays of every light it knows; partial shadows, cast by transparent
+** objects only, are traced every time. The hit a shadow starts from stays
+** put, so only a light that moves, or a change of transparency, makes
+** shadows stale: the reload forgets that light's (gbuf_forget_light), or
+** all of them (gbuf_forget_shadows). A colour or intensity edit forgets
+** none.
+*/
+
+#include "rt.h"
+
+/*
+** gbuf_layout -- Make room in vis for the shadows of e->lights lights, all
+** unknown, if it was laid out for a different count.
+*/
+static void		gbuf_layout(t_env *e, t_gbuf *g)
+{
+	size_t	words;
+
+	words = MAX((e->lights + VIS_PER_WORD - 1) / VIS_PER_WORD, 1);
+	if (g->vis && g->words == words)
+		return ;
+	free(g->vis);
+	g->words = words;
+	if (!(g->vis = (uint32_t *)calloc(e->x * e->y * g->super * words,
+		sizeof(uint32_t))))
+		err(MALLOC_ERROR, "gbuf_begin", e);
+}
+
+/*
+** gbuf_begin -- (Re)allocate the G-buffer for a frame of e->super samples
+** per pixel and e->lights lights, and start a new epoch unless the frame
+** only reshades.
+*/
+void			gbuf_begin(t_env *e)
+{
+	t_gbuf	*g;
+	size_t	samples;
+
+	samples = e->super > 1 ? e->super : 1;
+	if (e->gbuf && e->gbuf->super != samples)
+		free_gbuf(e);
+	if (!e->gbuf)
+	{
+		if (!(g = (t_gbuf *)calloc(1, sizeof(t_gbuf))))
+			err(MALLOC_ERROR, "gbuf_begin", e);
+		e->gbuf = g;
+		g->super = samples;
+		if (!(g->sample = (t_gsample *)malloc(e->x * e->y * samples *
+			sizeof(t_gsample))) ||
+			!(g->stamp = (uint32_t *)calloc(e->x * e->y, sizeof(uint32_t))))
+			err(MALLOC_ERROR, "gbuf_begin", e);
+		e->reshade = 0;
+	}
+	gbuf_layout(e, e->gbuf);
+	if (e->reshade)
+		return ;
+	if (++e->gbuf->epoch == 0)
+	{
+		memset(e->gbuf->stamp, 0, e->x * e->y * sizeof(uint32_t));
+		e->gbuf->epoch = 1;
+	}
+}
+
+/*
+** gbuf_store -- Keep the hit intersect_scene just found in g. None of its
+** shadows are known yet; e->vis is where they will be kept.
+*/
+void			gbuf_store(t_env *e, t_gsample *g)
+{
+	size_t	words;
+
+	words = e->gbuf->words;
+	e->vis = &e->gbuf->vis[(g - e->gbuf->sample) * words];
+	memset(e->vis, 0, words * sizeof(uint32_t));
+	g->t = e->t;
+	g->p_hit = e->p_hit;
+	g->object_hit = e->object_hit;
+	g->face = e->o_hit;
+	g->hit_type = e->hit_type;
+	g->inter = e->ray.inter;
+}
+
+/*
+** gbuf_load -- Put the hit kept in g back in e, as intersect_scene would
+** have left it for the same ray, with the shadows known from it.
+*/
+void			gbuf_load(t_env *e, t_gsample *g)
+{
+	e->vis = &e->gbuf->vis[(g - e->gbuf->sample) * e->gbuf->words];
+	e->t = g->t;
+	e->p_hit = g->p_hit;
+	e->o_hit = g->face;
+	e->hit_type = g->hit_type;
+	e->ray.inter = g->inter;
+	if (g->hit_type == FACE)
+	{
+		e->object_hit = g->object_hit;
+		e->o_normal = face_normal(g->object_hit, g->face);
+	}
+}
+
+/*
+** gbuf_forget_light -- Forget every sample's shadow from light, which has
+** moved. Called between frames, with the render thread paused.
+*/
+void			gbuf_forget_light(t_env *e, size_t light)
+{
+	t_gbuf		*g;
+	uint32_t	*w;
+	uint32_t	keep;
+	size_t		n;
+
+	if (!(g = e->gbuf) || light >= g->words * VIS_PER_WORD)
+		return ;
+	keep = ~(3u << (light % VIS_PER_WORD * 2));
+	w = &g->vis[light / VIS_PER_WORD];
+	n = e->x * e->y * g->super;
+	while (n--)
+	{
+		*w &= keep;
+		w += g->words;
+	}
+}
+
+/*
+** gbuf_forget_shadows -- Forget every shadow kept, e.g. when lights were
+** added or removed, or something's transparency changed.
+*/
+void			gbuf_forget_shadows(t_env *e)
+{
+	if (!e->gbuf)
+		return ;
+	memset(e->gbuf->vis, 0, e->x * e->y * e->gbuf->super * e->gbuf->words *
+		sizeof(uint32_t));
+}
+
+void			free_gbuf(t_env *e)
+{
+	if (!e->gbuf)
+		return ;
+	free(e->gbuf->vis);
+	free(e->gbuf->sample);
+	free(e->gbuf->stamp);
+	free(e->gbuf);
+	e->gbuf = NULL;
+}
@@ -72,8 +72,9 @@ static t_vector	get_con_normal(t_env *e, t_vector ray)
 ** Returns: unit normal vector pointing outward from the surface.
 **
 ** Special cases:
-**   - For mesh faces (FACE), the precomputed face normal is returned,
-**     flipped if the ray approaches from behind.
+**   - For mesh faces (FACE), the precomputed face normal is returned
+**     (in scene space, see e->o_normal), flipped if the ray approaches
+**     from behind.
 **   - For planes/disks, the stored normal is returned, flipped if
 **     the ray hits the back face (dot(normal, ray_dir) > 0).
 **   - If ray.inter == 2, the ray originated inside the object, so
@@ -87,9 +88,9 @@ t_vector		get_normal(t_env *e, t_vector ray)
 	normal = (t_vector){0.0, 0.0, 1.0};
 	if (e->hit_type == FACE)
 		/* Mesh face: use precomputed face normal, flip to face the ray */
-		return ((vdot(*(e->o_hit->n), e->ray.dir) < 0.0) ?
-			vunit(*e->o_hit->n) :
-			vunit(vneg(*e->o_hit->n)));
+		return ((vdot(e->o_normal, e->ray.dir) < 0.0) ?
+			vunit(e->o_normal) :
+			vunit(vneg(e->o_normal)));
 	else if (e->p_hit->type == PRIM_SPHERE ||
 		e->p_hit->type == PRIM_HEMI_SPHERE)
 		/* Sphere: normal = normalize(hit_point - center) / radius */
@@ -12,26 +12,32 @@
 ** one byte, shifting right by 1 independently halves each channel without
 ** any cross-channel interference.
 **
-** Performance note: this processes every byte in the surface (h * pitch),
-** where pitch is the number of bytes per row (may include padding). The
-** loop runs backward from the last byte to the first.
+** Performance note: this processes every byte of the pixels dimmed (a
+** region being redrawn leaves the rest of the image alone). The loops run
+** backward from the last byte to the first.
 */
 
 #include "rt.h"
 
 /*
-** half_bytes — Dim all pixels in the SDL surface to 50% brightness.
-** Operates on the raw byte array: each byte >>= 1 divides that channel by 2.
+** half_bytes — Dim the pixels of rectangle d of the SDL surface to 50%
+** brightness, row by row. Operates on the raw bytes: each byte >>= 1
+** divides that channel by 2.
 */
 
-void		half_bytes(SDL_Surface *s)
+void		half_bytes(SDL_Surface *s, SDL_Rect d)
 {
 	size_t			index;
 	unsigned char	*px;
+	int				row;
 
-	/* Total bytes in the pixel buffer: rows * bytes-per-row */
-	index = s->h * s->pitch;
-	px = (unsigned char *)(s->pixels + index - 1);
-	while (index--)
-		*px-- >>= 1;
+	row = d.y + d.h;
+	while (row-- > d.y)
+	{
+		/* Bytes of the row inside d: 4 per 32-bit pixel */
+		index = d.w * 4;
+		px = (unsigned char *)s->pixels + row * s->pitch + (d.x + d.w) * 4 - 1;
+		while (index--)
+			*px-- >>= 1;
+	}
 }
@@ -0,0 +1,183 @@
+/*
+** heatmap.c -- Per-tile and per-pixel render cost output (--heatmap).
+**
+** With --heatmap PREFIX every full frame records, for each pixel, how many
+** rays it traced and how many intersection tests it cost, and for each
+** tile the wall time its thread spent on it. After the frame three files
+** are (over)written:
+**
+**   PREFIX.ppm         false-colour image of intersection tests per pixel,
+**                      log-scaled: black/blue = cheap, red/white = expensive
+**   PREFIX.csv         one row per tile: bounds, ms, rays, tests
+**   PREFIX_pixels.csv  one row per pixel: x, y, rays, tests
+**
+** Counts come from the differences of g_tls_stats taken around each pixel
+** in render_chunk, so the instrumented loop costs two loads and two stores
+** per pixel; without --heatmap e->heat is NULL and nothing is recorded.
+** Grab-mode previews are not recorded.
+*/
+
+#include "rt.h"
+#include <math.h>
+
+/*
+** heatmap_begin -- (Re)allocate and clear the cost buffers for a frame.
+*/
+void			heatmap_begin(t_env *e)
+{
+	t_heatmap	*h;
+
+	if (!e->heat)
+	{
+		if (!(h = (t_heatmap *)calloc(1, sizeof(t_heatmap))))
+			err(MALLOC_ERROR, "heatmap_begin", e);
+		h->tiles = ((e->x + CHUNK_SIZE - 1) / CHUNK_SIZE) *
+			((e->y + CHUNK_SIZE - 1) / CHUNK_SIZE);
+		e->heat = h;
+		if (!(h->rays = (uint32_t *)malloc(e->x * e->y * sizeof(uint32_t))) ||
+			!(h->tests = (uint32_t *)malloc(e->x * e->y * sizeof(uint32_t))) ||
+			!(h->tile = (t_heat_tile *)malloc(h->tiles * sizeof(t_heat_tile))))
+			err(MALLOC_ERROR, "heatmap_begin", e);
+	}
+	memset(e->heat->rays, 0, e->x * e->y * sizeof(uint32_t));
+	memset(e->heat->tests, 0, e->x * e->y * sizeof(uint32_t));
+	memset(e->heat->tile, 0, e->heat->tiles * sizeof(t_heat_tile));
+}
+
+/*
+** false_colour -- Map t in [0, 1] onto a black-blue-cyan-yellow-red-white
+** ramp, linearly interpolated between the six stops. Returns 0xRRGGBB.
+*/
+static uint32_t	false_colour(double t)
+{
+	static const uint32_t	stop[6] = {0x000000, 0x0000FF, 0x00FFFF,
+		0xFFFF00, 0xFF0000, 0xFFFFFF};
+	uint32_t				a;
+	uint32_t				b;
+	double					f;
+	int						i;
+
+	t = fmin(fmax(t, 0.0), 1.0) * 5.0;
+	i = MIN((int)t, 4);
+	f = t - i;
+	a = stop[i];
+	b = stop[i + 1];
+	return (((uint32_t)(((a >> 16) & 0xFF) * (1 - f) + ((b >> 16) & 0xFF) * f)
+		<< 16) |
+		((uint32_t)(((a >> 8) & 0xFF) * (1 - f) + ((b >> 8) & 0xFF) * f) << 8) |
+		(uint32_t)((a & 0xFF) * (1 - f) + (b & 0xFF) * f));
+}
+
+/*
+** open_out -- fopen PREFIX + suffix for writing, or exit with an error.
+*/
+static FILE		*open_out(t_env *e, char *suffix)
+{
+	FILE	*f;
+	char	*path;
+
+	path = NULL;
+	asprintf(&path, "%s%s", e->opt.heatmap, suffix);
+	if (!path || !(f = fopen(path, "w")))
+		err(FILE_OPEN_ERROR, path ? path : "heatmap", e);
+	free(path);
+	return (f);
+}
+
+/*
+** write_image -- PREFIX.ppm: intersection tests per pixel, normalised
+** against the most expensive pixel on a log scale so both the cheap
+** background and the hot spots stay distinguishable.
+*/
+static void		write_image(t_env *e)
+{
+	FILE		*f;
+	uint32_t	max;
+	uint32_t	col;
+	double		scale;
+	size_t		i;
+
+	max = 0;
+	i = e->x * e->y;
+	while (i--)
+		max = MAX(max, e->heat->tests[i]);
+	scale = 1.0 / log1p((double)MAX(max, 1));
+	f = open_out(e, ".ppm");
+	fprintf(f, "P6\n%zu %zu\n255\n", e->x, e->y);
+	i = 0;
+	while (i < e->x * e->y)
+	{
+		col = false_colour(log1p((double)e->heat->tests[i++]) * scale);
+		fputc((col >> 16) & 0xFF, f);
+		fputc((col >> 8) & 0xFF, f);
+		fputc(col & 0xFF, f);
+	}
+	fclose(f);
+}
+
+/*
+** write_csv -- PREFIX.csv (per tile) and PREFIX_pixels.csv (per pixel).
+** Tiles outside the region drawn (--crop) are left out.
+*/
+static void		write_csv(t_env *e)
+{
+	FILE		*f;
+	t_heat_tile	*t;
+	size_t		i;
+
+	f = open_out(e, ".csv");
+	fputs("tile,x,y,w,h,ms,rays,tests\n", f);
+	i = -1;
+	while (++i < e->heat->tiles)
+	{
+		t = &e->heat->tile[i];
+		if (!t->d.w)
+			continue ;
+		fprintf(f, "%zu,%d,%d,%d,%d,%.3f,%zu,%zu\n", i, t->d.x, t->d.y,
+			t->d.w, t->d.h, t->ms, t->rays, t->tests);
+	}
+	fclose(f);
+	f = open_out(e, "_pixels.csv");
+	fputs("x,y,rays,tests\n", f);
+	i = -1;
+	while (++i < e->x * e->y)
+		fprintf(f, "%zu,%zu,%u,%u\n", i % e->x, i / e->x,
+			e->heat->rays[i], e->heat->tests[i]);
+	fclose(f);
+}
+
+/*
+** heatmap_write -- Emit all heatmap files for the frame just rendered and
+** name the most expensive tile, which is usually the first thing to look
+** at when tuning a scene.
+*/
+void			heatmap_write(t_env *e)
+{
+	size_t	worst;
+	size_t	i;
+
+	write_image(e);
+	write_csv(e);
+	worst = 0;
+	i = 0;
+	while (++i < e->heat->tiles)
+		if (e->heat->tile[i].ms > e->heat->tile[worst].ms)
+			worst = i;
+	printf("Heatmap written to %s.ppm, %s.csv and %s_pixels.csv\n",
+		e->opt.heatmap, e->opt.heatmap, e->opt.heatmap);
+	printf("Slowest tile: #%zu at (%d, %d), %.3f ms\n", worst,
+		e->heat->tile[worst].d.x, e->heat->tile[worst].d.y,
+		e->heat->tile[worst].ms);
+}
+
+/* Release the heatmap buffers, if any. */
+void			free_heatmap(t_env *e)
+{
+	if (!e->heat)
+		return ;
+	free(e->heat->rays);
+	free(e->heat->tests);
+	free(e->heat->tile);
+	free(e->heat);
+	e->heat = NULL;
+}
@@ -7,11 +7,13 @@
 ** default), camera at (0, -10, 0) looking at the origin with Z-up.
 **
 ** Phase 2 (init_env): Parses the scene file, then creates the SDL window
-** and two rendering surfaces:
+** (skipped in headless mode, e.g. for distributed workers) and two
+** rendering surfaces:
 **   - img: the main render target (pixels written by worker threads)
 **   - dof: accumulation buffer for depth-of-field multi-sampling
 ** Both surfaces use 32-bit pixels; their pixel data is cast to uint32_t*
 ** for direct 0xAARRGGBB access without SDL pixel-format conversion.
+** With --watch, the scene file is then watched for changes (src/reload).
 */
 
 #include "rt.h"
@@ -58,6 +60,8 @@ static void		initials(t_env *e)
 	e->hit_type = 0;
 	e->prims = 0;
 	e->objects = 0;
+	e->meshes = 0;
+	e->o_hit = 0;
 	e->lights = 0;
 	e->materials = 0;
 	e->t = INFINITY;
@@ -66,21 +70,40 @@ static void		initials(t_env *e)
 	e->y = 900;
 	e->flags = 0;
 	e->super = 0;
+	e->cancelled = 0;
 }
 
 /* NULL all pointers so cleanup functions can safely check before freeing. */
 static void		nulls(t_env *e)
 {
 	e->win = NULL;
+	e->win_img = NULL;
 	e->img = NULL;
+	e->dof = NULL;
 	e->px = NULL;
+	e->heat = NULL;
+	e->gbuf = NULL;
+	e->reshade = 0;
+	e->vis = NULL;
+	e->denoise = NULL;
 	e->p_hit = NULL;
 	e->prim = NULL;
-	e->o_hit = NULL;
+	e->batch = NULL;
 	e->object_hit = NULL;
 	e->object = NULL;
+	e->mesh = NULL;
 	e->light = NULL;
 	e->material = NULL;
+	e->mat_index = (t_mat_index){NULL, 0, 0};
+	memset(&e->parse, 0, sizeof(t_parse_times));
+	memset(&e->scene, 0, sizeof(t_scene));
+	e->watch = (t_watch){-1, NULL, NULL};
+	e->spare = NULL;
+	e->spares = 0;
+	e->on_error = NULL;
+	e->render = NULL;
+	memset(&e->sched, 0, sizeof(t_sched));
+	e->region = (SDL_Rect){0, 0, 0, 0};
 	e->p_hit = NULL;
 }
 
@@ -96,14 +119,25 @@ void			nullify_pointers(t_env *e)
 ** Phase 2: full initialization.
 ** After parsing the scene file, create the SDL window and two 32-bit
 ** surfaces. memset clears pixel buffers to black (0x00000000).
+** Headless processes only get the offscreen surfaces (no window).
+** A window gets a render thread, so that frames are drawn off the event
+** loop (src/render_thread.c).
 */
 void			init_env(t_env *e)
 {
 	nullify_pointers(e);
 	read_scene(e->file_name, e);
-	e->win = SDL_CreateWindow(e->file_name, SDL_WINDOWPOS_CENTERED,
-		SDL_WINDOWPOS_CENTERED, e->x, e->y, SDL_WINDOW_SHOWN);
-	e->win_img = SDL_GetWindowSurface(e->win);
+	apply_options(e);
+	build_prim_batches(e);
+	start_bvh_builds(e);
+	if (e->opt.headless)
+		wait_bvh_builds(e);
+	if (!e->opt.headless)
+	{
+		e->win = SDL_CreateWindow(e->file_name, SDL_WINDOWPOS_CENTERED,
+			SDL_WINDOWPOS_CENTERED, e->x, e->y, SDL_WINDOW_SHOWN);
+		e->win_img = SDL_GetWindowSurface(e->win);
+	}
 	e->img = SDL_CreateRGBSurface(0, e->x, e->y, 32, 0, 0, 0, 0);
 	e->dof = SDL_CreateRGBSurface(0, e->x, e->y, 32, 0, 0, 0, 0);
 	/* Cast pixel data to uint32_t* for direct 32-bit ARGB access. */
@@ -111,5 +145,10 @@ void			init_env(t_env *e)
 	e->dx = (uint32_t *)e->dof->pixels;
 	memset(e->px, 0, (e->x * 4) * e->y);
 	memset(e->dx, 0, (e->x * 4) * e->y);
-	SDL_UpdateWindowSurface(e->win);
+	if (e->win)
+		SDL_UpdateWindowSurface(e->win);
+	if (e->opt.watch && !e->opt.headless)
+		watch_scene(e);
+	if (e->win)
+		render_start(e);
 }
@@ -0,0 +1,135 @@
+/*
+** instance.c -- Placement of mesh instances (OBJECT blocks).
+**
+** A mesh is stored once, in its own object space. Each OBJECT places it
+** in the scene with a scale S, a rotation R (about X, then Y, then Z) and
+** a translation loc:
+**
+**   p_scene = loc + R * S * p_object
+**
+** Rather than transforming every vertex of every copy, a ray is taken
+** into object space (origin by the inverse transform, direction by its
+** linear part only) and intersected with the shared faces and BVH. The
+** direction is not renormalised, so the ray parameter t means the same
+** point in both spaces and hit distances compare directly with the rest
+** of the scene. Normals come back with the inverse transpose, which for
+** R * S is R * S^-1.
+**
+** An instance with no placement is flagged as identity and its rays are
+** used untransformed, exactly as before instancing existed.
+*/
+
+#include "rt.h"
+
+/* v multiplied by the 3x3 matrix m. */
+static t_vector	xform(double m[3][3], t_vector v)
+{
+	return ((t_vector){
+		m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+		m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+		m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z});
+}
+
+/*
+** rotation -- r = Rz * Ry * Rx for the angles in rot (degrees), the
+** rotation that turns about X first.
+*/
+static void		rotation(t_vector rot, double r[3][3])
+{
+	t_vector	c;
+	t_vector	s;
+
+	rot = vmult(rot, M_PI / 180.0);
+	c = (t_vector){cos(rot.x), cos(rot.y), cos(rot.z)};
+	s = (t_vector){sin(rot.x), sin(rot.y), sin(rot.z)};
+	r[0][0] = c.z * c.y;
+	r[0][1] = c.z * s.y * s.x - s.z * c.x;
+	r[0][2] = c.z * s.y * c.x + s.z * s.x;
+	r[1][0] = s.z * c.y;
+	r[1][1] = s.z * s.y * s.x + c.z * c.x;
+	r[1][2] = s.z * s.y * c.x - c.z * s.x;
+	r[2][0] = -s.y;
+	r[2][1] = c.y * s.x;
+	r[2][2] = c.y * c.x;
+}
+
+/*
+** world_box -- Scene-space bounds of the placed mesh: the box around its
+** object-space box's eight transformed corners.
+*/
+static void		world_box(t_object *o)
+{
+	t_vector	*b;
+	t_vector	p;
+	int			i;
+
+	b = o->mesh->box;
+	i = -1;
+	while (++i < 8)
+	{
+		p = vadd(o->loc, xform(o->m, (t_vector){b[i & 1].x,
+			b[(i >> 1) & 1].y, b[(i >> 2) & 1].z}));
+		o->box[0] = (i) ? (t_vector){MIN(o->box[0].x, p.x),
+			MIN(o->box[0].y, p.y), MIN(o->box[0].z, p.z)} : p;
+		o->box[1] = (i) ? (t_vector){MAX(o->box[1].x, p.x),
+			MAX(o->box[1].y, p.y), MAX(o->box[1].z, p.z)} : p;
+	}
+}
+
+/*
+** setup_instance -- Derive o's matrices and scene-space bounds from its
+** LOC, ROT and SCALE: m = R * S and inv = S^-1 * R^T.
+*/
+void			setup_instance(t_object *o)
+{
+	double	r[3][3];
+	int		i;
+	int		j;
+
+	rotation(o->rot, r);
+	i = -1;
+	while (++i < 3)
+	{
+		j = -1;
+		while (++j < 3)
+		{
+			o->m[i][j] = r[i][j] * ((j == 0) ? o->scale.x :
+				(j == 1) ? o->scale.y : o->scale.z);
+			o->inv[i][j] = r[j][i] / ((i == 0) ? o->scale.x :
+				(i == 1) ? o->scale.y : o->scale.z);
+		}
+	}
+	o->identity = (vcomp(o->loc, (t_vector){0.0, 0.0, 0.0}) == 0 &&
+		vcomp(o->rot, (t_vector){0.0, 0.0, 0.0}) == 0 &&
+		vcomp(o->scale, (t_vector){1.0, 1.0, 1.0}) == 0);
+	if (o->identity)
+	{
+		o->box[0] = o->mesh->box[0];
+		o->box[1] = o->mesh->box[1];
+	}
+	else
+		world_box(o);
+}
+
+/*
+** instance_ray -- in taken into o's object space. Everything else about
+** the ray (depth, flags, inter) is copied unchanged.
+*/
+void			instance_ray(t_object *o, t_ray *in, t_ray *out)
+{
+	*out = *in;
+	out->loc = xform(o->inv, vsub(in->loc, o->loc));
+	out->dir = xform(o->inv, in->dir);
+}
+
+/*
+** instance_normal -- Object-space normal n of o, in scene space and unit
+** length: inv^T * n.
+*/
+t_vector		instance_normal(t_object *o, t_vector n)
+{
+	return (vunit((t_vector){
+		o->inv[0][0] * n.x + o->inv[1][0] * n.y + o->inv[2][0] * n.z,
+		o->inv[0][1] * n.x + o->inv[1][1] * n.y + o->inv[2][1] * n.z,
+		o->inv[0][2] * n.x + o->inv[1][2] * n.y + o->inv[2][2] * n.z}));
+}
@@ -0,0 +1,393 @@
+/*
+** intersect_batch.c -- Intersect a ray with every primitive, one type-sorted
+** batch at a time.
+**
+** Each primitive type has its own loop over its batch (see prim_batch.c),
+** so the type is known outside the loop and every field is read from a
+** contiguous array instead of through a t_prim pointer. Spheres and planes,
+** the commonest types, go BATCH_BLOCK primitives at a time: a branch-free
+** pass computes the discriminant (or denominator and distance) of the whole
+** block, which the compiler vectorises, and a second pass finishes only
+** the primitives that can still be hit.
+**
+** The arithmetic is that of intersect_sphere.c, intersect_plane.c, etc.,
+** operation for operation, so hits and distances are bit-identical to
+** calling those routines on the t_prim. They remain the readable,
+** per-primitive form of each test (and are what bench/ measures).
+**
+** Each loop runs over a run [from, to) of its batch. A batch with a BVH
+** (see prim_bvh.c) is walked first, running the loop over each leaf the
+** ray reaches before its nearest hit so far (or the light), then over the
+** unbounded elements after the bounded ones. A batch without one is a
+** single run.
+**
+** The loops serve both queries through found(): the nearest hit for
+** intersect_scene and the transmittance for in_shadow. Counters: every
+** primitive evaluated is an intersection test of its type, every hit
+** (nearest or not) a hit of its type, and every BVH node visited a node
+** visit.
+*/
+
+#include "intersect_batch.h"
+
+/*
+** found -- Record that primitive id is hit at t with code inter (1 front,
+** 2 inside). Nearest-hit: keep it if it is closer; on an exact tie the
+** higher index wins, as when e->prim was scanned from the end. Shadow:
+** attenuate by the primitive's transparency. Returns 1 when a shadow ray
+** is fully blocked and the pass can stop.
+*/
+static int		found(t_batch_ray *q, int type, size_t id, double t, int inter)
+{
+	++g_tls_stats.prim_hits[type];
+	if (q->shadow)
+	{
+		if (t < q->distance)
+			q->transmit *= q->e->material[q->e->prim[id]->material]->refract;
+		return (q->transmit < EPSILON);
+	}
+	if (!q->hit || t < q->t || (t == q->t && id > q->id))
+	{
+		q->hit = 1;
+		q->t = t;
+		q->id = id;
+		q->inter = inter;
+	}
+	return (0);
+}
+
+/* Count n tests of one type. */
+static void		tested(int type, size_t n)
+{
+	g_tls_stats.intersection_tests += n;
+	g_tls_stats.prim_tests[type] += n;
+}
+
+/*
+** roots -- The two roots of a*t^2 + b*t + c given the discriminant: the
+** nearer in tc[0], the other in tc[1], as find_t computes them.
+*/
+static void		roots(double a, double b, double discr, double tc[2])
+{
+	double	sqrt_discr;
+	double	t0;
+	double	t1;
+
+	sqrt_discr = sqrt(discr);
+	t0 = (-b + sqrt_discr) / (2.0 * a);
+	t1 = (-b - sqrt_discr) / (2.0 * a);
+	tc[0] = (t0 > t1) ? t1 : t0;
+	tc[1] = (tc[0] == t1) ? t0 : t1;
+}
+
+/* Spheres, a block at a time. */
+static int		batch_sphere(t_batch_ray *q, t_prim_batch *b)
+{
+	double		bq[BATCH_BLOCK];
+	double		discr[BATCH_BLOCK];
+	double		tc[2];
+	t_vector	d;
+	size_t		i;
+	size_t		k;
+	size_t		n;
+	double		a;
+
+	a = vdot(q->r->dir, q->r->dir);
+	i = q->from;
+	while (i < q->to)
+	{
+		n = MIN(BATCH_BLOCK, q->to - i);
+		tested(PRIM_SPHERE, n);
+		k = -1;
+		while (++k < n)
+		{
+			d = (t_vector){q->r->loc.x - b->x[i + k], q->r->loc.y - b->y[i + k],
+				q->r->loc.z - b->z[i + k]};
+			bq[k] = 2.0 * vdot(q->r->dir, d);
+			discr[k] = bq[k] * bq[k] - 4.0 * a * (vdot(d, d) - b->r2[i + k]);
+		}
+		k = -1;
+		while (++k < n)
+		{
+			if (discr[k] < EPSILON)
+				continue ;
+			roots(a, bq[k], discr[k], tc);
+			if ((tc[0] > EPSILON && found(q, PRIM_SPHERE, b->id[i + k], tc[0],
+				1)) || (!(tc[0] > EPSILON) && tc[1] > EPSILON &&
+				found(q, PRIM_SPHERE, b->id[i + k], tc[1], 2)))
+				return (1);
+		}
+		i += n;
+	}
+	return (0);
+}
+
+/* Planes, a block at a time. */
+static int		batch_plane(t_batch_ray *q, t_prim_batch *b)
+{
+	double		den[BATCH_BLOCK];
+	double		t0[BATCH_BLOCK];
+	t_vector	n;
+	size_t		i;
+	size_t		k;
+	size_t		m;
+
+	i = q->from;
+	while (i < q->to)
+	{
+		m = MIN(BATCH_BLOCK, q->to - i);
+		tested(PRIM_PLANE, m);
+		k = -1;
+		while (++k < m)
+		{
+			n = (t_vector){b->ax[i + k], b->ay[i + k], b->az[i + k]};
+			den[k] = vdot(q->r->dir, n);
+			t0[k] = (b->d[i + k] - vdot(q->r->loc, n)) / den[k];
+		}
+		k = -1;
+		while (++k < m)
+			if (den[k] != 0 && t0[k] > EPSILON &&
+				found(q, PRIM_PLANE, b->id[i + k], t0[k], 1))
+				return (1);
+		i += m;
+	}
+	return (0);
+}
+
+/* Disks: the plane test, then the distance from the centre. */
+static int		batch_disk(t_batch_ray *q, t_prim_batch *b)
+{
+	t_vector	n;
+	t_vector	c;
+	double		den;
+	double		t0;
+	size_t		i;
+
+	tested(PRIM_DISK, q->to - q->from);
+	i = q->from - 1;
+	while (++i < q->to)
+	{
+		n = (t_vector){b->ax[i], b->ay[i], b->az[i]};
+		if ((den = vdot(q->r->dir, n)) == 0)
+			continue ;
+		t0 = (b->d[i] - vdot(q->r->loc, n)) / den;
+		c = (t_vector){b->x[i], b->y[i], b->z[i]};
+		if (t0 > EPSILON && vnormalize(vsub(vadd(q->r->loc,
+			vmult(q->r->dir, t0)), c)) <= b->radius[i] &&
+			found(q, PRIM_DISK, b->id[i], t0, 1))
+			return (1);
+	}
+	return (0);
+}
+
+/*
+** keep -- Whether the hit at t on element i passes its type's clipping:
+** the hemisphere keeps the half opposite to its axis; cylinders and cones
+** with a limit keep hits between the two cap planes.
+*/
+static int		keep(t_batch_ray *q, t_prim_batch *b, size_t i, double t)
+{
+	t_vector	ph;
+	t_vector	a;
+	t_vector	c;
+
+	ph = vadd(q->r->loc, vmult(q->r->dir, t));
+	a = (t_vector){b->ax[i], b->ay[i], b->az[i]};
+	c = (t_vector){b->x[i], b->y[i], b->z[i]};
+	if (!b->limit)
+		return (vdot(a, vsub(ph, c)) <= 0);
+	if (b->limit[i] == -1)
+		return (1);
+	return (vdot(a, vsub(ph, vadd(c, vmult(a, b->limit[i])))) <= 0 &&
+		vdot(a, vsub(ph, vadd(c, vmult(a, -b->limit[i])))) >= 0);
+}
+
+/*
+** quadric -- Quadratic coefficients {a, b, discr} of the hemisphere,
+** cylinder or cone in element i, as the per-primitive routines set them up.
+*/
+static void		quadric(t_batch_ray *q, t_prim_batch *b, size_t i, double k[3])
+{
+	t_vector	a;
+	t_vector	dist;
+	t_vector	a_v;
+	t_vector	c_v;
+	double		c;
+
+	a = (t_vector){b->ax[i], b->ay[i], b->az[i]};
+	dist = vsub(q->r->loc, (t_vector){b->x[i], b->y[i], b->z[i]});
+	if (!b->limit)
+	{
+		k[0] = vdot(q->r->dir, q->r->dir);
+		k[1] = 2.0 * vdot(q->r->dir, dist);
+		c = vdot(dist, dist) - b->r2[i];
+		k[2] = k[1] * k[1] - 4.0 * k[0] * c;
+		return ;
+	}
+	a_v = vsub(q->r->dir, vmult(a, vdot(q->r->dir, a)));
+	c_v = vsub(dist, vmult(a, vdot(dist, a)));
+	if (b->r2)
+	{
+		k[0] = vdot(a_v, a_v);
+		k[1] = 2.0 * vdot(a_v, c_v);
+		c = vdot(c_v, c_v) - b->r2[i];
+	}
+	else
+	{
+		k[0] = b->cos2[i] * vdot(a_v, a_v) - b->sin2[i] * vdot(q->r->dir, a) *
+			vdot(q->r->dir, a);
+		k[1] = 2.0 * b->cos2[i] * vdot(a_v, c_v) - 2.0 * b->sin2[i] *
+			vdot(q->r->dir, a) * vdot(dist, a);
+		c = b->cos2[i] * vdot(c_v, c_v) - b->sin2[i] * vdot(dist, a) *
+			vdot(dist, a);
+	}
+	k[2] = k[1] * k[1] - 4.0 * k[0] * c;
+}
+
+/*
+** batch_clipped -- Hemispheres, cylinders and cones: solve the quadric,
+** then take the nearer root that survives clipping (code 1), else the
+** farther (code 2).
+*/
+static int		batch_clipped(t_batch_ray *q, t_prim_batch *b, int type)
+{
+	double		k[3];
+	double		tc[2];
+	size_t		i;
+
+	tested(type, q->to - q->from);
+	i = q->from - 1;
+	while (++i < q->to)
+	{
+		quadric(q, b, i, k);
+		if (k[2] < EPSILON)
+			continue ;
+		roots(k[0], k[1], k[2], tc);
+		if (tc[0] > EPSILON && keep(q, b, i, tc[0]))
+		{
+			if (found(q, type, b->id[i], tc[0], 1))
+				return (1);
+		}
+		else if (tc[1] > EPSILON && keep(q, b, i, tc[1]) &&
+			found(q, type, b->id[i], tc[1], 2))
+			return (1);
+	}
+	return (0);
+}
+
+/* Run the loop for type over the run [from, to) of b. */
+static int		run_range(t_batch_ray *q, t_prim_batch *b, int type)
+{
+	if (q->from >= q->to)
+		return (0);
+	if (type == PRIM_SPHERE)
+		return (batch_sphere(q, b));
+	if (type == PRIM_PLANE)
+		return (batch_plane(q, b));
+	if (type == PRIM_DISK)
+		return (batch_disk(q, b));
+	return (batch_clipped(q, b, type));
+}
+
+/*
+** run_tree -- Walk b's BVH, running the loop over each leaf the ray enters
+** before the nearest hit so far, or before the light for a shadow ray.
+*/
+static int		run_tree(t_batch_ray *q, t_prim_batch *b, int type)
+{
+	size_t		stack[BVH_STACK];
+	t_bvh_node	*n;
+	size_t		sp;
+	size_t		k;
+
+	sp = 0;
+	stack[sp++] = 0;
+	while (sp)
+	{
+		k = stack[--sp];
+		n = &b->bvh.node[k];
+		++g_tls_stats.node_visits;
+		if (!bvh_enter(n, q->r->loc, q->inv, (q->shadow) ? q->distance :
+			(q->hit) ? q->t : INFINITY))
+			continue ;
+		if (!n->count)
+		{
+			stack[sp++] = n->index;
+			stack[sp++] = k + 1;
+			continue ;
+		}
+		q->from = n->index;
+		q->to = (size_t)n->index + n->count;
+		if (run_range(q, b, type))
+			return (1);
+	}
+	return (0);
+}
+
+/* Run b: its BVH if it has one, then the rest of it. */
+static int		run_batch(t_batch_ray *q, t_prim_batch *b, int type)
+{
+	q->from = 0;
+	if (b->bvh.nodes)
+	{
+		if (run_tree(q, b, type))
+			return (1);
+		q->from = b->bounded;
+	}
+	q->to = b->n;
+	return (run_range(q, b, type));
+}
+
+/* Run every non-empty batch; stop early when found() says so. */
+static void		run_batches(t_batch_ray *q)
+{
+	static const int	order[] = {PRIM_SPHERE, PRIM_PLANE, PRIM_DISK,
+		PRIM_HEMI_SPHERE, PRIM_CYLINDER, PRIM_CONE};
+	size_t				i;
+
+	q->inv = (t_vector){1.0 / q->r->dir.x, 1.0 / q->r->dir.y,
+		1.0 / q->r->dir.z};
+	i = -1;
+	while (++i < sizeof(order) / sizeof(order[0]))
+		if (q->e->batch[order[i]].n &&
+			run_batch(q, &q->e->batch[order[i]], order[i]))
+			return ;
+}
+
+/*
+** intersect_batches -- Nearest primitive hit by r. Returns it (NULL for
+** none) and sets *t to its distance and *inter to 1 (front) or 2 (inside).
+*/
+t_prim			*intersect_batches(t_env *e, t_ray *r, double *t, int *inter)
+{
+	t_batch_ray	q;
+
+	memset(&q, 0, sizeof(t_batch_ray));
+	q.e = e;
+	q.r = r;
+	run_batches(&q);
+	if (!q.hit)
+		return (NULL);
+	*t = q.t;
+	*inter = q.inter;
+	return (e->prim[q.id]);
+}
+
+/*
+** shadow_batches -- Transmittance of the primitives between r's origin
+** and distance: the product of the refract coefficients of everything hit
+** in front of the light. Stops as soon as it drops below EPSILON.
+*/
+double			shadow_batches(t_env *e, t_ray *r, double distance)
+{
+	t_batch_ray	q;
+
+	memset(&q, 0, sizeof(t_batch_ray));
+	q.e = e;
+	q.r = r;
+	q.shadow = 1;
+	q.distance = distance;
+	q.transmit = 1.0;
+	run_batches(&q);
+	return (q.transmit);
+}
@@ -38,11 +38,14 @@
 ** Returns: 0 = miss, 1 = ray intersects the box.
 ** Note: does not compute the exact t value since this is only used
 ** as a culling test, not for finding the actual hit point.
+** Every call and every miss is counted in g_tls_stats (box_tests,
+** box_rejects).
 */
 int				intersect_box(t_ray *r, t_vector box[2])
 {
 	t_intersect_box		b;
 
+	++g_tls_stats.box_tests;
 	/* Precompute inverse direction to replace divisions with multiplies */
 	b.inv_dir = (t_vector){1.0 / r->dir.x, 1.0 / r->dir.y, 1.0 / r->dir.z};
 	/* sign[i] = 1 if ray goes in -i direction; selects which face is near */
@@ -57,7 +60,7 @@ int				intersect_box(t_ray *r, t_vector box[2])
 	b.max.y = (box[1 - b.sign[1]].y - r->loc.y) * b.inv_dir.y;
 	/* Early rejection: X and Y slabs don't overlap */
 	if (b.min.x > b.max.y || b.min.y > b.max.x)
-		return (0);
+		return (!++g_tls_stats.box_rejects);
 	/* Narrow the interval: take the tighter of the X and Y bounds */
 	if (b.min.y > b.min.x)
 		b.min.x = b.min.y;
@@ -68,6 +71,6 @@ int				intersect_box(t_ray *r, t_vector box[2])
 	b.max.z = (box[1 - b.sign[2]].z - r->loc.z) * b.inv_dir.z;
 	/* Final rejection: combined XY interval vs Z slab */
 	if (b.min.x > b.max.z || b.min.z > b.max.x)
-		return (0);
+		return (!++g_tls_stats.box_rejects);
 	return (1);
 }
@@ -1,54 +1,227 @@
 /*
-** intersect_object.c -- Mesh object intersection via brute-force triangle
-** testing.
+** intersect_object.c -- Mesh instance intersection through the mesh's BVH.
 **
-** A mesh object (loaded from an OBJ file) consists of an array of triangle
-** faces. This function tests the ray against every triangle in the mesh
-** and tracks the nearest hit.
+** An OBJECT is an instance of a shared mesh (see instance.c). The ray is
+** taken into the mesh's object space -- or used as it is for an instance
+** with no placement -- and walks the mesh's BVH (see bvh_build.c): a node
+** whose box the ray misses, or enters beyond the nearest hit so far, is
+** skipped with everything below it, and only the faces in the leaves the
+** ray reaches are tested.
 **
-** This is called only after the ray has already passed the bounding box
-** test (see intersect_box.c), so we know the ray at least enters the
-** volume containing the mesh. The brute-force approach tests all faces
-** rather than using a spatial acceleration structure (BVH/KD-tree),
-** which keeps the code simple at the cost of O(n) per ray per mesh.
+** This is called only after the ray has already passed the instance's
+** bounding box test (see intersect_box.c).
 **
-** When a hit is found, the environment's o_hit (face pointer),
-** object_hit (mesh pointer), and hit_type are updated so that the
-** shading pipeline can access the face normal and the object's material.
+** When a hit is found, the environment's o_hit (face pointer), o_normal
+** (its normal in scene space), object_hit (instance pointer), and
+** hit_type are updated so that the shading pipeline can access the face
+** normal and the object's material.
+**
+** Until the mesh's BVH has been built (in the background, see
+** bvh_async.c), every face is tested instead, last to first. The faces are
+** ranked the same way on both paths, so the result is the same.
+**
+** Counters: every BVH node visited is a node visit, every face tested an
+** intersection test.
+*/
+
+#include "bvh.h"
+
+/* The ray in o's object space, and the reciprocal of its direction. */
+static void		object_ray(t_object *o, t_ray *in, t_ray *r, t_vector *inv)
+{
+	if (o->identity)
+		*r = *in;
+	else
+		instance_ray(o, in, r);
+	*inv = (t_vector){1.0 / r->dir.x, 1.0 / r->dir.y, 1.0 / r->dir.z};
+}
+
+/*
+** test_face -- intersect_triangle on face f of m, with its vertices
+** widened to double so the test's arithmetic is the same as ever.
+*/
+static int		test_face(t_ray *r, t_mesh *m, size_t f, double *t)
+{
+	t_vector	v[3];
+	t_face		face;
+	t_vec3f		*p;
+	int			k;
+
+	k = -1;
+	while (++k < 3)
+	{
+		p = &m->v[m->idx[3 * f + k]];
+		v[k] = (t_vector){p->x, p->y, p->z};
+	}
+	face = (t_face){&v[0], &v[1], &v[2], NULL};
+	return (intersect_triangle(r, &face, t));
+}
+
+/*
+** face_normal -- The normal of face f of o, in scene space.
 */
+t_vector		face_normal(t_object *o, size_t f)
+{
+	return ((o->identity) ? oct_decode(o->mesh->n[f]) :
+		instance_normal(o, oct_decode(o->mesh->n[f])));
+}
 
-#include "rt.h"
+/*
+** hit_face -- Record face f of o, hit at t, if it is the nearest hit.
+** best is the face of o that set the nearest hit so far (SIZE_MAX for
+** none): on an exact tie with it, the higher face index wins, as when the
+** faces were scanned from last to first.
+*/
+static void		hit_face(t_env *e, t_object *o, size_t f, double t,
+		size_t *best)
+{
+	if (!(t < e->t || (t == e->t && *best != SIZE_MAX && f > *best)))
+		return ;
+	*best = f;
+	e->t = t;
+	e->o_hit = f;
+	e->o_normal = face_normal(o, f);
+	e->object_hit = o;
+	e->hit_type = FACE;
+}
 
 /*
-** intersect_object -- Test a ray against all triangles in a mesh object.
+** nearest_all -- intersect_object for a mesh whose BVH is not built yet:
+** every face, last to first. Returns 1 if a face became the nearest hit.
+*/
+static int		nearest_all(t_env *e, t_object *o, t_ray *r, double *t)
+{
+	size_t	f;
+	size_t	best;
+
+	best = SIZE_MAX;
+	f = o->mesh->faces;
+	while (f--)
+	{
+		++g_tls_stats.intersection_tests;
+		++g_tls_stats.prim_tests[PRIM_TRIANGLE];
+		if (test_face(r, o->mesh, f, t))
+		{
+			++g_tls_stats.prim_hits[PRIM_TRIANGLE];
+			hit_face(e, o, f, *t, &best);
+		}
+	}
+	return (best != SIZE_MAX);
+}
+
+/* occluded_all -- occluded_object for a mesh whose BVH is not built yet. */
+static int		occluded_all(t_object *o, t_ray *r, double distance)
+{
+	size_t	f;
+	double	t;
+
+	f = o->mesh->faces;
+	while (f--)
+		if (++g_tls_stats.prim_tests[PRIM_TRIANGLE] &&
+			test_face(r, o->mesh, f, &t) &&
+			++g_tls_stats.prim_hits[PRIM_TRIANGLE] && t < distance)
+			return (1);
+	return (0);
+}
+
+/*
+** intersect_object -- Test a ray against the faces of a mesh instance.
 **
 ** Parameters:
 **   e - environment (contains the ray and stores the nearest hit)
-**   o - mesh object (array of face pointers + face count)
+**   o - mesh instance
 **   t - scratch variable for individual triangle hit distances
 **
-** Returns: 1 if any triangle was hit, 0 otherwise.
-** Side effect: updates e->t, e->o_hit, e->object_hit, e->hit_type
-** whenever a closer triangle is found.
+** Returns: 1 if a face became the nearest hit, 0 otherwise.
+** Side effect: updates e->t, e->o_hit, e->o_normal, e->object_hit and
+** e->hit_type whenever a closer face is found.
 */
-int		intersect_object(t_env *e, t_object *o, double *t)
+int				intersect_object(t_env *e, t_object *o, double *t)
 {
-	size_t	face;
-	int		hit;
+	size_t		stack[BVH_STACK];
+	t_bvh_node	*n;
+	t_ray		r;
+	t_vector	inv;
+	size_t		sp;
+	size_t		k;
+	size_t		best;
 
-	face = o->faces;
-	hit = 0;
-	while (face--)
+	if (!o->mesh->faces)
+		return (0);
+	object_ray(o, &e->ray, &r, &inv);
+	if (!atomic_load_explicit(&o->mesh->ready, memory_order_acquire))
+		return (nearest_all(e, o, &r, t));
+	best = SIZE_MAX;
+	sp = 0;
+	stack[sp++] = 0;
+	while (sp)
 	{
-		++g_tls_stats.intersection_tests;
-		if (intersect_triangle(&e->ray, o->face[face], t) && *t < e->t)
+		k = stack[--sp];
+		n = &o->mesh->bvh.node[k];
+		++g_tls_stats.node_visits;
+		if (!bvh_enter(n, r.loc, inv, e->t))
+			continue ;
+		if (!n->count)
+		{
+			stack[sp++] = n->index;
+			stack[sp++] = k + 1;
+			continue ;
+		}
+		k = (size_t)n->index - 1;
+		while (++k < (size_t)n->index + n->count)
+		{
+			++g_tls_stats.intersection_tests;
+			++g_tls_stats.prim_tests[PRIM_TRIANGLE];
+			if (test_face(&r, o->mesh, o->mesh->bvh.order[k], t))
+			{
+				++g_tls_stats.prim_hits[PRIM_TRIANGLE];
+				hit_face(e, o, o->mesh->bvh.order[k], *t, &best);
+			}
+		}
+	}
+	return (best != SIZE_MAX);
+}
+
+/*
+** occluded_object -- Whether any face of o is hit by the shadow ray ray
+** closer than distance. Stops at the first such face.
+*/
+int				occluded_object(t_object *o, t_ray *ray, double distance)
+{
+	size_t		stack[BVH_STACK];
+	t_bvh_node	*n;
+	t_ray		r;
+	t_vector	inv;
+	size_t		sp;
+	size_t		k;
+	double		t;
+
+	if (!o->mesh->faces)
+		return (0);
+	object_ray(o, ray, &r, &inv);
+	if (!atomic_load_explicit(&o->mesh->ready, memory_order_acquire))
+		return (occluded_all(o, &r, distance));
+	sp = 0;
+	stack[sp++] = 0;
+	while (sp)
+	{
+		k = stack[--sp];
+		n = &o->mesh->bvh.node[k];
+		++g_tls_stats.node_visits;
+		if (!bvh_enter(n, r.loc, inv, distance))
+			continue ;
+		if (!n->count)
 		{
-			e->t = *t;
-			e->o_hit = o->face[face];
-			e->object_hit = o;
-			e->hit_type = FACE;
-			hit = 1;
+			stack[sp++] = n->index;
+			stack[sp++] = k + 1;
+			continue ;
 		}
+		k = (size_t)n->index - 1;
+		while (++k < (size_t)n->index + n->count)
+			if (++g_tls_stats.prim_tests[PRIM_TRIANGLE] &&
+				test_face(&r, o->mesh, o->mesh->bvh.order[k], &t) &&
+				++g_tls_stats.prim_hits[PRIM_TRIANGLE] && t < distance)
+				return (1);
 	}
-	return (hit);
+	return (0);
 }
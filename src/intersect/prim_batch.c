@@ -0,0 +1,204 @@
+/*
+** prim_batch.c -- Group the primitives by type into structure-of-arrays
+** batches.
+**
+** e->prim is an array of pointers to t_prim, in scene-file order, with
+** every type mixed together. Intersecting it means a pointer chase and an
+** unpredictable type branch per primitive per ray. The batches hold the
+** same primitives sorted by type (e->batch[PRIM_*]), each field in its own
+** contiguous array, carrying only what that type's intersection needs:
+**
+**   sphere      centre, radius^2
+**   hemisphere  centre, axis, radius^2
+**   plane       point, normal, loc . normal
+**   disk        centre, normal, loc . normal, radius
+**   cylinder    centre, axis, radius^2, limit
+**   cone        apex, axis, cos^2, sin^2, limit
+**
+** The precomputed values are computed exactly as the per-primitive
+** routines compute them, so both give bit-identical results.
+**
+** The batches are built after the scene is read. Within a batch, the
+** bounded primitives come first, in the leaf order of the batch's BVH if
+** it has one (src/bvh/prim_bvh.c), then the unbounded ones, each group in
+** scene order.
+**
+** The batches are a copy, so before every frame update_prim_batches copies
+** every primitive into its slot again (grab mode moves them) and refits
+** the BVHs, rebuilding the batches only when a tree has degraded.
+*/
+
+#include "rt.h"
+
+/* A fresh column of n doubles. */
+static double	*column(t_env *e, size_t n)
+{
+	double	*col;
+
+	if (!(col = (double *)malloc(sizeof(double) * MAX(n, 1))))
+		err(MALLOC_ERROR, "build_prim_batches", e);
+	return (col);
+}
+
+/*
+** alloc_batch -- Allocate the columns the batch's type uses. The
+** centre/point columns and the id column exist for every type.
+*/
+static void		alloc_batch(t_env *e, t_prim_batch *b, int type)
+{
+	int		axis;
+
+	axis = (type != PRIM_SPHERE);
+	if (!(b->id = (size_t *)malloc(sizeof(size_t) * MAX(b->n, 1))))
+		err(MALLOC_ERROR, "build_prim_batches", e);
+	b->x = column(e, b->n);
+	b->y = column(e, b->n);
+	b->z = column(e, b->n);
+	b->ax = axis ? column(e, b->n) : NULL;
+	b->ay = axis ? column(e, b->n) : NULL;
+	b->az = axis ? column(e, b->n) : NULL;
+	b->r2 = (type == PRIM_SPHERE || type == PRIM_HEMI_SPHERE ||
+		type == PRIM_CYLINDER) ? column(e, b->n) : NULL;
+	b->radius = (type == PRIM_DISK) ? column(e, b->n) : NULL;
+	b->d = (type == PRIM_PLANE || type == PRIM_DISK) ? column(e, b->n) : NULL;
+	b->cos2 = (type == PRIM_CONE) ? column(e, b->n) : NULL;
+	b->sin2 = (type == PRIM_CONE) ? column(e, b->n) : NULL;
+	b->limit = (type == PRIM_CYLINDER || type == PRIM_CONE) ?
+		column(e, b->n) : NULL;
+}
+
+/* Copy primitive p into slot i of its batch. */
+static void		fill_slot(t_prim_batch *b, size_t i, t_prim *p)
+{
+	t_vector	axis;
+
+	b->x[i] = p->loc.x;
+	b->y[i] = p->loc.y;
+	b->z[i] = p->loc.z;
+	axis = (p->type == PRIM_PLANE || p->type == PRIM_DISK) ? p->normal :
+		p->dir;
+	if (b->ax)
+	{
+		b->ax[i] = axis.x;
+		b->ay[i] = axis.y;
+		b->az[i] = axis.z;
+	}
+	if (b->r2)
+		b->r2[i] = p->radius * p->radius;
+	if (b->radius)
+		b->radius[i] = p->radius;
+	if (b->d)
+		b->d[i] = vdot(p->loc, p->normal);
+	if (b->cos2)
+	{
+		b->cos2[i] = p->cos_angle * p->cos_angle;
+		b->sin2[i] = p->sin_angle * p->sin_angle;
+	}
+	if (b->limit)
+		b->limit[i] = p->limit;
+}
+
+/*
+** build_prim_batches -- (Re)build e->batch from e->prim, with the BVHs.
+** Types without an intersection routine (a stray TRIANGLE primitive) are
+** left out, as before.
+*/
+void			build_prim_batches(t_env *e)
+{
+	size_t	i;
+	int		type;
+
+	free_prim_batches(e);
+	if (!(e->batch = (t_prim_batch *)calloc(PRIM_TYPES, sizeof(t_prim_batch))))
+		err(MALLOC_ERROR, "build_prim_batches", e);
+	i = -1;
+	while (++i < e->prims)
+		if ((type = e->prim[i]->type) > 0 && type < PRIM_TYPES &&
+			type != PRIM_TRIANGLE)
+			++e->batch[type].n;
+	type = 0;
+	while (++type < PRIM_TYPES)
+	{
+		if (e->batch[type].n)
+			alloc_batch(e, &e->batch[type], type);
+		e->batch[type].n = 0;
+	}
+	i = -1;
+	while (++i < e->prims)
+		if ((type = e->prim[i]->type) > 0 && type < PRIM_TYPES &&
+			type != PRIM_TRIANGLE)
+			e->batch[type].id[e->batch[type].n++] = i;
+	type = 0;
+	while (++type < PRIM_TYPES)
+	{
+		build_prim_bvh(e, &e->batch[type]);
+		i = -1;
+		while (++i < e->batch[type].n)
+			fill_slot(&e->batch[type], i, e->prim[e->batch[type].id[i]]);
+	}
+}
+
+/*
+** update_prim_batches -- Bring e->batch up to date with e->prim before a
+** frame: copy every primitive into its slot again and refit the BVHs, or
+** rebuild everything if one asks for it.
+*/
+void			update_prim_batches(t_env *e)
+{
+	t_prim_batch	*b;
+	size_t			i;
+	int				type;
+
+	if (!e->batch)
+	{
+		build_prim_batches(e);
+		return ;
+	}
+	type = 0;
+	while (++type < PRIM_TYPES)
+	{
+		b = &e->batch[type];
+		i = -1;
+		while (++i < b->n)
+			fill_slot(b, i, e->prim[b->id[i]]);
+		if (b->bvh.nodes && refit_prim_bvh(e, b) == -1)
+		{
+			build_prim_batches(e);
+			return ;
+		}
+	}
+}
+
+/* Free every batch column and the batch array itself. */
+void			free_prim_batches(t_env *e)
+{
+	t_prim_batch	*b;
+	int				type;
+
+	if (!e->batch)
+		return ;
+	type = -1;
+	while (++type < PRIM_TYPES)
+	{
+		b = &e->batch[type];
+		free(b->id);
+		free(b->x);
+		free(b->y);
+		free(b->z);
+		free(b->ax);
+		free(b->ay);
+		free(b->az);
+		free(b->r2);
+		free(b->radius);
+		free(b->d);
+		free(b->cos2);
+		free(b->sin2);
+		free(b->limit);
+		free(b->bvh.node);
+		free(b->ref);
+		free(b->leaf);
+		free(b->dirty);
+	}
+	free(e->batch);
+	e->batch = NULL;
+}
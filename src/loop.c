@@ -1,15 +1,29 @@
 /*
 ** loop.c -- SDL event loop and input dispatch.
 **
-** Runs an infinite event loop at approximately 60 fps (16 ms delay per
-** iteration). Polls SDL events and dispatches them to the appropriate
-** handlers:
-**   - Keyboard: Escape exits, D redraws, E exports PPM, S saves scene
+** Runs an infinite event loop at FRAME_RATE iterations per second. Polls
+** SDL events and dispatches them to the appropriate handlers:
+**   - Keyboard: Escape exits, D redraws, E exports PPM, S saves scene,
+**     B starts or ends rendering a selected region (src/user_input/region.c)
 **   - Mouse: left/right click for selection, middle-click for camera
 **     rotation mode, scroll wheel for grab-mode depth adjustment
 **   - Camera: middle-click + WASD for camera fly-through movement,
 **     middle-click + mouse motion for camera rotation
 **   - Grab mode: G key enables object dragging with mouse motion
+**   - Scene file: with --watch, a saved scene file is reloaded between
+**     polls (src/reload)
+**
+** Handlers do not draw: they change the scene and ask for a frame
+** (schedule_draw); camera keys held and grab motion are gathered too.
+** Once per --fps interval frame_tick applies what was gathered and draws
+** the result, once, however many events asked for it -- a burst of input
+** makes one frame of the latest state rather than a frame per event. A
+** low --fps only spaces out the frames: events are still drained and
+** finished tiles shown every iteration.
+**
+** Frames are drawn by the render thread (src/render_thread.c), so the loop
+** never waits for one: every iteration it shows whatever tiles have
+** finished since the last.
 **
 ** The program has two keyboard modes:
 **   1. Normal mode (key_press): object manipulation keys
@@ -22,7 +36,7 @@
 #include "rt.h"
 
 /*
-** Handle key-down events. Escape always exits. D/E/S only work when
+** Handle key-down events. Escape always exits. D/E/S/B only work when
 ** not in middle-click camera mode (to avoid accidental triggers while
 ** flying the camera). When objects are loaded (e->objects != 0), key
 ** handling for movement/selection is disabled.
@@ -32,11 +46,13 @@ static void	event_keydown(t_env *e, SDL_Keycode key)
 	if (key == SDLK_ESCAPE)
 		exit_rt(e, 0);
 	else if (key == SDLK_d && !(e->flags & KEY_MID_CLICK))
-		draw(e, (SDL_Rect){0, 0, e->x, e->y});
+		schedule_draw(e);
 	else if (key == SDLK_e && !(e->flags & KEY_MID_CLICK))
 		export(e);
 	else if (key == SDLK_s && !(e->flags & KEY_MID_CLICK))
 		save(e);
+	else if (key == SDLK_b && !(e->flags & KEY_MID_CLICK))
+		region_key(e);
 	else if (!e->objects && e->flags & KEY_MID_CLICK)
 		mkey_press(e, key);
 	else if (!e->objects && !(e->flags & KEY_MID_CLICK))
@@ -48,6 +64,7 @@ static void	event_keydown(t_env *e, SDL_Keycode key)
 ** Multiple event types may be queued per frame -- process them all.
 ** Mouse motion for camera rotation is only processed while middle-click
 ** is held. Grab mode (KEY_G) handles mouse motion and scroll separately.
+** While a region is being dragged out (KEY_B), the left button drags it.
 */
 static void	event_poll(t_env *e)
 {
@@ -63,14 +80,15 @@ static void	event_poll(t_env *e)
 			event_keydown(e, event.key.keysym.sym);
 		else if (event.type == SDL_KEYUP && event.key.repeat == 0)
 			key_release(e, event.key.keysym.sym);
+		else if ((event.type == SDL_MOUSEBUTTONDOWN ||
+			event.type == SDL_MOUSEBUTTONUP) && region_mouse(e, &event))
+			continue ;
 		else if (event.type == SDL_MOUSEBUTTONUP && !e->objects)
 			click_release(e, event);
 		else if (event.type == SDL_MOUSEBUTTONDOWN && !e->objects)
 			mouse_click(e, event.button.button);
 		else if (e->flags & KEY_MID_CLICK && !e->s_num)
 			(event.type == SDL_MOUSEMOTION) ? cam_rot(e, event) : 0;
-		/* Camera movement is applied every frame while middle-click held. */
-		(e->flags & KEY_MID_CLICK) ? cam_move(e) : 0;
 		if (e->flags & KEY_G && event.type == SDL_MOUSEMOTION)
 			grab(e, &event);
 		if (e->flags & KEY_G && event.type == SDL_MOUSEWHEEL)
@@ -78,15 +96,71 @@ static void	event_poll(t_env *e)
 	}
 }
 
+/* schedule_draw -- Ask for a frame of the scene as it is at the next tick. */
+void		schedule_draw(t_env *e)
+{
+	e->sched.redraw = 1;
+	e->sched.retrace = 1;
+}
+
+/*
+** schedule_reshade -- Ask for a frame after a change that moves no primary
+** hit (lights, materials): unless something else asks for one too, it is
+** shaded from the G-buffer (src/gbuffer.c).
+*/
+void		schedule_reshade(t_env *e)
+{
+	e->sched.redraw = 1;
+}
+
+/*
+** frame_tick -- Move the camera for the movement keys held, by the time
+** since the last tick (so its speed depends neither on how many events
+** arrive nor on --fps). If a frame was asked for and the last one was at
+** least an --fps interval ago, apply the grab motion gathered since and
+** draw.
+*/
+static void	frame_tick(t_env *e)
+{
+	t_sched	*s;
+	double	now;
+
+	s = &e->sched;
+	now = clock_ms();
+	if ((e->flags & KEY_MID_CLICK) && (e->flags & CAM_KEYS))
+		cam_move(e, (now - s->last_tick) * FRAME_RATE / 1000.0);
+	s->last_tick = now;
+	if (!s->redraw || now - s->last_draw < s->interval_ms)
+		return ;
+	s->last_draw = now;
+	grab_apply(e);
+	e->reshade = !e->sched.retrace;
+	e->sched.redraw = 0;
+	e->sched.retrace = 0;
+	draw(e, e->region);
+	e->reshade = 0;
+}
+
 /*
 ** Main event loop. Runs forever (exits via exit_rt from within handlers).
-** SDL_Delay(16) yields ~60 fps to avoid busy-waiting.
+** Each iteration lasts 1000 / FRAME_RATE ms, sleeping for whatever the
+** work left of it; frame_tick spaces frames by the --fps interval.
 */
 void		event_loop(t_env *e)
 {
+	double	tick;
+	double	left;
+
+	e->sched.interval_ms = 1000.0 / e->opt.fps;
+	e->sched.last_tick = clock_ms();
 	while (42)
 	{
+		tick = clock_ms();
 		event_poll(e);
-		SDL_Delay(16);
+		watch_poll(e);
+		frame_tick(e);
+		render_present(e);
+		left = 1000.0 / FRAME_RATE - (clock_ms() - tick);
+		SDL_Delay(left > 0 ? (Uint32)left : 0);
 	}
 }
@@ -6,10 +6,17 @@
 **   increments from rendering threads).
 ** - g_tls_stats: thread-local counters that each thread accumulates into
 **   privately, avoiding atomic overhead on hot paths.
+** and the frame generation, g_frame_gen, that cancels stale frames (draw.c).
 **
-** Program flow: validate arguments -> store scene filename -> init_env()
+** Program flow: parse_options() (run mode + scene filename) -> init_env()
 ** (parse scene file + create SDL window) -> draw() (render the initial frame)
 ** -> event_loop() (interactive SDL event handling for camera movement, etc.).
+**
+** In the distributed modes the initial frame is produced differently: a
+** worker never returns from run_worker(), and a coordinator assembles the
+** first frame from worker tiles before entering the usual event loop.
+** With --output the first frame is written to a PPM file and the program
+** exits without ever opening a window.
 */
 
 #include "rt.h"
@@ -20,17 +27,31 @@ t_stats					g_stats;
 /* Thread-local stats -- each pthread gets its own copy, no locking needed. */
 _Thread_local t_thread_stats	g_tls_stats;
 
+/* Generation of the frame being drawn -- tiles of older ones stop early. */
+_Atomic size_t			g_frame_gen;
+
 int		main(int ac, char **av)
 {
 	t_env	e;
 
 	memset(&g_stats, 0, sizeof(t_stats));
-	if (ac != 2)
-		err(USAGE_ERROR, NULL, &e);
-	e.file_name = strdup(av[1]);
+	parse_options(&e, ac, av);
 	init_env(&e);
-	/* Render the full image (region covers entire window). */
-	draw(&e, (SDL_Rect){0, 0, e.x, e.y});
+	if (e.opt.trace)
+		trace_init(&e);
+	if (e.opt.mode == RUN_WORKER)
+		run_worker(&e);
+	else if (e.opt.mode == RUN_COORDINATOR)
+		run_coordinator(&e);
+	else
+		/* Render the image, or just the part of it --crop names. */
+		draw(&e, e.region);
+	/* Headless single-frame render: save the image and stop here. */
+	if (e.opt.output)
+	{
+		export_ppm(&e, e.opt.output, e.region);
+		exit_rt(&e, 0);
+	}
 	/* Enter the interactive event loop -- never returns (exits via exit_rt). */
 	event_loop(&e);
 	return (0);
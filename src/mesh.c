@@ -0,0 +1,148 @@
+/*
+** mesh.c -- Compact mesh storage: normal encoding and the memory report.
+**
+** A mesh keeps its geometry in flat arrays (see t_mesh): a float triple
+** per vertex, three 32-bit vertex indices and one 32-bit normal per face,
+** and 32-byte BVH nodes. Precision is only widened where it matters: each
+** face is converted to double when it is tested (intersect_object.c), so
+** the intersection arithmetic is unchanged.
+**
+** The report compares both against the pointer layout meshes had before.
+**
+** Normals use the octahedral encoding: the unit sphere is projected onto
+** the octahedron |x| + |y| + |z| = 1, whose lower half is folded over the
+** upper, leaving a square in which x and y are each stored as a 16-bit
+** signed fraction. The angular error is below 1e-4 radians.
+*/
+
+#include "rt.h"
+
+/* Malloc's estimated footprint for one n-byte block, header included. */
+static size_t	chunk(size_t n)
+{
+	size_t	size;
+
+	size = (n + 8 + 15) & ~(size_t)15;
+	return (MAX(size, 32));
+}
+
+/* -1 for negative x, else 1. */
+static double	sign_of(double x)
+{
+	return ((x < 0.0) ? -1.0 : 1.0);
+}
+
+/*
+** oct_encode -- n (any length) as two 16-bit fractions, x in the low half
+** and y in the high half. A zero vector encodes as +z.
+*/
+uint32_t		oct_encode(t_vector n)
+{
+	double	l1;
+	double	u;
+	double	v;
+	double	t;
+
+	if ((l1 = fabs(n.x) + fabs(n.y) + fabs(n.z)) == 0.0)
+		return (0);
+	u = n.x / l1;
+	v = n.y / l1;
+	if (n.z < 0.0)
+	{
+		t = u;
+		u = (1.0 - fabs(v)) * sign_of(t);
+		v = (1.0 - fabs(t)) * sign_of(v);
+	}
+	return ((uint32_t)(uint16_t)(int16_t)lrint(u * 32767.0) |
+		(uint32_t)(uint16_t)(int16_t)lrint(v * 32767.0) << 16);
+}
+
+/* oct_decode -- The unit vector encoded in c. */
+t_vector		oct_decode(uint32_t c)
+{
+	double	u;
+	double	v;
+	double	z;
+	double	t;
+
+	u = (int16_t)(uint16_t)(c & 0xffff) / 32767.0;
+	v = (int16_t)(uint16_t)(c >> 16) / 32767.0;
+	z = 1.0 - fabs(u) - fabs(v);
+	if (z < 0.0)
+	{
+		t = u;
+		u = (1.0 - fabs(v)) * sign_of(t);
+		v = (1.0 - fabs(t)) * sign_of(v);
+	}
+	return (vunit((t_vector){u, v, z}));
+}
+
+/*
+** pointer_bytes -- What m's geometry would take in the layout meshes had
+** before: each vertex, vertex normal and face a separate malloc'd block
+** behind a pointer (t_vector, t_vector and t_face).
+*/
+static size_t	pointer_bytes(t_mesh *m)
+{
+	return ((m->verticies + m->vnormals) * (sizeof(void *) +
+		chunk(sizeof(t_vector))) +
+		m->faces * (sizeof(void *) + chunk(sizeof(t_face))));
+}
+
+/* compact_bytes -- What m's geometry takes now. */
+static size_t	compact_bytes(t_mesh *m)
+{
+	return (m->verticies * sizeof(t_vec3f) + m->faces * (3 + 1) *
+		sizeof(uint32_t));
+}
+
+/*
+** bvh_report -- Print m's BVH: its SAH cost, build (or cache load) time
+** and size against its old layout (72-byte nodes of double boxes and
+** size_t indices over a size_t order array).
+*/
+void			bvh_report(t_mesh *m)
+{
+	printf("BVH %s: %zu nodes, SAH cost %.2f, %s in %.1f ms, "
+		"%.1f KiB (pointer layout %.1f KiB)\n", m->file, m->bvh.nodes,
+		m->bvh.sah, (m->map) ? "loaded from cache" : "built", m->build_ms,
+		(m->bvh.nodes * sizeof(t_bvh_node) + m->faces * sizeof(uint32_t)) /
+		1024.0, (m->bvh.nodes * (2 * sizeof(t_vector) + 3 * sizeof(size_t)) +
+		m->faces * sizeof(size_t)) / 1024.0);
+}
+
+/*
+** mesh_report -- Print the size of each mesh's geometry, and what it
+** would have taken in the old pointer layout. The old layout also loaded
+** a copy of the mesh per OBJECT, so its total counts every instance. The
+** BVHs are reported as they are built (bvh_report).
+*/
+void			mesh_report(t_env *e)
+{
+	size_t	i;
+	size_t	j;
+	size_t	users;
+	size_t	total[2];
+
+	total[0] = 0;
+	total[1] = 0;
+	i = -1;
+	while (++i < e->meshes)
+	{
+		users = 0;
+		j = -1;
+		while (++j < e->objects)
+			users += (e->object[j]->mesh == e->mesh[i]);
+		printf("%s: %zu faces, %zu vertices, %zu instance%s: "
+			"%.1f KiB (pointer layout %.1f KiB)\n", e->mesh[i]->file,
+			e->mesh[i]->faces, e->mesh[i]->verticies, users,
+			(users == 1) ? "" : "s",
+			compact_bytes(e->mesh[i]) / 1024.0,
+			pointer_bytes(e->mesh[i]) / 1024.0);
+		total[0] += compact_bytes(e->mesh[i]);
+		total[1] += users * pointer_bytes(e->mesh[i]);
+	}
+	if (e->meshes)
+		printf("Meshes: %.1f KiB (pointer layout, a copy per object: "
+			"%.1f KiB)\n", total[0] / 1024.0, total[1] / 1024.0);
+}
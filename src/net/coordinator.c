@@ -0,0 +1,303 @@
+/*
+** coordinator.c -- Distributes the first frame across worker processes.
+**
+** ./RT --coordinator ADDR scene listens on ADDR, accepts any number of
+** workers (up to NET_MAX_WORKERS) at any time during the frame, and keeps
+** every connected worker busy with one tile at a time. Returned tiles are
+** written straight into e->img and, when there is a window, shown as they
+** arrive, the same progressive feedback p_join gives a local render.
+**
+** Fault handling:
+**   - A worker that disconnects, times out mid-message or sends garbage is
+**     dropped; if nobody else is rendering its tile, the tile goes back to
+**     the pending pool.
+**   - Once the pending pool is empty, idle workers are given duplicates of
+**     straggling tiles (see NET_SLOW_FACTOR). The first copy back wins and
+**     later copies are discarded.
+**
+** Only the initial frame is distributed. Afterwards the coordinator drops
+** into the normal event loop and interactive redraws are rendered locally.
+*/
+
+#include "net.h"
+#include <poll.h>
+#include <sys/socket.h>
+
+/*
+** init_tiles -- Split the image into CHUNK_SIZE tiles in the same
+** row-major order make_chunks uses, clamping the last row and column.
+*/
+static void		init_tiles(t_env *e, t_coordinator *c)
+{
+	size_t	x;
+	size_t	y;
+
+	c->tiles = ((e->x + CHUNK_SIZE - 1) / CHUNK_SIZE) *
+		((e->y + CHUNK_SIZE - 1) / CHUNK_SIZE);
+	if (!(c->tile = (t_net_tile *)calloc(c->tiles, sizeof(t_net_tile))) ||
+		!(c->buf = (uint32_t *)malloc(CHUNK_SIZE * CHUNK_SIZE *
+			sizeof(uint32_t))))
+		err(MALLOC_ERROR, "init_tiles", e);
+	c->tiles = 0;
+	y = 0;
+	while (y < e->y)
+	{
+		x = 0;
+		while (x < e->x)
+		{
+			c->tile[c->tiles++].d = (SDL_Rect){x, y,
+				MIN(CHUNK_SIZE, e->x - x), MIN(CHUNK_SIZE, e->y - y)};
+			x += CHUNK_SIZE;
+		}
+		y += CHUNK_SIZE;
+	}
+}
+
+/*
+** drop_worker -- Close worker i and requeue its tile if it was the only
+** copy in flight. Workers are swap-removed, so callers iterate backwards.
+*/
+static void		drop_worker(t_coordinator *c, size_t i)
+{
+	t_net_tile	*t;
+
+	if (c->worker[i].tile >= 0)
+	{
+		t = &c->tile[c->worker[i].tile];
+		if (--t->copies == 0 && t->state != NET_TILE_DONE)
+			t->state = NET_TILE_PENDING;
+	}
+	close(c->worker[i].fd);
+	c->worker[i] = c->worker[--c->workers];
+}
+
+/*
+** accept_worker -- Accept a connection. Its NET_HELLO is read once it
+** arrives, like any other message (read_hello): waiting for it here would
+** hold up every other worker while a slow peer got round to it.
+*/
+static void		accept_worker(t_coordinator *c)
+{
+	int		fd;
+
+	if ((fd = accept(c->listen_fd, NULL, NULL)) == -1)
+		return ;
+	if (c->workers == NET_MAX_WORKERS)
+	{
+		fprintf(stderr, "Coordinator: rejected worker\n");
+		close(fd);
+		return ;
+	}
+	net_tune(fd, 1);
+	c->worker[c->workers++] = (t_net_worker){fd, -1, clock_ms(), 0};
+}
+
+/*
+** read_hello -- Check worker i's NET_HELLO. A worker rendering at a
+** different resolution would return tiles that do not fit, so it is turned
+** away. Returns -1 if the worker should be dropped.
+*/
+static int		read_hello(t_env *e, t_coordinator *c, size_t i)
+{
+	t_net_msg	msg;
+
+	if (net_recv_msg(c->worker[i].fd, &msg) == -1 || msg.type != NET_HELLO ||
+		(size_t)msg.w != e->x || (size_t)msg.h != e->y)
+	{
+		fprintf(stderr, "Coordinator: rejected worker\n");
+		return (-1);
+	}
+	c->worker[i].hello = 1;
+	++c->connected;
+	return (0);
+}
+
+/*
+** store_tile -- Copy a returned tile into the image and show it: only the
+** tile is copied to the window and updated.
+*/
+static void		store_tile(t_env *e, t_coordinator *c, t_net_tile *t)
+{
+	SDL_Rect	to;
+	int			row;
+
+	row = -1;
+	while (++row < t->d.h)
+		memcpy(&e->px[(t->d.y + row) * e->x + t->d.x], &c->buf[row * t->d.w],
+			t->d.w * sizeof(uint32_t));
+	t->state = NET_TILE_DONE;
+	++c->done;
+	if (e->win)
+	{
+		to = t->d;
+		SDL_BlitSurface(e->img, &t->d, e->win_img, &to);
+		SDL_UpdateWindowSurfaceRects(e->win, &t->d, 1);
+	}
+}
+
+/*
+** read_worker -- Handle a NET_PIXELS message from worker i. Returns -1 if
+** the worker broke protocol or went away and should be dropped.
+*/
+static int		read_worker(t_env *e, t_coordinator *c, size_t i)
+{
+	t_net_worker	*w;
+	t_net_tile		*t;
+	t_net_msg		msg;
+
+	w = &c->worker[i];
+	if (w->tile < 0 || net_recv_msg(w->fd, &msg) == -1 ||
+		msg.type != NET_PIXELS || msg.id != (uint32_t)w->tile)
+		return (-1);
+	t = &c->tile[w->tile];
+	if (msg.x != t->d.x || msg.y != t->d.y || msg.w != t->d.w ||
+		msg.h != t->d.h || net_recv_pixels(w->fd, c->buf, t->d.w * t->d.h))
+		return (-1);
+	if (t->state != NET_TILE_DONE)
+	{
+		store_tile(e, c, t);
+		c->rays += ((size_t)msg.rays_hi << 32) | msg.rays_lo;
+		c->tile_ms += (clock_ms() - w->start - c->tile_ms) / c->done;
+	}
+	--t->copies;
+	w->tile = -1;
+	return (0);
+}
+
+/*
+** next_tile -- Pick work for an idle worker: the first pending tile, or
+** failing that the longest-running straggler. Returns -1 if there is
+** nothing worth handing out.
+*/
+static long		next_tile(t_coordinator *c, double now)
+{
+	double	limit;
+	long	best;
+	size_t	i;
+
+	i = 0;
+	while (i < c->tiles && c->tile[i].state != NET_TILE_PENDING)
+		++i;
+	if (i < c->tiles)
+		return (i);
+	limit = MAX(NET_SLOW_MIN_MS, NET_SLOW_FACTOR * c->tile_ms);
+	best = -1;
+	i = -1;
+	while (++i < c->tiles)
+		if (c->tile[i].state == NET_TILE_ACTIVE && c->tile[i].copies == 1 &&
+			now - c->tile[i].start > limit &&
+			(best < 0 || c->tile[i].start < c->tile[best].start))
+			best = i;
+	if (best >= 0)
+		++c->reassigned;
+	return (best);
+}
+
+/*
+** assign -- Give every idle worker a tile, dropping any worker whose
+** socket fails on the way.
+*/
+static void		assign(t_coordinator *c)
+{
+	t_net_msg	msg;
+	t_net_tile	*t;
+	size_t		i;
+	long		n;
+	double		now;
+
+	now = clock_ms();
+	i = c->workers;
+	while (i--)
+	{
+		if (!c->worker[i].hello || c->worker[i].tile >= 0 ||
+			(n = next_tile(c, now)) < 0)
+			continue ;
+		t = &c->tile[n];
+		if (t->state == NET_TILE_PENDING)
+			t->start = now;
+		t->state = NET_TILE_ACTIVE;
+		++t->copies;
+		c->worker[i].tile = n;
+		c->worker[i].start = now;
+		msg = (t_net_msg){NET_TILE, n, t->d.x, t->d.y, t->d.w, t->d.h, 0, 0};
+		if (net_send_msg(c->worker[i].fd, &msg, NULL, 0) == -1)
+			drop_worker(c, i);
+	}
+}
+
+/*
+** poll_workers -- Wait up to NET_POLL_MS for new connections, greetings or
+** finished tiles and service whatever is ready. A connection that has not
+** said hello within NET_IO_TIMEOUT seconds is dropped, so that silent ones
+** do not use up the slots.
+*/
+static void		poll_workers(t_env *e, t_coordinator *c)
+{
+	struct pollfd	pfd[NET_MAX_WORKERS + 1];
+	size_t			i;
+	double			now;
+
+	pfd[0] = (struct pollfd){c->listen_fd, POLLIN, 0};
+	i = -1;
+	while (++i < c->workers)
+		pfd[i + 1] = (struct pollfd){c->worker[i].fd, POLLIN, 0};
+	if (poll(pfd, c->workers + 1, NET_POLL_MS) < 0)
+		return ;
+	now = clock_ms();
+	i = c->workers;
+	while (i--)
+		if ((pfd[i + 1].revents && (c->worker[i].hello ?
+			read_worker(e, c, i) : read_hello(e, c, i)) == -1) ||
+			(!c->worker[i].hello &&
+			now - c->worker[i].start > NET_IO_TIMEOUT * 1000.0))
+			drop_worker(c, i);
+	if (pfd[0].revents & POLLIN)
+		accept_worker(c);
+}
+
+/*
+** finish -- Release workers and sockets and report the frame.
+*/
+static void		finish(t_env *e, t_coordinator *c, double start)
+{
+	t_net_msg	msg;
+
+	msg = (t_net_msg){NET_DONE, 0, 0, 0, 0, 0, 0, 0};
+	while (c->workers)
+	{
+		net_send_msg(c->worker[c->workers - 1].fd, &msg, NULL, 0);
+		close(c->worker[--c->workers].fd);
+	}
+	close(c->listen_fd);
+	if (!strncmp(e->opt.addr, "unix:", 5))
+		unlink(e->opt.addr + 5);
+	free(c->tile);
+	free(c->buf);
+	atomic_fetch_add(&g_stats.rays, c->rays);
+	printf("Frame drawn in %.6f seconds\n", (clock_ms() - start) / 1000.0);
+	printf("Distributed %zu tiles over %zu workers (%zu reassigned)\n",
+		c->tiles, c->connected, c->reassigned);
+	printf("Total rays: %zu\n", c->rays);
+}
+
+/*
+** run_coordinator -- Render the initial frame with remote workers.
+*/
+void			run_coordinator(t_env *e)
+{
+	t_coordinator	c;
+	double			start;
+
+	memset(&c, 0, sizeof(t_coordinator));
+	c.listen_fd = net_listen(e, e->opt.addr);
+	init_tiles(e, &c);
+	printf("Waiting for workers on %s\n", e->opt.addr);
+	fflush(stdout);
+	start = clock_ms();
+	while (c.done < c.tiles)
+	{
+		assign(&c);
+		poll_workers(e, &c);
+	}
+	finish(e, &c, start);
+}
@@ -0,0 +1,300 @@
+/*
+** net_socket.c -- Socket plumbing for distributed tile rendering.
+**
+** Address forms accepted by net_listen / net_connect:
+**   unix:/path/to/socket   Unix domain stream socket
+**   host:port              TCP (IPv4 or IPv6, resolved with getaddrinfo)
+**   port                   TCP; listen on every interface, or connect to
+**                          localhost
+**
+** Messages are a fixed t_net_msg header optionally followed by pixels.
+** send_all / recv_all loop until the whole buffer has moved, since stream
+** sockets are free to transfer less than was asked for. MSG_NOSIGNAL keeps
+** a write to a dead peer from raising SIGPIPE; the caller sees -1 instead
+** and drops the connection.
+*/
+
+#include "net.h"
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+
+/*
+** unix_addr -- Fill a sockaddr_un from "unix:/path". Returns -1 if the
+** path does not fit in sun_path.
+*/
+static int		unix_addr(struct sockaddr_un *sun, char *addr)
+{
+	char	*path;
+
+	path = addr + 5;
+	if (strlen(path) >= sizeof(sun->sun_path))
+		return (-1);
+	memset(sun, 0, sizeof(*sun));
+	sun->sun_family = AF_UNIX;
+	strcpy(sun->sun_path, path);
+	return (0);
+}
+
+/*
+** inet_addr_info -- Resolve "host:port" or "port" with getaddrinfo.
+** The split happens at the last ':' so bracket-less IPv6 literals with a
+** port still work ("::1:4242"). Returns NULL on failure. A host may resolve
+** to several addresses (IPv6 and IPv4, say); callers try each in turn.
+*/
+static struct addrinfo	*inet_addr_info(char *addr, int passive)
+{
+	struct addrinfo	hints;
+	struct addrinfo	*res;
+	char			*host;
+	char			*port;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = passive ? AI_PASSIVE : 0;
+	if (!(host = strdup(addr)))
+		return (NULL);
+	if ((port = strrchr(host, ':')))
+		*port++ = '\0';
+	else
+		port = host;
+	res = NULL;
+	if (getaddrinfo((port == host) ? (passive ? NULL : "localhost") : host,
+			port, &hints, &res))
+		res = NULL;
+	free(host);
+	return (res);
+}
+
+/*
+** inet_bind -- A TCP socket bound to the first of addr's addresses that
+** will take one, or -1.
+*/
+static int		inet_bind(char *addr)
+{
+	struct addrinfo	*res;
+	struct addrinfo	*ai;
+	int				fd;
+	int				one;
+
+	if (!(res = inet_addr_info(addr, 1)))
+		return (-1);
+	one = 1;
+	fd = -1;
+	ai = res;
+	while (fd == -1 && ai)
+	{
+		if ((fd = socket(ai->ai_family, SOCK_STREAM, 0)) != -1)
+		{
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+			if (bind(fd, ai->ai_addr, ai->ai_addrlen) == -1)
+			{
+				close(fd);
+				fd = -1;
+			}
+		}
+		ai = ai->ai_next;
+	}
+	freeaddrinfo(res);
+	return (fd);
+}
+
+/*
+** net_listen -- Create a listening socket on addr. A stale Unix socket
+** file left behind by a previous coordinator is removed first.
+*/
+int				net_listen(t_env *e, char *addr)
+{
+	struct sockaddr_un	sun;
+	int					fd;
+
+	if (!strncmp(addr, "unix:", 5))
+	{
+		if (unix_addr(&sun, addr) == -1 ||
+			(fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+			err(SOCKET_ERROR, addr, e);
+		unlink(sun.sun_path);
+		if (bind(fd, (struct sockaddr *)&sun, sizeof(sun)) == -1)
+			err(SOCKET_ERROR, addr, e);
+	}
+	else if ((fd = inet_bind(addr)) == -1)
+		err(SOCKET_ERROR, addr, e);
+	if (listen(fd, NET_MAX_WORKERS) == -1)
+		err(SOCKET_ERROR, addr, e);
+	return (fd);
+}
+
+/*
+** net_tune -- Per-connection options: no Nagle delay for the small header
+** messages and, if timeout is set, a receive timeout so a peer that stalls
+** half-way through a message cannot hang the reader forever. Workers block
+** on the coordinator indefinitely between tiles, so they pass 0.
+*/
+void			net_tune(int fd, int timeout)
+{
+	struct timeval	tv;
+	int				one;
+
+	one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if (!timeout)
+		return ;
+	tv.tv_sec = NET_IO_TIMEOUT;
+	tv.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+/*
+** try_connect -- One connection attempt, to each of addr's addresses in
+** turn until one answers. Returns the socket or -1.
+*/
+static int		try_connect(char *addr)
+{
+	struct sockaddr_un	sun;
+	struct addrinfo		*res;
+	struct addrinfo		*ai;
+	int					fd;
+
+	fd = -1;
+	if (!strncmp(addr, "unix:", 5))
+	{
+		if (unix_addr(&sun, addr) == -1 ||
+			(fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+			return (-1);
+		if (connect(fd, (struct sockaddr *)&sun, sizeof(sun)) == -1)
+		{
+			close(fd);
+			return (-1);
+		}
+		return (fd);
+	}
+	if (!(res = inet_addr_info(addr, 0)))
+		return (-1);
+	ai = res;
+	while (fd == -1 && ai)
+	{
+		if ((fd = socket(ai->ai_family, SOCK_STREAM, 0)) != -1 &&
+			connect(fd, ai->ai_addr, ai->ai_addrlen) == -1)
+		{
+			close(fd);
+			fd = -1;
+		}
+		ai = ai->ai_next;
+	}
+	freeaddrinfo(res);
+	return (fd);
+}
+
+/*
+** net_connect -- Connect to the coordinator at addr, retrying for a few
+** seconds so workers may be started before the coordinator.
+*/
+int				net_connect(t_env *e, char *addr)
+{
+	int		fd;
+	int		tries;
+
+	tries = NET_CONNECT_RETRIES;
+	while ((fd = try_connect(addr)) == -1 && --tries)
+		SDL_Delay(NET_POLL_MS);
+	if (fd == -1)
+		err(SOCKET_ERROR, addr, e);
+	net_tune(fd, 0);
+	return (fd);
+}
+
+/* Write exactly n bytes. Returns 0 on success, -1 if the peer is gone. */
+static int		send_all(int fd, void *buf, size_t n)
+{
+	ssize_t	sent;
+
+	while (n)
+	{
+		if ((sent = send(fd, buf, n, MSG_NOSIGNAL)) == -1 && errno == EINTR)
+			continue ;
+		if (sent <= 0)
+			return (-1);
+		buf = (char *)buf + sent;
+		n -= sent;
+	}
+	return (0);
+}
+
+/* Read exactly n bytes. Returns 0 on success, -1 on EOF/error/timeout. */
+static int		recv_all(int fd, void *buf, size_t n)
+{
+	ssize_t	got;
+
+	while (n)
+	{
+		if ((got = recv(fd, buf, n, 0)) == -1 && errno == EINTR)
+			continue ;
+		if (got <= 0)
+			return (-1);
+		buf = (char *)buf + got;
+		n -= got;
+	}
+	return (0);
+}
+
+/*
+** net_send_msg -- Send a header and, if px is non-NULL, n pixels after it.
+** The pixels are converted to network byte order in place, so px must be
+** a scratch buffer the caller no longer needs in host order.
+*/
+int				net_send_msg(int fd, t_net_msg *msg, uint32_t *px, size_t n)
+{
+	t_net_msg	wire;
+	size_t		i;
+
+	wire.type = htonl(msg->type);
+	wire.id = htonl(msg->id);
+	wire.x = (int32_t)htonl((uint32_t)msg->x);
+	wire.y = (int32_t)htonl((uint32_t)msg->y);
+	wire.w = (int32_t)htonl((uint32_t)msg->w);
+	wire.h = (int32_t)htonl((uint32_t)msg->h);
+	wire.rays_hi = htonl(msg->rays_hi);
+	wire.rays_lo = htonl(msg->rays_lo);
+	if (send_all(fd, &wire, sizeof(wire)) == -1)
+		return (-1);
+	if (!px)
+		return (0);
+	i = n;
+	while (i--)
+		px[i] = htonl(px[i]);
+	return (send_all(fd, px, n * sizeof(uint32_t)));
+}
+
+/* Receive one header and convert it to host byte order. */
+int				net_recv_msg(int fd, t_net_msg *msg)
+{
+	if (recv_all(fd, msg, sizeof(*msg)) == -1)
+		return (-1);
+	msg->type = ntohl(msg->type);
+	msg->id = ntohl(msg->id);
+	msg->x = (int32_t)ntohl((uint32_t)msg->x);
+	msg->y = (int32_t)ntohl((uint32_t)msg->y);
+	msg->w = (int32_t)ntohl((uint32_t)msg->w);
+	msg->h = (int32_t)ntohl((uint32_t)msg->h);
+	msg->rays_hi = ntohl(msg->rays_hi);
+	msg->rays_lo = ntohl(msg->rays_lo);
+	return (0);
+}
+
+/* Receive n pixels that follow a NET_PIXELS header, in host byte order. */
+int				net_recv_pixels(int fd, uint32_t *px, size_t n)
+{
+	size_t	i;
+
+	if (recv_all(fd, px, n * sizeof(uint32_t)) == -1)
+		return (-1);
+	i = n;
+	while (i--)
+		px[i] = ntohl(px[i]);
+	return (0);
+}
@@ -0,0 +1,82 @@
+/*
+** worker.c -- Headless render worker for distributed tile rendering.
+**
+** A worker (./RT --worker ADDR scene) loads the same scene as the
+** coordinator, connects, announces its resolution with NET_HELLO and then
+** renders tiles on demand. Tiles are rendered with render_chunk, the same
+** routine the local per-tile threads use, so a distributed frame is
+** bit-identical to a local one.
+**
+** The worker exits when the coordinator sends NET_DONE or disconnects.
+*/
+
+#include "net.h"
+#include "draw.h"
+
+/*
+** valid_tile -- Reject rectangles that do not lie inside the image, so a
+** confused coordinator cannot make render_chunk write out of bounds.
+*/
+static int		valid_tile(t_env *e, t_net_msg *msg)
+{
+	return (msg->x >= 0 && msg->y >= 0 && msg->w > 0 && msg->h > 0 &&
+		msg->w <= CHUNK_SIZE && msg->h <= CHUNK_SIZE &&
+		(size_t)(msg->x + msg->w) <= e->x &&
+		(size_t)(msg->y + msg->h) <= e->y);
+}
+
+/*
+** render_tile -- Render the tile described by msg into e->px, then copy
+** its rows into the contiguous send buffer buf.
+*/
+static void		render_tile(t_env *e, t_net_msg *msg, uint32_t *buf)
+{
+	t_chunk		c;
+	int			row;
+
+	c.e = e;
+	c.px = e->px;
+	c.id = 0;
+	c.gen = atomic_load(&g_frame_gen);
+	c.m = NULL;
+	c.d = (SDL_Rect){msg->x, msg->y, msg->w, msg->h};
+	c.clip = c.d;
+	render_chunk(&c);
+	row = -1;
+	while (++row < msg->h)
+		memcpy(&buf[row * msg->w], &e->px[(msg->y + row) * e->x + msg->x],
+			msg->w * sizeof(uint32_t));
+}
+
+/*
+** run_worker -- Serve tiles until the coordinator is done with us.
+** The ray count reported with each tile is the g_stats delta over it.
+*/
+void			run_worker(t_env *e)
+{
+	t_net_msg	msg;
+	uint32_t	buf[CHUNK_SIZE * CHUNK_SIZE];
+	size_t		rays;
+	int			fd;
+
+	fd = net_connect(e, e->opt.addr);
+	msg = (t_net_msg){NET_HELLO, 0, 0, 0, e->x, e->y, 0, 0};
+	if (net_send_msg(fd, &msg, NULL, 0) == -1)
+		err(SOCKET_ERROR, e->opt.addr, e);
+	setup_camera_plane(e);
+	while (net_recv_msg(fd, &msg) != -1 && msg.type == NET_TILE)
+	{
+		if (!valid_tile(e, &msg))
+			break ;
+		rays = atomic_load(&g_stats.rays);
+		render_tile(e, &msg, buf);
+		rays = atomic_load(&g_stats.rays) - rays;
+		msg.type = NET_PIXELS;
+		msg.rays_hi = (uint32_t)((uint64_t)rays >> 32);
+		msg.rays_lo = (uint32_t)rays;
+		if (net_send_msg(fd, &msg, buf, msg.w * msg.h) == -1)
+			break ;
+	}
+	close(fd);
+	exit_rt(e, 0);
+}
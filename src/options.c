@@ -0,0 +1,208 @@
+/*
+** options.c -- Command-line option parsing.
+**
+** Usage: ./RT [OPTIONS] <scene>
+**
+**   --worker ADDR       Run headless as a render worker: connect to the
+**                       coordinator at ADDR, load the scene once, then
+**                       render the tiles it hands out until told to stop.
+**   --coordinator ADDR  Listen on ADDR, split the first frame into tiles
+**                       and farm them out to every worker that connects,
+**                       then carry on as the normal interactive renderer.
+**   --heatmap PREFIX    After every full frame, write PREFIX.ppm (false-colour
+**                       intersection tests per pixel), PREFIX.csv (cost per
+**                       tile) and PREFIX_pixels.csv (cost per pixel).
+**   --stats FILE        After every full frame, append a one-line JSON
+**                       document of detailed statistics to FILE.
+**   --perf              Read hardware performance counters (cycles,
+**                       instructions, cache and branch misses) in every
+**                       render thread and add them to the frame report.
+**   --trace FILE        Record a Chrome trace-event timeline of every
+**                       frame (tile threads, p_join waits, blits) to FILE,
+**                       for chrome://tracing or Perfetto.
+**   --output FILE       Render the first frame headlessly, write it to FILE
+**                       as a PPM and exit (used by the golden-image tests).
+**   --bvh-cache DIR     Keep built mesh BVHs in DIR and load them from
+**                       there when the same OBJ file is rendered again.
+**   --watch             Reload the scene whenever its file is saved,
+**                       keeping the window and whatever did not change
+**                       (src/reload).
+**   --fps N             Draw at most N frames per second in response to
+**                       input (default FRAME_RATE); input arriving faster
+**                       is gathered into the next frame.
+**   --crop X Y W H      Render only the W x H rectangle at (X, Y): every
+**                       frame in the window, and the image --output
+**                       writes. Its pixels are those of the full frame.
+**   --denoise           Smooth every full frame with an edge-aware filter
+**                       guided by the normals, depths and materials seen,
+**                       before it is shown or written.
+**   --size W H          Override the scene's RENDER resolution.
+**   --super N           Override the scene's SUPER sample count.
+**   --maxdepth N        Override the scene's MAXDEPTH.
+**
+** ADDR is "unix:/path/to/socket", "host:port", or a bare "port" (the
+** coordinator listens on all interfaces, a worker connects to localhost).
+**
+** The scene file is the only positional argument. Anything unrecognised
+** is a usage error.
+*/
+
+#include "rt.h"
+
+/*
+** Defaults: local interactive mode with a window, no socket address.
+*/
+static void	init_options(t_env *e)
+{
+	e->opt.mode = RUN_LOCAL;
+	e->opt.headless = 0;
+	e->opt.addr = NULL;
+	e->opt.heatmap = NULL;
+	e->opt.stats = NULL;
+	e->opt.perf = 0;
+	e->opt.trace = NULL;
+	e->opt.output = NULL;
+	e->opt.bvh_cache = NULL;
+	e->opt.watch = 0;
+	e->opt.crop = (SDL_Rect){0, 0, 0, 0};
+	e->opt.denoise = 0;
+	e->opt.fps = FRAME_RATE;
+	e->opt.width = 0;
+	e->opt.height = 0;
+	e->opt.super = 0;
+	e->opt.maxdepth = 0;
+	e->file_name = NULL;
+}
+
+/*
+** render_option -- Options that override scene settings or redirect the
+** output. Returns the number of arguments consumed (0 = not one of them);
+** a value that is missing or not a positive number is a usage error.
+*/
+static int	render_option(t_env *e, int ac, char **av, int i)
+{
+	int		n;
+
+	n = 0;
+	if (!strcmp(av[i], "--output") || !strcmp(av[i], "--super") ||
+		!strcmp(av[i], "--maxdepth") || !strcmp(av[i], "--fps"))
+		n = 2;
+	else if (!strcmp(av[i], "--size"))
+		n = 3;
+	if (!n)
+		return (0);
+	if (i + n > ac || (n == 3 && (atoi(av[i + 1]) <= 0 ||
+		atoi(av[i + 2]) <= 0)) || (strcmp(av[i], "--output") &&
+		atoi(av[i + 1]) <= 0))
+		err(USAGE_ERROR, NULL, e);
+	if (!strcmp(av[i], "--output"))
+	{
+		e->opt.output = av[i + 1];
+		e->opt.headless = 1;
+	}
+	else if (!strcmp(av[i], "--super"))
+		e->opt.super = atoi(av[i + 1]);
+	else if (!strcmp(av[i], "--maxdepth"))
+		e->opt.maxdepth = atoi(av[i + 1]);
+	else if (!strcmp(av[i], "--fps"))
+		e->opt.fps = atoi(av[i + 1]);
+	else
+	{
+		e->opt.width = atoi(av[i + 1]);
+		e->opt.height = atoi(av[i + 2]);
+	}
+	return (n);
+}
+
+/*
+** crop_option -- --crop X Y W H. Returns the number of arguments consumed
+** (0 = not --crop); X and Y may be 0, W and H must be positive.
+*/
+static int	crop_option(t_env *e, int ac, char **av, int i)
+{
+	if (strcmp(av[i], "--crop"))
+		return (0);
+	if (i + 5 > ac || atoi(av[i + 1]) < 0 || atoi(av[i + 2]) < 0 ||
+		atoi(av[i + 3]) <= 0 || atoi(av[i + 4]) <= 0)
+		err(USAGE_ERROR, NULL, e);
+	e->opt.crop = (SDL_Rect){atoi(av[i + 1]), atoi(av[i + 2]),
+		atoi(av[i + 3]), atoi(av[i + 4])};
+	return (5);
+}
+
+/*
+** apply_options -- Let command-line overrides win over the scene file.
+** Called by init_env right after the scene has been read. Frames are drawn
+** in the whole image, or in the part of it --crop names; a crop outside
+** the image is a usage error.
+*/
+void		apply_options(t_env *e)
+{
+	SDL_Rect	full;
+
+	if (e->opt.width)
+	{
+		e->x = e->opt.width;
+		e->y = e->opt.height;
+	}
+	if (e->opt.super)
+		e->super = e->opt.super;
+	if (e->opt.maxdepth)
+		e->maxdepth = e->opt.maxdepth;
+	full = (SDL_Rect){0, 0, e->x, e->y};
+	e->region = full;
+	if (e->opt.crop.w && !SDL_IntersectRect(&e->opt.crop, &full, &e->region))
+		err(USAGE_ERROR, NULL, e);
+}
+
+/*
+** parse_options -- Fill e->opt and e->file_name from argv.
+** Options that take a value consume the following argument. Exits with
+** USAGE_ERROR on unknown options, missing values, or a missing/duplicate
+** scene file.
+*/
+void		parse_options(t_env *e, int ac, char **av)
+{
+	int		i;
+	int		n;
+
+	init_options(e);
+	i = 0;
+	while (++i < ac)
+	{
+		if ((n = render_option(e, ac, av, i)) ||
+			(n = crop_option(e, ac, av, i)))
+			i += n - 1;
+		else if (!strcmp(av[i], "--worker") && i + 1 < ac)
+		{
+			e->opt.mode = RUN_WORKER;
+			e->opt.headless = 1;
+			e->opt.addr = av[++i];
+		}
+		else if (!strcmp(av[i], "--coordinator") && i + 1 < ac)
+		{
+			e->opt.mode = RUN_COORDINATOR;
+			e->opt.addr = av[++i];
+		}
+		else if (!strcmp(av[i], "--heatmap") && i + 1 < ac)
+			e->opt.heatmap = av[++i];
+		else if (!strcmp(av[i], "--stats") && i + 1 < ac)
+			e->opt.stats = av[++i];
+		else if (!strcmp(av[i], "--perf"))
+			e->opt.perf = 1;
+		else if (!strcmp(av[i], "--trace") && i + 1 < ac)
+			e->opt.trace = av[++i];
+		else if (!strcmp(av[i], "--bvh-cache") && i + 1 < ac)
+			e->opt.bvh_cache = av[++i];
+		else if (!strcmp(av[i], "--watch"))
+			e->opt.watch = 1;
+		else if (!strcmp(av[i], "--denoise"))
+			e->opt.denoise = 1;
+		else if (av[i][0] == '-' || e->file_name)
+			err(USAGE_ERROR, NULL, e);
+		else
+			e->file_name = strdup(av[i]);
+	}
+	if (!e->file_name)
+		err(USAGE_ERROR, NULL, e);
+}
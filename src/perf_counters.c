@@ -0,0 +1,155 @@
+/*
+** perf_counters.c -- Hardware performance counters per render thread (--perf).
+**
+** Wall time cannot tell whether tracing is compute- or memory-bound. With
+** --perf every tile thread opens four Linux perf_event_open counters on
+** itself -- cycles, instructions, cache misses and branch misses -- around
+** render_chunk, and adds the readings to g_stats. The frame report then
+** shows IPC and misses per ray next to the ray counts.
+**
+** Counters are opened one by one rather than as a group, so a machine
+** that lacks one event still reports the others. Only user-space events
+** are requested (exclude_kernel), which perf_event_paranoid <= 2 allows
+** for unprivileged processes. If the kernel multiplexes the PMU the raw
+** count is scaled by time_enabled / time_running.
+**
+** Anything that fails (no permission, no PMU in a VM, not Linux) just
+** leaves the counter closed: the tile renders normally and the report
+** says the counter was unavailable and why.
+*/
+
+#include "rt.h"
+
+#ifdef __linux__
+
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+
+/* perf_event_attr config for each PERF_* slot. */
+static const uint64_t	g_perf_config[PERF_COUNTERS] = {
+	PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+/*
+** perf_open -- Open one counting event for the calling thread, disabled.
+** Records the first errno seen so the report can explain a fallback.
+*/
+static int	perf_open(uint64_t config)
+{
+	struct perf_event_attr	attr;
+	int						fd;
+	int						expected;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+		PERF_FORMAT_TOTAL_TIME_RUNNING;
+	fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	expected = 0;
+	if (fd == -1)
+		atomic_compare_exchange_strong(&g_stats.perf_errno, &expected, errno);
+	return (fd);
+}
+
+/*
+** perf_begin -- Open and start every available counter for this thread.
+*/
+void		perf_begin(t_perf *p)
+{
+	int		i;
+
+	i = -1;
+	while (++i < PERF_COUNTERS)
+		if ((p->fd[i] = perf_open(g_perf_config[i])) != -1)
+		{
+			ioctl(p->fd[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(p->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+}
+
+/*
+** perf_end -- Stop, read and close the counters, adding the (scaled)
+** readings to g_stats.
+*/
+void		perf_end(t_perf *p)
+{
+	uint64_t	v[3];
+	int			i;
+
+	i = -1;
+	while (++i < PERF_COUNTERS)
+	{
+		if (p->fd[i] == -1)
+			continue ;
+		ioctl(p->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+		if (read(p->fd[i], v, sizeof(v)) == sizeof(v) && v[2])
+		{
+			if (v[2] < v[1])
+				v[0] = (uint64_t)((double)v[0] * v[1] / v[2]);
+			atomic_fetch_add(&g_stats.perf[i], v[0]);
+			atomic_fetch_add(&g_stats.perf_tiles[i], 1);
+		}
+		close(p->fd[i]);
+	}
+}
+
+#else
+
+void		perf_begin(t_perf *p)
+{
+	int		i;
+
+	i = -1;
+	while (++i < PERF_COUNTERS)
+		p->fd[i] = -1;
+	g_stats.perf_errno = ENOSYS;
+}
+
+void		perf_end(t_perf *p)
+{
+	(void)p;
+}
+
+#endif
+
+/*
+** perf_print -- Append the counter report to the frame summary. A counter
+** is only shown if it was read on every tile; a partial sum would make
+** the per-ray ratios meaningless.
+*/
+void		perf_print(void)
+{
+	static const char	*name[PERF_COUNTERS] = {"Cycles", "Instructions",
+		"Cache misses", "Branch misses"};
+	size_t				rays;
+	int					i;
+
+	rays = MAX(atomic_load(&g_stats.rays), 1);
+	i = -1;
+	while (++i < PERF_COUNTERS)
+		if (perf_valid(i))
+			printf("%s: %zu (%.2f per ray)\n", name[i],
+				atomic_load(&g_stats.perf[i]),
+				(double)atomic_load(&g_stats.perf[i]) / rays);
+		else
+			printf("%s: unavailable (%s)\n", name[i],
+				g_stats.perf_errno ? strerror(g_stats.perf_errno) :
+				"not counted on every tile");
+	if (perf_valid(PERF_CYCLES) && perf_valid(PERF_INSTRUCTIONS))
+		printf("IPC: %.3f\n", (double)atomic_load(&g_stats.perf[
+			PERF_INSTRUCTIONS]) / MAX(atomic_load(&g_stats.perf[PERF_CYCLES]),
+			1));
+}
+
+/* Non-zero if counter i was read on every tile of the last frame. */
+int			perf_valid(int i)
+{
+	return (atomic_load(&g_stats.perf_tiles[i]) &&
+		atomic_load(&g_stats.perf_tiles[i]) == atomic_load(&g_stats.threads));
+}
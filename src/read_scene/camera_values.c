@@ -28,50 +28,39 @@
 **   pt1 - The attribute key (e.g., "LOC", "DIR", "UP", "APERTURE").
 **   pt2 - The attribute value string (e.g., "0 5 -10" or "0.5").
 */
-static void	set_camera_values(t_env *e, char *pt1, char *pt2)
+static void	set_camera_values(t_env *e, t_token pt1, t_token pt2)
 {
-	t_split_string	values;
-
-	values = nstrsplit(pt2, ' ');
-	if (!strcmp(pt1, "LOC"))
-		e->camera.loc = get_vector(e, values);
-	else if (!strcmp(pt1, "DIR"))
-		e->camera.dir = get_vector(e, values);
-	else if (!strcmp(pt1, "UP"))
-		e->camera.up = get_vector(e, values);
-	else if (!strcmp(pt1, "APERTURE"))
-		e->camera.a = atof(pt2);
-	free_split(&values);
+	if (tok_is(pt1, "LOC"))
+		e->camera.loc = get_vector(e, scene_words(pt2));
+	else if (tok_is(pt1, "DIR"))
+		e->camera.dir = get_vector(e, scene_words(pt2));
+	else if (tok_is(pt1, "UP"))
+		e->camera.up = get_vector(e, scene_words(pt2));
+	else if (tok_is(pt1, "APERTURE"))
+		e->camera.a = tok_double(pt2);
 }
 
 /*
 ** get_camera_attributes -- Read all lines of a CAMERA block.
 **
-** Reads tab-delimited "KEY\tVALUE" lines from the scene file stream until
-** a blank line (block terminator) or EOF is encountered. Each line is split
+** Reads tab-delimited "KEY\tVALUE" lines from the scene file until a
+** blank line (block terminator) or EOF is encountered. Each line is split
 ** on tabs and dispatched to set_camera_values.
 **
 ** Parameters:
-**   e      - Environment struct to populate.
-**   stream - File stream positioned just after the "CAMERA" header line.
+**   e - Environment struct to populate.
+**   s - Scene file, positioned just after the "CAMERA" header line.
 */
-void		get_camera_attributes(t_env *e, FILE *stream)
+void		get_camera_attributes(t_env *e, t_scene *s)
 {
-	t_split_string	attr;
-	char			*line = NULL;
-	size_t			len = 0;
+	t_token	line;
+	t_token	key;
+	t_token	value;
 
-	attr.words = 0;
-	while (getline(&line, &len, stream) != -1)
+	while (scene_line(e, s, &line) && line.len)
 	{
-		line[strcspn(line, "\n")] = '\0';
-		if (line[0] == '\0')
-			break ;
-		attr = nstrsplit(line, '\t');
-		if (attr.words < 2)
+		if (scene_attr(line, &key, &value) < 2)
 			err(FILE_FORMAT_ERROR, "Camera attributes", e);
-		set_camera_values(e, &attr.strings[0][0], &attr.strings[1][0]);
-		free_split(&attr);
+		set_camera_values(e, key, value);
 	}
-	free(line);
 }
@@ -28,20 +28,19 @@
 ** from 683 lumens/watt (luminous efficacy at 555nm) * 0.005 (scaling factor),
 ** giving a perceptually reasonable brightness range for scene values of 1-100.
 */
-static void	set_light_values(t_env *e, char *pt1, char *pt2)
+static void	set_light_values(t_env *e, t_token pt1, t_token pt2)
 {
-	t_split_string	values;
+	t_words	values;
 
-	values = nstrsplit(pt2, ' ');
-	if (!strcmp(pt1, "LOC"))
+	values = scene_words(pt2);
+	if (tok_is(pt1, "LOC"))
 		e->light[e->lights]->loc = get_vector(e, values);
-	else if (!strcmp(pt1, "COLOUR"))
+	else if (tok_is(pt1, "COLOUR"))
 		e->light[e->lights]->colour = get_colour(e, values);
-	else if (!strcmp(pt1, "INTENSITY"))
-		e->light[e->lights]->lm = atof(values.strings[0]) * 3.415;
-	else if (!strcmp(pt1, "HALF"))
-		e->light[e->lights]->half = atof(values.strings[0]);
-	free_split(&values);
+	else if (tok_is(pt1, "INTENSITY"))
+		e->light[e->lights]->lm = tok_double(values.word[0]) * 3.415;
+	else if (tok_is(pt1, "HALF"))
+		e->light[e->lights]->half = tok_double(values.word[0]);
 }
 
 /*
@@ -61,31 +60,25 @@ static void	init_light(t_light *l)
 /*
 ** get_light_attributes -- Read all lines of a LIGHT block.
 **
-** Allocates a new t_light, initializes it with defaults, then reads
-** tab-delimited attribute lines until a blank line terminates the block.
-** After parsing, increments the global light counter so the next LIGHT
-** block writes to the next array slot.
+** Allocates a new t_light in the next slot of the (growing) light array,
+** initializes it with defaults, then reads tab-delimited attribute lines
+** until a blank line terminates the block. After parsing, increments the
+** global light counter so the next LIGHT block writes to the next slot.
 */
-void		get_light_attributes(t_env *e, FILE *stream)
+void		get_light_attributes(t_env *e, t_scene *s)
 {
-	t_split_string	attr;
-	char			*line = NULL;
-	size_t			len = 0;
+	t_token	line;
+	t_token	key;
+	t_token	value;
 
-	attr.words = 0;
+	e->light = scene_slot(e, e->light, e->lights, &s->lights_cap);
 	e->light[e->lights] = (t_light *)malloc(sizeof(t_light));
 	init_light(e->light[e->lights]);
-	while (getline(&line, &len, stream) != -1)
+	while (scene_line(e, s, &line) && line.len)
 	{
-		line[strcspn(line, "\n")] = '\0';
-		if (line[0] == '\0')
-			break ;
-		attr = nstrsplit(line, '\t');
-		if (attr.words < 2)
+		if (scene_attr(line, &key, &value) < 2)
 			err(FILE_FORMAT_ERROR, "Light attributes", e);
-		set_light_values(e, attr.strings[0], attr.strings[1]);
-		free_split(&attr);
+		set_light_values(e, key, value);
 	}
-	free(line);
 	++e->lights;
 }
@@ -0,0 +1,105 @@
+/*
+** material_index.c -- Hash index of the material names.
+**
+** PRIMITIVE and OBJECT blocks name their material, and resolving each
+** name by scanning every material made scene loading O(primitives x
+** materials). The index maps a name to its material in constant expected
+** time: FNV-1a of the name, then linear probing in a power-of-two table
+** that doubles whenever it would become more than half full.
+**
+** A material is added once its block is complete, as only complete
+** materials could be named before. When two materials share a name, the
+** later one replaces the earlier in the index, as the backwards scan
+** found the later one first.
+**
+** The index lives in t_env for as long as the materials do, and is freed
+** with them by exit_rt.
+*/
+
+#include "rt.h"
+
+/* FNV-1a of the len bytes at s. */
+static size_t	name_hash(const char *s, size_t len)
+{
+	uint64_t	h;
+
+	h = 0xcbf29ce484222325ULL;
+	while (len--)
+		h = (h ^ (unsigned char)*s++) * 0x100000001b3ULL;
+	return ((size_t)h);
+}
+
+/*
+** probe -- The slot holding the material named name, or the empty slot
+** where it would go.
+*/
+static size_t	probe(t_env *e, t_token name)
+{
+	size_t	mask;
+	size_t	i;
+
+	mask = e->mat_index.size - 1;
+	i = name_hash(name.s, name.len) & mask;
+	while (e->mat_index.slot[i] &&
+		!tok_is(name, e->material[e->mat_index.slot[i] - 1]->name))
+		i = (i + 1) & mask;
+	return (i);
+}
+
+/* grow -- Double the table (or create it) and re-insert every entry. */
+static void		grow(t_env *e)
+{
+	t_mat_index	old;
+	const char	*name;
+	size_t		i;
+
+	old = e->mat_index;
+	e->mat_index.size = (old.size) ? 2 * old.size : MAT_INDEX_SIZE;
+	if (!(e->mat_index.slot = (size_t *)calloc(e->mat_index.size,
+		sizeof(size_t))))
+		err(MALLOC_ERROR, "material_index", e);
+	i = -1;
+	while (++i < old.size)
+		if (old.slot[i])
+		{
+			name = e->material[old.slot[i] - 1]->name;
+			e->mat_index.slot[probe(e, (t_token){name, strlen(name)})] =
+				old.slot[i];
+		}
+	free(old.slot);
+}
+
+/*
+** mat_index_add -- Index material m under its name, replacing any earlier
+** material of the same name.
+*/
+void			mat_index_add(t_env *e, size_t m)
+{
+	size_t	i;
+
+	if (2 * (e->mat_index.used + 1) > e->mat_index.size)
+		grow(e);
+	i = probe(e, (t_token){e->material[m]->name,
+		strlen(e->material[m]->name)});
+	if (!e->mat_index.slot[i])
+		++e->mat_index.used;
+	e->mat_index.slot[i] = m + 1;
+}
+
+/* mat_index_find -- The index of the material named name, or SIZE_MAX. */
+size_t			mat_index_find(t_env *e, t_token name)
+{
+	size_t	i;
+
+	if (!e->mat_index.size)
+		return (SIZE_MAX);
+	i = probe(e, name);
+	return ((e->mat_index.slot[i]) ? e->mat_index.slot[i] - 1 : SIZE_MAX);
+}
+
+/* free_mat_index -- Free the index. */
+void			free_mat_index(t_env *e)
+{
+	free(e->mat_index.slot);
+	e->mat_index = (t_mat_index){NULL, 0, 0};
+}
@@ -45,34 +45,34 @@ static double	to_range(double value, double min, double max)
 /*
 ** set_material_values -- Assign a parsed key-value pair to the current material.
 **
-** NAME replaces the default name via strdup (the old name is freed first).
+** NAME replaces the default name with a copy of its first word (the old
+** name is freed first).
 ** DIFFUSE and SPECULAR are parsed as hex color + optional intensity via
 ** get_colour(). REFLECT, REFRACT are clamped to [0,1]. IOR is stored as-is.
 */
-static void		set_material_values(t_env *e, char *pt1, char *pt2)
+static void		set_material_values(t_env *e, t_token pt1, t_token pt2)
 {
-	t_split_string	values;
+	t_words	values;
 
-	values = nstrsplit(pt2, ' ');
-	if (!strcmp(pt1, "NAME"))
+	values = scene_words(pt2);
+	if (tok_is(pt1, "NAME"))
 	{
 		free(e->material[e->materials]->name);
 		e->material[e->materials]->name = NULL;
-		e->material[e->materials]->name = strdup(values.strings[0]);
+		e->material[e->materials]->name = tok_dup(e, values.word[0]);
 	}
-	else if (!strcmp(pt1, "DIFFUSE"))
+	else if (tok_is(pt1, "DIFFUSE"))
 		e->material[e->materials]->diff = get_colour(e, values);
-	else if (!strcmp(pt1, "SPECULAR"))
+	else if (tok_is(pt1, "SPECULAR"))
 		e->material[e->materials]->spec = get_colour(e, values);
-	else if (!strcmp(pt1, "REFLECT"))
+	else if (tok_is(pt1, "REFLECT"))
 		e->material[e->materials]->reflect =
-			to_range(atof(values.strings[0]), 0.0, 1.0);
-	else if (!strcmp(pt1, "REFRACT"))
+			to_range(tok_double(values.word[0]), 0.0, 1.0);
+	else if (tok_is(pt1, "REFRACT"))
 		e->material[e->materials]->refract =
-			to_range(atof(values.strings[0]), 0.0, 1.0);
-	else if (!strcmp(pt1, "IOR"))
-		e->material[e->materials]->ior = atof(values.strings[0]);
-	free_split(&values);
+			to_range(tok_double(values.word[0]), 0.0, 1.0);
+	else if (tok_is(pt1, "IOR"))
+		e->material[e->materials]->ior = tok_double(values.word[0]);
 }
 
 /*
@@ -100,30 +100,27 @@ void			init_material(t_material *m)
 /*
 ** get_material_attributes -- Read all lines of a MATERIAL block.
 **
-** Allocates a new t_material, initializes it with defaults (hot-pink),
-** then reads tab-delimited attribute lines until a blank line terminates
-** the block. After parsing, increments the material counter.
+** Allocates a new t_material in the next slot of the (growing) material
+** array, initializes it with defaults (hot-pink), then reads tab-delimited
+** attribute lines until a blank line terminates the block. After parsing,
+** indexes the material by name and increments the material counter.
 */
-void	get_material_attributes(t_env *e, FILE *stream)
+void			get_material_attributes(t_env *e, t_scene *s)
 {
-	t_split_string	attr;
-	char			*line = NULL;
-	size_t			len = 0;
+	t_token	line;
+	t_token	key;
+	t_token	value;
 
-	attr.words = 0;
+	e->material = scene_slot(e, e->material, e->materials,
+		&s->materials_cap);
 	e->material[e->materials] = (t_material *)malloc(sizeof(t_material));
 	init_material(e->material[e->materials]);
-	while (getline(&line, &len, stream) != -1)
+	while (scene_line(e, s, &line) && line.len)
 	{
-		line[strcspn(line, "\n")] = '\0';
-		if (line[0] == '\0')
-			break ;
-		attr = nstrsplit(line, '\t');
-		if (attr.words < 2)
+		if (scene_attr(line, &key, &value) < 2)
 			err(FILE_FORMAT_ERROR, "Material attributes", e);
-		set_material_values(e, attr.strings[0], attr.strings[1]);
-		free_split(&attr);
+		set_material_values(e, key, value);
 	}
-	free(line);
+	mat_index_add(e, e->materials);
 	++e->materials;
 }
@@ -6,26 +6,47 @@
 ** are defined by lists of triangular faces, making them suitable for
 ** complex geometry exported from 3D modeling software.
 **
-** Each OBJECT block has two attributes:
+** Each OBJECT block is an instance of a mesh, with these attributes:
 **   FILE     - Path to the .obj file. First tried as-is, then relative to
 **              the scene file's directory (using dirname). This allows scene
 **              files to reference OBJ files using relative paths.
 **   MATERIAL - Name of the material to apply to all faces of this mesh.
+**   LOC      - Where the mesh's origin is placed (default 0 0 0).
+**   ROT      - Rotation in degrees about X, then Y, then Z (default 0 0 0).
+**   SCALE    - One uniform factor or three per-axis factors (default 1).
 **
-** The OBJ loading is a two-pass process (similar to the scene parser):
+** A mesh is loaded once per distinct file (e->mesh): further OBJECT blocks
+** naming the same file share its faces, vertices and BVH, so repeating a
+** mesh costs one small t_object per copy. Rays are taken into the mesh's
+** own space to be intersected (see instance.c). When the scene is reloaded
+** (--watch), a mesh of the live scene whose file has not changed since it
+** was loaded is taken over, BVH and all (reuse_mesh).
+**
+** The OBJ loading is a two-pass process:
 **   Pass 1 (get_quantities): Counts vertices, vertex normals, and faces
 **     to pre-allocate arrays of the exact size needed.
 **   Pass 2 (read_obj): Rewinds and reads the actual vertex/normal/face data.
 **
 ** After loading, an axis-aligned bounding box (AABB) is computed from
-** the mesh vertices. During rendering, rays are first tested against
-** this bounding box -- if the ray misses the box, all individual triangle
-** intersection tests are skipped. This is a crucial optimization since
-** mesh objects can have thousands of faces.
+** the mesh vertices. A BVH is built over its faces once the scene is read,
+** in the background (bvh_async.c).
+** During rendering, rays are first tested against the instance's bounding
+** box, then walk the BVH so only faces near the ray are tested.
 */
 
 #include "rt.h"
 #include <libgen.h>
+#include <sys/stat.h>
+
+/* An array of n elements of size bytes (at least one, so never NULL). */
+static void		*mesh_array(t_env *e, size_t n, size_t size)
+{
+	void	*a;
+
+	if ((a = malloc(size * MAX(n, 1))) == NULL)
+		err(MALLOC_ERROR, "get_quantities", e);
+	return (a);
+}
 
 /*
 ** get_quantities -- Pass 1 of OBJ loading: count elements for pre-allocation.
@@ -35,10 +56,13 @@
 **   "v"  - Vertex positions
 **   "f"  - Faces (triangles)
 **
-** After counting, allocates arrays for faces, vertices, and normals.
-** Resets counters to 0 and rewinds the stream for pass 2.
+** After counting, allocates the flat vertex, index and normal arrays
+** (read_obj takes care of the vertex normals). Faces and vertices are
+** numbered in 32 bits, and a BVH has up to twice as many nodes as faces,
+** which bounds the size of a mesh. Rewinds the stream for pass 2.
+** Returns the message for a mesh too big, NULL otherwise, like read_obj.
 */
-static void		get_quantities(t_object *o, FILE *stream)
+static char		*get_quantities(t_env *e, t_mesh *o, FILE *stream)
 {
 	char	*line = NULL;
 	size_t	len = 0;
@@ -53,20 +77,83 @@ static void		get_quantities(t_object *o, FILE *stream)
 			++o->faces;
 	}
 	free(line);
-	if ((o->face = (t_face **)malloc(sizeof(t_face *) * o->faces)) == NULL)
-		perror("");
-	if ((o->v = (t_vector **)malloc(sizeof(t_vector *) * o->verticies)) == NULL)
-		perror("");
-	if ((o->vn = (t_vector **)malloc(sizeof(t_vector *) * o->vnormals)) == NULL)
-		perror("");
-	o->faces = 0;
-	o->verticies = 0;
-	o->vnormals = 0;
+	if (o->faces > INT32_MAX || o->verticies > INT32_MAX)
+		return ("OBJ file has too many faces or vertices");
+	o->v = (t_vec3f *)mesh_array(e, o->verticies, sizeof(t_vec3f));
+	o->idx = (uint32_t *)mesh_array(e, o->faces, 3 * sizeof(uint32_t));
+	o->n = (uint32_t *)mesh_array(e, o->faces, sizeof(uint32_t));
 	fseek(stream, 0, SEEK_SET);
+	return (NULL);
+}
+
+/*
+** load_mesh -- The mesh for an OBJ file, loading it on first use.
+**
+** Meshes are keyed by the path they were opened with, so every OBJECT
+** naming the same file shares one copy of its geometry and BVH. The mesh
+** is listed in e->mesh before it is read, so a reload that fails on a
+** mistake in the file frees it with the rest; the stream is closed before
+** the mistake is raised.
+*/
+static t_mesh	*load_mesh(t_env *e, t_scene *s, char *file)
+{
+	FILE		*stream;
+	t_mesh		*m;
+	size_t		i;
+	double		start;
+	struct stat	st;
+	char		*bad;
+
+	i = e->meshes;
+	while (i--)
+		if (!strcmp(e->mesh[i]->file, file))
+			return (e->mesh[i]);
+	e->mesh = scene_slot(e, e->mesh, e->meshes, &s->meshes_cap);
+	if ((m = reuse_mesh(e, file)))
+		return (e->mesh[e->meshes++] = m);
+	if ((stream = fopen(file, "r")) == NULL)
+		err(FILE_OPEN_ERROR, file, e);
+	start = clock_ms();
+	if ((m = (t_mesh *)calloc(1, sizeof(t_mesh))) == NULL)
+		err(MALLOC_ERROR, "load_mesh", e);
+	m->file = strdup(file);
+	e->mesh[e->meshes++] = m;
+	if (fstat(fileno(stream), &st) == 0)
+	{
+		m->mtime = st.st_mtim;
+		m->bytes = st.st_size;
+	}
+	if (!(bad = get_quantities(e, m, stream)))
+		bad = read_obj(e, m, stream);
+	fclose(stream);
+	if (bad)
+		err(FILE_FORMAT_ERROR, bad, e);
+	e->parse.obj_ms += clock_ms() - start;
+	return (m);
+}
+
+/*
+** get_scale -- SCALE takes one uniform factor or three per-axis factors.
+** A zero factor would flatten the mesh and cannot be inverted.
+*/
+static t_vector	get_scale(t_env *e, t_words values)
+{
+	t_vector	s;
+
+	if (values.words == 1)
+	{
+		s.x = tok_double(values.word[0]);
+		s = (t_vector){s.x, s.x, s.x};
+	}
+	else
+		s = get_vector(e, values);
+	if (s.x == 0 || s.y == 0 || s.z == 0)
+		err(FILE_FORMAT_ERROR, "Object SCALE must not be zero", e);
+	return (s);
 }
 
 /*
-** set_object_values -- Handle FILE and MATERIAL attributes for an OBJECT block.
+** set_object_values -- Handle one attribute of an OBJECT block.
 **
 ** FILE handling tries two paths:
 **   1. The path as given in the scene file (could be absolute or relative to CWD).
@@ -74,75 +161,90 @@ static void		get_quantities(t_object *o, FILE *stream)
 ** This fallback makes scene files portable -- OBJ files in the same directory
 ** as the scene file will be found regardless of the working directory.
 **
-** After opening the file, it runs the two-pass OBJ loader (get_quantities
-** then read_obj) and closes the stream.
+** The mesh itself comes from load_mesh, which only reads the file the first
+** time it is named. The path is the one string copied out of the scene
+** file, since access, dirname and the OBJ loader need it NUL-terminated.
+** dirname may modify its argument, so it is given a copy of the scene
+** file's name. The path is the object's name before the mesh is loaded,
+** so a reload that fails there frees it with the object.
 */
-static void		set_object_values(t_env *e, char *pt1, char *pt2)
+static void		set_object_values(t_env *e, t_scene *s, t_token pt1,
+		t_token pt2)
 {
-	FILE	*stream;
-	char	*file;
+	t_object		*o;
+	char			*path;
+	char			*file;
+	char			*dir;
 
-	if (!strcmp(pt1, "FILE"))
+	o = e->object[e->objects];
+	if (tok_is(pt1, "FILE"))
 	{
-		file = pt2;
-		if ((stream = fopen(file, "r")) == NULL)
-			asprintf(&file, "./%s/%s", dirname(e->file_name), pt2);
-		if ((stream = fopen(file, "r")) == NULL)
-			err(FILE_OPEN_ERROR, file, e);
-		e->object[e->objects]->name = strdup(file);
-		get_quantities(e->object[e->objects], stream);
-		read_obj(e, stream);
-		if (file != pt2)
+		file = (path = tok_dup(e, pt2));
+		if (access(file, R_OK) == -1 && (dir = strdup(e->file_name)))
+		{
+			if (asprintf(&file, "%s/%s", dirname(dir), path) == -1)
+				file = path;
+			free(dir);
+		}
+		free(o->name);
+		o->name = strdup(file);
+		if (file != path)
 			free(file);
-		fclose(stream);
+		free(path);
+		o->mesh = load_mesh(e, s, o->name);
 	}
-	else if (!strcmp(pt1, "MATERIAL"))
-		e->object[e->objects]->material = get_material_number(e, pt2);
+	else if (tok_is(pt1, "MATERIAL"))
+		o->material = get_material_number(e, pt2);
+	else if (tok_is(pt1, "LOC"))
+		o->loc = get_vector(e, scene_words(pt2));
+	else if (tok_is(pt1, "ROT"))
+		o->rot = get_vector(e, scene_words(pt2));
+	else if (tok_is(pt1, "SCALE"))
+		o->scale = get_scale(e, scene_words(pt2));
 }
 
 /*
-** init_object -- Zero-initialize a new mesh object.
+** init_object -- Initialize a new mesh instance.
 **
-** All arrays start as NULL and all counters start at 0. The material
-** defaults to index 0 (the DEFAULT hot-pink material).
+** No mesh until FILE is read; identity placement. The material defaults
+** to index 0 (the DEFAULT hot-pink material).
 */
 static void		init_object(t_object *o)
 {
-	o->face = NULL;
-	o->faces = 0;
+	o->name = NULL;
+	o->mesh = NULL;
 	o->material = 0;
-	o->v = NULL;
-	o->verticies = 0;
-	o->vn = NULL;
-	o->vnormals = 0;
+	o->loc = (t_vector){0.0, 0.0, 0.0};
+	o->rot = (t_vector){0.0, 0.0, 0.0};
+	o->scale = (t_vector){1.0, 1.0, 1.0};
 }
 
 /*
 ** get_object_attributes -- Read all lines of an OBJECT block.
 **
-** Allocates a new t_object, initializes it, then reads tab-delimited
-** attribute lines (FILE and MATERIAL) until a blank line terminates the block.
+** Allocates a new t_object in the next slot of the (growing) object array,
+** initializes it, then reads tab-delimited attribute lines until a blank
+** line terminates the block. The placement is set up once the whole block
+** is read, since LOC/ROT/SCALE may come in any order.
 */
-void			get_object_attributes(t_env *e, FILE *stream)
+void			get_object_attributes(t_env *e, t_scene *s)
 {
-	t_split_string	attr;
-	char			*line = NULL;
-	size_t			len = 0;
+	t_token	line;
+	t_token	key;
+	t_token	value;
 
-	attr.words = 0;
-	e->object[e->objects] = (t_object *)malloc(sizeof(t_object));
+	e->object = scene_slot(e, e->object, e->objects, &s->objects_cap);
+	if ((e->object[e->objects] = (t_object *)malloc(sizeof(t_object))) == NULL)
+		err(MALLOC_ERROR, "get_object_attributes", e);
 	init_object(e->object[e->objects]);
-	while (getline(&line, &len, stream) != -1)
+	while (scene_line(e, s, &line) && line.len)
 	{
-		line[strcspn(line, "\n")] = '\0';
-		if (line[0] == '\0')
-			break ;
-		attr = nstrsplit(line, '\t');
-		if (attr.words < 2)
+		if (scene_attr(line, &key, &value) < 2)
 			err(FILE_FORMAT_ERROR, "Object attributes", e);
-		set_object_values(e, attr.strings[0], attr.strings[1]);
-		free_split(&attr);
+		set_object_values(e, s, key, value);
 	}
-	free(line);
+	if (!e->object[e->objects]->mesh)
+		err(FILE_FORMAT_ERROR, "Object has no FILE", e);
+	setup_instance(e->object[e->objects]);
 	++e->objects;
 }
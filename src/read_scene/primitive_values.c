@@ -34,22 +34,22 @@
 ** Returns -1 if the type name is not recognized, which triggers an error
 ** in set_primitive_values.
 */
-static int		get_type(char *type_str)
+static int		get_type(t_token type_str)
 {
 	int				type;
 
 	type = -1;
-	if (!strcmp(type_str, "sphere"))
+	if (tok_is(type_str, "sphere"))
 		type = PRIM_SPHERE;
-	else if (!strcmp(type_str, "plane"))
+	else if (tok_is(type_str, "plane"))
 		type = PRIM_PLANE;
-	else if (!strcmp(type_str, "hemi_sphere"))
+	else if (tok_is(type_str, "hemi_sphere"))
 		type = PRIM_HEMI_SPHERE;
-	else if (!strcmp(type_str, "cone"))
+	else if (tok_is(type_str, "cone"))
 		type = PRIM_CONE;
-	else if (!strcmp(type_str, "cylinder"))
+	else if (tok_is(type_str, "cylinder"))
 		type = PRIM_CYLINDER;
-	else if (!strcmp(type_str, "disk"))
+	else if (tok_is(type_str, "disk"))
 		type = PRIM_DISK;
 	return (type);
 }
@@ -57,24 +57,21 @@ static int		get_type(char *type_str)
 /*
 ** get_material_number -- Look up a material by name, return its array index.
 **
-** Searches the material array in reverse order (most recently added first).
+** Looks the name up in the material index (material_index.c); of two
+** materials with the same name, the later one is found.
+**
 ** If no match is found, prints a warning to stderr and returns 0 (the
 ** DEFAULT hot-pink material), ensuring the render can continue even with
 ** a typo in the scene file.
 */
-size_t		get_material_number(t_env *e, char *str)
+size_t		get_material_number(t_env *e, t_token str)
 {
 	size_t	material;
-	char	*warn;
 
-	material = e->materials;
-	while (material--)
-		if (!strcmp(e->material[material]->name, str))
-			return (material);
-	asprintf(&warn, "\e[208m    WARNING: Material name: %s \
-		 is not a defined material name\n", str);
-	dprintf(2, "%s", warn);
-	free(warn);
+	if ((material = mat_index_find(e, str)) != SIZE_MAX)
+		return (material);
+	dprintf(2, "\e[208m    WARNING: Material name: %.*s \
+		 is not a defined material name\n", (int)str.len, str.s);
 	return (0);
 }
 
@@ -92,33 +89,32 @@ size_t		get_material_number(t_env *e, char *str)
 ** intersection algorithms assume unit-length direction vectors to
 ** simplify the math (e.g., dot products directly give cosines).
 */
-static void		set_primitive_values(t_env *e, char *pt1, char *pt2)
+static void		set_primitive_values(t_env *e, t_token pt1, t_token pt2)
 {
-	t_split_string	values;
+	t_words	values;
 
-	values = nstrsplit(pt2, ' ');
-	if (!strcmp(pt1, "TYPE"))
-		if ((e->prim[e->prims]->type = get_type(values.strings[0])) == -1)
+	values = scene_words(pt2);
+	if (tok_is(pt1, "TYPE"))
+		if ((e->prim[e->prims]->type = get_type(values.word[0])) == -1)
 			err(FILE_FORMAT_ERROR, "Unknown primitive type", e);
-	if (!strcmp(pt1, "LOC"))
+	if (tok_is(pt1, "LOC"))
 		e->prim[e->prims]->loc = get_vector(e, values);
-	else if (!strcmp(pt1, "DIR"))
+	else if (tok_is(pt1, "DIR"))
 		e->prim[e->prims]->dir = get_unit_vector(e, values);
-	else if (!strcmp(pt1, "NORMAL"))
+	else if (tok_is(pt1, "NORMAL"))
 		e->prim[e->prims]->normal = get_unit_vector(e, values);
-	else if (!strcmp(pt1, "RADIUS"))
-		e->prim[e->prims]->radius = atof(values.strings[0]);
-	else if (!strcmp(pt1, "ANGLE"))
+	else if (tok_is(pt1, "RADIUS"))
+		e->prim[e->prims]->radius = tok_double(values.word[0]);
+	else if (tok_is(pt1, "ANGLE"))
 	{
-		e->prim[e->prims]->angle = atof(values.strings[0]) * M_PI / 180;
+		e->prim[e->prims]->angle = tok_double(values.word[0]) * M_PI / 180;
 		e->prim[e->prims]->cos_angle = cos(e->prim[e->prims]->angle);
 		e->prim[e->prims]->sin_angle = sin(e->prim[e->prims]->angle);
 	}
-	else if (!strcmp(pt1, "MATERIAL"))
-		e->prim[e->prims]->material = get_material_number(e, values.strings[0]);
-	else if (!strcmp(pt1, "LIMIT"))
-		e->prim[e->prims]->limit = atof(values.strings[0]);
-	free_split(&values);
+	else if (tok_is(pt1, "MATERIAL"))
+		e->prim[e->prims]->material = get_material_number(e, values.word[0]);
+	else if (tok_is(pt1, "LIMIT"))
+		e->prim[e->prims]->limit = tok_double(values.word[0]);
 }
 
 /*
@@ -149,30 +145,25 @@ static void		init_primitive(t_prim *p)
 /*
 ** get_primitive_attributes -- Read all lines of a PRIMITIVE block.
 **
-** Allocates a new t_prim, initializes with defaults, then reads
-** tab-delimited attribute lines until a blank line terminates the block.
-** After parsing, increments the primitive counter.
+** Allocates a new t_prim in the next slot of the (growing) primitive
+** array, initializes it with defaults, then reads tab-delimited attribute
+** lines until a blank line terminates the block. After parsing,
+** increments the primitive counter.
 */
-void get_primitive_attributes(t_env *e, FILE *stream)
+void			get_primitive_attributes(t_env *e, t_scene *s)
 {
-	t_split_string	attr;
-	char			*line = NULL;
-	size_t			len = 0;
+	t_token	line;
+	t_token	key;
+	t_token	value;
 
-	attr.words = 0;
+	e->prim = scene_slot(e, e->prim, e->prims, &s->prims_cap);
 	e->prim[e->prims] = (t_prim *)malloc(sizeof(t_prim));
 	init_primitive(e->prim[e->prims]);
-	while (getline(&line, &len, stream) != -1)
+	while (scene_line(e, s, &line) && line.len)
 	{
-		line[strcspn(line, "\n")] = '\0';
-		if (line[0] == '\0')
-			break ;
-		attr = nstrsplit(line, '\t');
-		if (attr.words < 2)
+		if (scene_attr(line, &key, &value) < 2)
 			err(FILE_FORMAT_ERROR, "Primitive attributes", e);
-		set_primitive_values(e, attr.strings[0], attr.strings[1]);
-		free_split(&attr);
+		set_primitive_values(e, key, value);
 	}
-	free(line);
 	++e->prims;
 }
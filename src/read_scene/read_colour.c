@@ -34,43 +34,46 @@ static double	to_range(double value, double min, double max)
 	return (value);
 }
 
+/*
+** hex_pair -- The two hex digits at s as an integer 0-255, parsed by
+** strtol from a NUL-terminated copy.
+*/
+static int		hex_pair(const char *s)
+{
+	char	pair[3];
+
+	pair[0] = s[0];
+	pair[1] = s[1];
+	pair[2] = '\0';
+	return ((int)strtol(pair, NULL, 16));
+}
+
 /*
 ** get_colour -- Parse a hex color string with optional intensity.
 **
 ** Parameters:
 **   e      - Environment (used only for error reporting).
-**   values - Split string: values.strings[0] = "RRGGBB",
-**            values.strings[1] = intensity (optional).
+**   values - Value split into words: word[0] = "RRGGBB",
+**            word[1] = intensity (optional).
 **
 ** Returns a t_colour with r, g, b in [0,1] and intensity in [0,1].
-**
-** The parsing uses a 3-byte temp buffer, copying 2 hex chars at a time
-** and converting with strtol. The temp buffer is null-terminated by calloc.
 */
-t_colour		get_colour(t_env *e, t_split_string values)
+t_colour		get_colour(t_env *e, t_words values)
 {
 	t_colour	res;
-	char		*temp;
 
 	res = (t_colour){0.0, 0.0, 0.0, 1.0};
 	if (values.words == 1 || values.words == 2)
 	{
-		if (strlen(values.strings[0]) != 6)
+		if (values.word[0].len != 6)
 			err(FILE_FORMAT_ERROR, "Colour has invalid format", e);
-		temp = calloc(3, sizeof(char));
-		/* Extract red channel: first 2 hex digits */
-		temp = strncpy(temp, values.strings[0], 2);
-		res.r = (int)strtol(temp, NULL, 16) / 255.0;
-		/* Extract green channel: middle 2 hex digits */
-		temp = strncpy(temp, values.strings[0] + 2, 2);
-		res.g = (int)strtol(temp, NULL, 16) / 255.0;
-		/* Extract blue channel: last 2 hex digits */
-		temp = strncpy(temp, values.strings[0] + 4, 2);
-		res.b = (int)strtol(temp, NULL, 16) / 255.0;
-		free(temp);
+		/* Red, green and blue: two hex digits each */
+		res.r = hex_pair(values.word[0].s) / 255.0;
+		res.g = hex_pair(values.word[0].s + 2) / 255.0;
+		res.b = hex_pair(values.word[0].s + 4) / 255.0;
 	}
 	if (values.words == 2)
-		res.intensity = to_range(atof(values.strings[1]), 0.0, 1.0);
+		res.intensity = to_range(tok_double(values.word[1]), 0.0, 1.0);
 	if (values.words > 2)
 		err(FILE_FORMAT_ERROR, "Invalid colour", e);
 	return (res);
@@ -12,6 +12,12 @@
 ** Lines starting with '#' (comments) or 's' (smoothing groups) are skipped.
 ** Only triangular faces (exactly 3 vertices) are supported.
 **
+** The mesh is stored compactly (see t_mesh): vertices as floats, each
+** face as three 32-bit vertex indices and one octahedral-encoded normal.
+** The vertex normals are only needed to give each face its normal, so
+** they are read into a temporary array and dropped once the faces have
+** their normals. A face with no normal index gets its geometric normal.
+**
 ** After all geometry is loaded, an axis-aligned bounding box (AABB) is
 ** computed from the vertex positions. During rendering, a ray is first
 ** tested against this bounding box before checking individual triangles.
@@ -23,11 +29,22 @@
 ** by finding the last '/' in each face token and reading the normal index
 ** after it. Vertex indices are read directly with atoi on the token.
 ** Both are converted from 1-based (OBJ convention) to 0-based (C arrays)
-** by subtracting 1.
+** by subtracting 1, and checked once the whole file is read.
 */
 
 #include "rt.h"
 
+/*
+** t_obj_normals -- The vertex normals while a file is read, and the
+** normal index each face named (UINT32_MAX for none).
+*/
+typedef struct	s_obj_normals
+{
+	t_vector	*vn;
+	size_t		vnormals;
+	uint32_t	*face;
+}				t_obj_normals;
+
 /*
 ** make_box -- Compute the axis-aligned bounding box (AABB) for a mesh.
 **
@@ -41,27 +58,31 @@
 ** (just 6 comparisons after some arithmetic), making it ideal as a
 ** first-pass culling test before expensive per-triangle checks.
 */
-static void	make_box(t_object *o)
+static void	make_box(t_mesh *o)
 {
 	size_t	vertex;
 
+	o->box[0] = (t_vector){0.0, 0.0, 0.0};
+	o->box[1] = o->box[0];
+	if (!o->verticies)
+		return ;
 	vertex = 1;
-	o->box[0] = (t_vector){o->v[0]->x, o->v[0]->y, o->v[0]->z};
+	o->box[0] = (t_vector){o->v[0].x, o->v[0].y, o->v[0].z};
 	o->box[1] = o->box[0];
 	while (vertex < o->verticies)
 	{
-		if (o->v[vertex]->x < o->box[0].x)
-			o->box[0].x = o->v[vertex]->x;
-		if (o->v[vertex]->y < o->box[0].y)
-			o->box[0].y = o->v[vertex]->y;
-		if (o->v[vertex]->z < o->box[0].z)
-			o->box[0].z = o->v[vertex]->z;
-		if (o->v[vertex]->x > o->box[1].x)
-			o->box[1].x = o->v[vertex]->x;
-		if (o->v[vertex]->y > o->box[1].y)
-			o->box[1].y = o->v[vertex]->y;
-		if (o->v[vertex]->z > o->box[1].z)
-			o->box[1].z = o->v[vertex]->z;
+		if (o->v[vertex].x < o->box[0].x)
+			o->box[0].x = o->v[vertex].x;
+		if (o->v[vertex].y < o->box[0].y)
+			o->box[0].y = o->v[vertex].y;
+		if (o->v[vertex].z < o->box[0].z)
+			o->box[0].z = o->v[vertex].z;
+		if (o->v[vertex].x > o->box[1].x)
+			o->box[1].x = o->v[vertex].x;
+		if (o->v[vertex].y > o->box[1].y)
+			o->box[1].y = o->v[vertex].y;
+		if (o->v[vertex].z > o->box[1].z)
+			o->box[1].z = o->v[vertex].z;
 		++vertex;
 	}
 }
@@ -72,12 +93,11 @@ static void	make_box(t_object *o)
 ** OBJ format: "v x y z" where x, y, z are floating-point coordinates.
 ** values->strings[0] is "v", and [1],[2],[3] are x, y, z.
 */
-static void	read_vertex(t_object *o, t_split_string *values)
+static void	read_vertex(t_mesh *o, t_split_string *values)
 {
-	o->v[o->verticies] = (t_vector *)malloc(sizeof(t_vector));
-	o->v[o->verticies]->x = atof(values->strings[1]);
-	o->v[o->verticies]->y = atof(values->strings[2]);
-	o->v[o->verticies]->z = atof(values->strings[3]);
+	o->v[o->verticies].x = (float)atof(values->strings[1]);
+	o->v[o->verticies].y = (float)atof(values->strings[2]);
+	o->v[o->verticies].z = (float)atof(values->strings[3]);
 	++o->verticies;
 }
 
@@ -87,25 +107,21 @@ static void	read_vertex(t_object *o, t_split_string *values)
 ** OBJ format: "vn x y z" where x, y, z are the normal vector components.
 ** Normals are typically unit vectors but the OBJ spec does not require it.
 */
-static void	read_vnormal(t_object *o, t_split_string *values)
+static void	read_vnormal(t_obj_normals *n, t_split_string *values)
 {
-	o->vn[o->vnormals] = (t_vector *)malloc(sizeof(t_vector));
-	o->vn[o->vnormals]->x = atof(values->strings[1]);
-	o->vn[o->vnormals]->y = atof(values->strings[2]);
-	o->vn[o->vnormals]->z = atof(values->strings[3]);
-	++o->vnormals;
+	n->vn[n->vnormals].x = atof(values->strings[1]);
+	n->vn[n->vnormals].y = atof(values->strings[2]);
+	n->vn[n->vnormals].z = atof(values->strings[3]);
+	++n->vnormals;
 }
 
 /*
-** read_face -- Parse an OBJ "f" line and create a triangle face.
+** read_face -- Parse an OBJ "f" line into the face's three vertex indices
+** and its normal index.
 **
 ** OBJ format: "f v1//n1 v2//n2 v3//n3" where v and n are 1-based indices
 ** into the vertex and normal arrays respectively.
 **
-** The face stores pointers (not copies) to the vertex and normal data,
-** so multiple faces sharing a vertex point to the same t_vector in memory.
-** This saves memory and ensures consistency.
-**
 ** Index extraction:
 **   - Vertex index: atoi(token) gives the number before the first "/".
 **   - Normal index: strrchr(token, '/') + 1 finds the number after the
@@ -113,17 +129,48 @@ static void	read_vnormal(t_object *o, t_split_string *values)
 **   - Both are decremented by 1 to convert from OBJ's 1-based indexing
 **     to C's 0-based array indexing.
 */
-static void	read_face(t_object *o, t_split_string *values)
+static void	read_face(t_mesh *o, t_obj_normals *n, t_split_string *values)
 {
-	o->face[o->faces] = (t_face *)malloc(sizeof(t_face));
-	o->face[o->faces]->v0 = o->v[atoi(values->strings[1]) - 1];
-	o->face[o->faces]->v1 = o->v[atoi(values->strings[2]) - 1];
-	o->face[o->faces]->v2 = o->v[atoi(values->strings[3]) - 1];
-	o->face[o->faces]->n =\
-		o->vn[atoi(strrchr(values->strings[1], '/') + 1) - 1];
+	char	*slash;
+
+	o->idx[3 * o->faces] = (uint32_t)(atoi(values->strings[1]) - 1);
+	o->idx[3 * o->faces + 1] = (uint32_t)(atoi(values->strings[2]) - 1);
+	o->idx[3 * o->faces + 2] = (uint32_t)(atoi(values->strings[3]) - 1);
+	n->face[o->faces] = ((slash = strrchr(values->strings[1], '/'))) ?
+		(uint32_t)(atoi(slash + 1) - 1) : UINT32_MAX;
 	++o->faces;
 }
 
+/*
+** face_normals -- Check every face's vertex indices, then encode its
+** normal: the vertex normal it named, or failing that the normal of its
+** plane, (v1 - v0) x (v2 - v0). Returns -1 if a face refers to a vertex
+** the file does not have.
+*/
+static int	face_normals(t_mesh *o, t_obj_normals *n)
+{
+	t_vector	v[3];
+	size_t		f;
+	int			k;
+
+	f = -1;
+	while (++f < o->faces)
+	{
+		k = -1;
+		while (++k < 3)
+		{
+			if (o->idx[3 * f + k] >= o->verticies)
+				return (-1);
+			v[k] = (t_vector){o->v[o->idx[3 * f + k]].x,
+				o->v[o->idx[3 * f + k]].y, o->v[o->idx[3 * f + k]].z};
+		}
+		o->n[f] = oct_encode((n->face[f] < n->vnormals) ?
+			n->vn[n->face[f]] :
+			vcross(vsub(v[1], v[0]), vsub(v[2], v[0])));
+	}
+	return (0);
+}
+
 /*
 ** read_obj -- Pass 2 of OBJ loading: read vertex, normal, and face data.
 **
@@ -133,21 +180,33 @@ static void	read_face(t_object *o, t_split_string *values)
 **   "vn" (with 4 words) -> read_vnormal
 **   "f"  (with 4 words) -> read_face (triangles only; quads are not supported)
 **
-** After all data is loaded, make_box() computes the AABB for ray culling.
+** After all data is loaded, the faces get their normals and make_box()
+** computes the AABB for ray culling. The data goes into the mesh, which
+** every OBJECT naming the file shares.
+**
+** A mistake in the file is returned as a message, NULL if there is none,
+** rather than raised: the caller closes the stream first, as err() may
+** jump back into a reload instead of exiting (reload_scene.c).
 **
 ** Note: The condition (line[0] != '#' || line[0] != 's') is always true
 ** due to the logical OR -- this is a minor bug that has no practical effect
 ** since comment and smoothing-group lines don't match any of the strcmp
 ** checks inside.
 */
-void		read_obj(t_env *e, FILE *stream)
+char		*read_obj(t_env *e, t_mesh *o, FILE *stream)
 {
 	t_split_string	values;
+	t_obj_normals	n;
 	char			*line = NULL;
 	size_t			len = 0;
-	t_object		*o;
+	int				bad;
 
-	o = e->object[e->objects];
+	n.vnormals = 0;
+	if (!(n.vn = (t_vector *)malloc(sizeof(t_vector) * MAX(o->vnormals, 1)))
+		|| !(n.face = (uint32_t *)malloc(sizeof(uint32_t) * MAX(o->faces, 1))))
+		err(MALLOC_ERROR, "read_obj", e);
+	o->faces = 0;
+	o->verticies = 0;
 	while (getline(&line, &len, stream) != -1)
 	{
 		if (line[0] != '#' || line[0] != 's')
@@ -156,12 +215,18 @@ void		read_obj(t_env *e, FILE *stream)
 			if (!strcmp(values.strings[0], "v") && values.words == 4)
 				read_vertex(o, &values);
 			if (!strcmp(values.strings[0], "vn") && values.words == 4)
-				read_vnormal(o, &values);
+				read_vnormal(&n, &values);
 			if (!strcmp(values.strings[0], "f") && values.words == 4)
-				read_face(o, &values);
+				read_face(o, &n, &values);
 			free_split(&values);
 		}
 	}
 	free(line);
+	bad = face_normals(o, &n);
+	free(n.vn);
+	free(n.face);
+	if (bad)
+		return ("OBJ face refers to a missing vertex");
 	make_box(o);
+	return (NULL);
 }
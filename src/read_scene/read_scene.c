@@ -1,19 +1,23 @@
 /*
-** read_scene.c -- Two-pass scene file parser
+** read_scene.c -- Single-pass scene file parser
 **
 ** This is the main entry point for loading a scene description from disk.
 ** The scene file format is a simple, tab-indented declarative text format
 ** that begins with the magic header "# SCENE RT".
 **
-** Parsing strategy (two-pass):
-**   Pass 1 (get_quantities): Scans the entire file to count how many LIGHT,
-**     MATERIAL, PRIMITIVE, and OBJECT blocks exist. This lets us pre-allocate
-**     arrays of the exact size needed, avoiding dynamic resizing.
-**   Pass 2: Rewinds the file, then reads in two phases:
-**     (a) Global attributes (MAXDEPTH, RENDER resolution, SUPER sampling)
-**         are read until the first blank line.
-**     (b) Type-specific blocks (CAMERA, LIGHT, MATERIAL, PRIMITIVE, OBJECT)
-**         are dispatched to their respective parsers.
+** Parsing strategy (one pass over the mapped file, see scene_lexer.c):
+**   (a) Global attributes (MAXDEPTH, RENDER resolution, SUPER sampling)
+**       are read until the first blank line.
+**   (b) Type-specific blocks (CAMERA, LIGHT, MATERIAL, PRIMITIVE, OBJECT)
+**       are dispatched to their respective parsers.
+** The light, material, primitive, object and mesh arrays are not counted
+** in advance: they start small and double when full (scene_slot), so the
+** file is only read once. Materials are indexed by name as they are read
+** (material_index.c), so naming one costs the same however many there are.
+**
+** Each phase is timed into e->parse and reported once the scene is read,
+** so a slow load can be put down to the file, a kind of block, or the OBJ
+** files it loads. The times also go into every --stats document.
 **
 ** A DEFAULT material (index 0) is always created with a hot-pink diffuse
 ** color. This makes missing or mis-named materials immediately obvious
@@ -49,27 +53,28 @@
 **   SUPER    - Supersampling factor for depth-of-field. 0 = disabled.
 **              Higher values produce smoother DOF at the cost of render time.
 */
-static void	scene_attributes(t_env *e, char *line)
+static void	scene_attributes(t_env *e, t_token line)
 {
-	t_split_string	split;
-	t_split_string	render;
+	t_token	key;
+	t_token	value;
+	t_words	render;
+	size_t	fields;
 
-	split = nstrsplit(line, '\t');
-	if (split.strings[0][0] != '#' && split.words != 2)
+	fields = scene_attr(line, &key, &value);
+	if ((!key.len || key.s[0] != '#') && fields != 2)
 		err(FILE_FORMAT_ERROR, "Scene arrtibutes", e);
-	if (!strcmp(split.strings[0], "MAXDEPTH"))
-		e->maxdepth = MAX(atoi(split.strings[1]), 1);
-	if (!strcmp(split.strings[0], "RENDER"))
+	if (tok_is(key, "MAXDEPTH"))
+		e->maxdepth = MAX(tok_int(value), 1);
+	if (tok_is(key, "RENDER"))
 	{
-		render = nstrsplit(split.strings[1], ' ');
+		render = scene_words(value);
 		if (render.words != 2)
 			err(FILE_FORMAT_ERROR, "RENDER [tab] x-res y-res", e);
-		e->x = atoi(render.strings[0]);
-		e->y = atoi(render.strings[1]);
+		e->x = tok_int(render.word[0]);
+		e->y = tok_int(render.word[1]);
 	}
-	if (!strcmp(split.strings[0], "SUPER"))
-		e->super = MAX(atoi(split.strings[1]), 0);
-	free_split(&split);
+	if (tok_is(key, "SUPER"))
+		e->super = MAX(tok_int(value), 0);
 }
 
 /*
@@ -77,113 +82,102 @@ static void	scene_attributes(t_env *e, char *line)
 **
 ** When the main loop encounters a non-indented line (a block header like
 ** "PRIMITIVE" or "CAMERA"), this function trims whitespace and calls the
-** matching parser. Each parser then reads subsequent indented lines until
+** matching parser, indexed by PARSE_*, adding the time it takes to that
+** kind of block. Each parser then reads subsequent indented lines until
 ** it hits a blank line (block terminator).
-**
-** Note: PRIMITIVE uses 'if' (not 'else if') followed by OBJECT also using
-** 'if' -- this is a minor style inconsistency from the original code but
-** does not cause bugs because a line cannot match both "PRIMITIVE" and
-** "OBJECT".
 */
-static void	call_type(t_env *e, FILE *stream, char **line)
+static void	call_type(t_env *e, t_scene *s, t_token line)
 {
-	char	*temp_line;
+	static const char	*header[PARSE_BLOCKS] = {"CAMERA", "LIGHT",
+		"MATERIAL", "PRIMITIVE", "OBJECT"};
+	static void			(*parse[PARSE_BLOCKS])(t_env *, t_scene *) = {
+		get_camera_attributes, get_light_attributes, get_material_attributes,
+		get_primitive_attributes, get_object_attributes};
+	double				start;
+	int					i;
 
-	temp_line = strtrim(*line);
-	if (!strcmp(temp_line, "PRIMITIVE"))
-		get_primitive_attributes(e, stream);
-	if (!strcmp(temp_line, "OBJECT"))
-		get_object_attributes(e, stream);
-	else if (!strcmp(temp_line, "CAMERA"))
-		get_camera_attributes(e, stream);
-	else if (!strcmp(temp_line, "LIGHT"))
-		get_light_attributes(e, stream);
-	else if (!strcmp(temp_line, "MATERIAL"))
-		get_material_attributes(e, stream);
-	free(temp_line);
+	line = tok_trim(line);
+	i = -1;
+	while (++i < PARSE_BLOCKS)
+		if (tok_is(line, header[i]))
+		{
+			start = clock_ms();
+			parse[i](e, s);
+			e->parse.block_ms[i] += clock_ms() - start;
+			return ;
+		}
 }
 
 /*
-** get_quantities -- Pass 1: Count scene elements for pre-allocation.
-**
-** Reads every line of the file, looking for block header keywords
-** (LIGHT, MATERIAL, PRIMITIVE, OBJECT). Each match increments the
-** corresponding counter in the environment struct.
-**
-** After counting, allocates pointer arrays for each element type.
-** Note: e->materials is incremented by 1 before allocation to make
-** room for the DEFAULT material at index 0.
-**
-** Also validates that no line ends with a trailing tab (a common
-** copy-paste error in scene files).
+** parse_report -- Print where read_scene spent its time. OBJECT includes
+** the OBJ files, which are also given on their own.
 */
-static void	get_quantities(t_env *e, FILE *stream)
+static void	parse_report(t_env *e)
 {
-	char	*line = NULL;
-	size_t	len = 0;
-	size_t	num;
+	t_parse_times	*p;
 
-	num = 1;
-	while (getline(&line, &len, stream) != -1 && ++num)
-	{
-		line[strcspn(line, "\n")] = '\0';
-		if (line[strlen(line) - 1] == '\t')
-			err(FILE_FORMAT_ERROR, "Line ends in a tab", e);
-		char *trimmed_line = strtrim(line);
-		(!strcmp(trimmed_line, "LIGHT")) ? ++e->lights : 0;
-		(!strcmp(trimmed_line, "MATERIAL")) ? ++e->materials : 0;
-		(!strcmp(trimmed_line, "PRIMITIVE")) ? ++e->prims : 0;
-		(!strcmp(trimmed_line, "OBJECT")) ? ++e->objects : 0;
-		free(trimmed_line);
-	}
-	free(line);
-	printf("%d:\tLIGHTS\n%d:\tMATERIALS\n%d:\tPRIMITIVES\n%d:\tOBJECTS\n",
-		(int)e->lights, (int)e->materials, (int)e->prims, (int)e->objects);
-	e->light = (t_light **)malloc(sizeof(t_light *) * e->lights);
-	e->material = (t_material **)malloc(sizeof(t_material *) * ++e->materials);
-	e->prim = (t_prim **)malloc(sizeof(t_prim *) * e->prims);
-	e->object = (t_object **)malloc(sizeof(t_object *) * e->objects);
+	p = &e->parse;
+	printf("Parsed in %.1f ms: map %.1f, globals %.1f, camera %.1f, "
+		"light %.1f, material %.1f, primitive %.1f, object %.1f "
+		"(OBJ files %.1f)\n", p->total_ms, p->map_ms, p->globals_ms,
+		p->block_ms[PARSE_CAMERA], p->block_ms[PARSE_LIGHT],
+		p->block_ms[PARSE_MATERIAL], p->block_ms[PARSE_PRIMITIVE],
+		p->block_ms[PARSE_OBJECT], p->obj_ms);
 }
 
 /*
-** init_read_scene -- Initialize parsing state and create the DEFAULT material.
-**
-** After pass 1 (get_quantities) has allocated the arrays, this function:
-**   1. Rewinds the file stream to the beginning for pass 2.
-**   2. Resets all element counters to 0 (they were used for counting in pass 1
-**      and will now be used as insertion indices during pass 2).
-**   3. Creates the DEFAULT material at index 0 with a hot-pink diffuse color
-**      (RGB ~(255, 0, 222)). This serves as a "missing texture" indicator --
-**      any object referencing an undefined material name falls back to index 0,
-**      making the error visually obvious in the render.
+** scene_slot -- Make room for element n of a (an array of pointers with
+** room for *cap), doubling it when it is full. The new slots are NULL, so
+** a reload that fails mid-block can tell whether the block's element was
+** allocated. Returns the array, which may have moved.
+*/
+void		*scene_slot(t_env *e, void *a, size_t n, size_t *cap)
+{
+	size_t	old;
+
+	if (n < *cap)
+		return (a);
+	old = *cap;
+	*cap = (*cap) ? 2 * *cap : SCENE_GROW;
+	if (!(a = realloc(a, sizeof(void *) * *cap)))
+		err(MALLOC_ERROR, "scene_slot", e);
+	memset((void **)a + old, 0, sizeof(void *) * (*cap - old));
+	return (a);
+}
+
+/*
+** init_read_scene -- Create the DEFAULT material at index 0 with a
+** hot-pink diffuse color (RGB ~(255, 0, 222)). This serves as a "missing
+** texture" indicator -- any object referencing an undefined material name
+** falls back to index 0, making the error visually obvious in the render.
 */
-static void	init_read_scene(t_env *e, FILE *stream)
+static void	init_read_scene(t_env *e, t_scene *s)
 {
-	get_quantities(e, stream);
-	fseek(stream, 0, SEEK_SET);
-	e->lights = 0;
-	e->materials = 0;
-	e->prims = 0;
-	e->objects = 0;
+	e->material = scene_slot(e, e->material, 0, &s->materials_cap);
 	e->material[0] = (t_material *)malloc(sizeof(t_material));
 	init_material(e->material[0]);
 	free(e->material[0]->name);
 	e->material[0]->name = NULL;
 	e->material[e->materials]->name = strdup("DEFAULT");
+	mat_index_add(e, e->materials);
 	++e->materials;
 }
 
 /*
 ** read_scene -- Main entry point for loading a scene file.
 **
-** Opens the file, validates the "# SCENE RT" magic header, runs
-** initialization (two-pass counting + default material), then parses
-** the file in two phases:
+** The file is read through e->scene, which a failed reload unmaps (see
+** reload_scene.c).
+**
+** Maps the file, validates the "# SCENE RT" magic header, creates the
+** default material, then parses the file in two phases:
 **   Phase 1: Read global attributes (MAXDEPTH, RENDER, SUPER) until
 **            the first blank line.
 **   Phase 2: Read type-specific blocks (CAMERA, LIGHT, MATERIAL,
 **            PRIMITIVE, OBJECT) until EOF. Each block is separated
 **            by blank lines.
+** Then reports how many of each block it read, how long each phase took,
+** and the memory taken by the meshes the OBJECTs loaded.
 **
 ** Parameters:
 **   file - Path to the scene description file.
@@ -191,33 +185,31 @@ static void	init_read_scene(t_env *e, FILE *stream)
 */
 void		read_scene(char *file, t_env *e)
 {
-	char			*line = NULL;
-	size_t			len = 0;
-	FILE			*stream;
+	t_scene	*s;
+	t_token	line;
+	double	start;
+	double	mark;
 
-	stream = fopen(file, "r");
-	if (stream == NULL)
-		err(FILE_OPEN_ERROR, "Scene file", e);
-	if (getline(&line, &len, stream) == -1)
-		err(FILE_FORMAT_ERROR, "Scene file must start with '# SCENE RT'", e);
-	line[strcspn(line, "\n")] = '\0';
-	if (strcmp(line, "# SCENE RT"))
+	start = clock_ms();
+	s = &e->scene;
+	scene_open(e, s, file);
+	if (!scene_line(e, s, &line) || !tok_is(line, "# SCENE RT"))
 		err(FILE_FORMAT_ERROR, "Scene file must start with '# SCENE RT'", e);
-	init_read_scene(e, stream);
+	init_read_scene(e, s);
+	e->parse.map_ms = clock_ms() - start;
+	mark = clock_ms();
 	/* Phase 1: Global scene attributes, terminated by blank line */
-	while (getline(&line, &len, stream) != -1)
-	{
-		line[strcspn(line, "\n")] = '\0';
-		if (line[0] == '\0')
-			break ;
+	while (scene_line(e, s, &line) && line.len)
 		scene_attributes(e, line);
-	}
+	e->parse.globals_ms = clock_ms() - mark;
 	/* Phase 2: Type-specific blocks until EOF */
-	while (getline(&line, &len, stream) != -1)
-	{
-		line[strcspn(line, "\n")] = '\0';
-		call_type(e, stream, &line);
-	}
-	free(line);
-	fclose(stream);
+	while (scene_line(e, s, &line))
+		call_type(e, s, line);
+	scene_close(s);
+	e->parse.total_ms = clock_ms() - start;
+	printf("%d:\tLIGHTS\n%d:\tMATERIALS\n%d:\tPRIMITIVES\n%d:\tOBJECTS\n",
+		(int)e->lights, (int)e->materials - 1, (int)e->prims,
+		(int)e->objects);
+	parse_report(e);
+	mesh_report(e);
 }
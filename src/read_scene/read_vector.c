@@ -27,18 +27,18 @@
 **
 ** Parameters:
 **   e      - Environment (used only for error reporting).
-**   values - Split string with exactly 3 words: x, y, z components.
+**   values - Value split into words, exactly 3: x, y, z components.
 **
 ** Returns the raw (unnormalized) vector.
 */
-t_vector	get_vector(t_env *e, t_split_string values)
+t_vector	get_vector(t_env *e, t_words values)
 {
 	if (values.words != 3)
 		err(FILE_FORMAT_ERROR, "Invalid vector format", e);
 	return ((t_vector){
-		atof(values.strings[0]),
-		atof(values.strings[1]),
-		atof(values.strings[2])});
+		tok_double(values.word[0]),
+		tok_double(values.word[1]),
+		tok_double(values.word[2])});
 }
 
 /*
@@ -48,12 +48,12 @@ t_vector	get_vector(t_env *e, t_split_string values)
 ** This guarantees |result| = 1.0, which is required by intersection
 ** algorithms that rely on dot products for geometric calculations.
 */
-t_vector	get_unit_vector(t_env *e, t_split_string values)
+t_vector	get_unit_vector(t_env *e, t_words values)
 {
 	if (values.words != 3)
 		err(FILE_FORMAT_ERROR, "Invalid vector format", e);
 	return (vunit((t_vector){
-		atof(values.strings[0]),
-		atof(values.strings[1]),
-		atof(values.strings[2])}));
+		tok_double(values.word[0]),
+		tok_double(values.word[1]),
+		tok_double(values.word[2])}));
 }
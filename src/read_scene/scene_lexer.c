@@ -0,0 +1,181 @@
+/*
+** scene_lexer.c -- Allocation-free tokenizer over the mapped scene file.
+**
+** The scene file is mapped read-only once and read in a single pass.
+** Lines, keys, values and words are handed out as t_tokens: pointers into
+** the mapping with a length, never copied. A line is split on tabs into
+** its key and value, and a value on spaces into words; runs of either
+** delimiter count as one, as nstrsplit does. Only what outlives the file
+** is copied out: material names (tok_dup), and OBJ paths.
+**
+** Numbers are converted with atof/atoi on a NUL-terminated copy of the
+** token in a small stack buffer, so they parse exactly as before.
+*/
+
+#include "rt.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+** scene_open -- Map file for reading. An empty file cannot start with the
+** header, so it is a format error.
+*/
+void		scene_open(t_env *e, t_scene *s, char *file)
+{
+	struct stat	st;
+	void		*map;
+	int			fd;
+
+	memset(s, 0, sizeof(t_scene));
+	if ((fd = open(file, O_RDONLY)) == -1 || fstat(fd, &st) == -1)
+		err(FILE_OPEN_ERROR, "Scene file", e);
+	if (st.st_size == 0)
+		err(FILE_FORMAT_ERROR, "Scene file must start with '# SCENE RT'", e);
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		err(FILE_OPEN_ERROR, "Scene file", e);
+	s->buf = (const char *)map;
+	s->size = st.st_size;
+}
+
+/* scene_close -- Unmap the scene file; its tokens are invalid after. */
+void		scene_close(t_scene *s)
+{
+	if (s->buf)
+		munmap((void *)s->buf, s->size);
+	s->buf = NULL;
+}
+
+/*
+** scene_line -- The next line, without its newline. Returns 0 at the end
+** of the file. A line ending in a tab is a format error (a common
+** copy-paste slip).
+*/
+int			scene_line(t_env *e, t_scene *s, t_token *line)
+{
+	const char	*nl;
+
+	if (s->pos >= s->size)
+		return (0);
+	line->s = s->buf + s->pos;
+	if ((nl = memchr(line->s, '\n', s->size - s->pos)))
+		line->len = nl - line->s;
+	else
+		line->len = s->size - s->pos;
+	s->pos += line->len + 1;
+	if (line->len && line->s[line->len - 1] == '\t')
+		err(FILE_FORMAT_ERROR, "Line ends in a tab", e);
+	return (1);
+}
+
+/*
+** split -- Split t on c into at most max tokens in out. Returns how many
+** there were in all.
+*/
+static size_t	split(t_token t, char c, t_token *out, size_t max)
+{
+	size_t	i;
+	size_t	start;
+	size_t	n;
+
+	n = 0;
+	i = 0;
+	while (i < t.len)
+	{
+		while (i < t.len && t.s[i] == c)
+			++i;
+		if (i == t.len)
+			break ;
+		start = i;
+		while (i < t.len && t.s[i] != c)
+			++i;
+		if (n < max)
+			out[n] = (t_token){t.s + start, i - start};
+		++n;
+	}
+	return (n);
+}
+
+/*
+** scene_attr -- Split an attribute line on tabs into its key and value
+** (empty tokens if missing). Returns the number of tab-separated fields.
+*/
+size_t		scene_attr(t_token line, t_token *key, t_token *value)
+{
+	t_token	field[2];
+	size_t	n;
+
+	field[0] = (t_token){line.s, 0};
+	field[1] = (t_token){line.s, 0};
+	n = split(line, '\t', field, 2);
+	*key = field[0];
+	*value = field[1];
+	return (n);
+}
+
+/* scene_words -- Split a value on spaces. */
+t_words		scene_words(t_token value)
+{
+	t_words	w;
+
+	memset(&w, 0, sizeof(t_words));
+	w.words = split(value, ' ', w.word, SCENE_WORDS);
+	return (w);
+}
+
+/* tok_trim -- t without leading and trailing spaces, tabs and newlines. */
+t_token		tok_trim(t_token t)
+{
+	while (t.len && (t.s[0] == ' ' || t.s[0] == '\t' || t.s[0] == '\n'))
+	{
+		++t.s;
+		--t.len;
+	}
+	while (t.len && (t.s[t.len - 1] == ' ' || t.s[t.len - 1] == '\t' ||
+		t.s[t.len - 1] == '\n'))
+		--t.len;
+	return (t);
+}
+
+/* tok_is -- Whether t is exactly the string str. */
+int			tok_is(t_token t, const char *str)
+{
+	return (strlen(str) == t.len && !memcmp(t.s, str, t.len));
+}
+
+/*
+** tok_double, tok_int -- atof and atoi of t. A token too long for the
+** buffer cannot be a sensible number; its first 63 characters are used.
+*/
+double		tok_double(t_token t)
+{
+	char	buf[64];
+
+	t.len = MIN(t.len, sizeof(buf) - 1);
+	memcpy(buf, t.s, t.len);
+	buf[t.len] = '\0';
+	return (atof(buf));
+}
+
+int			tok_int(t_token t)
+{
+	char	buf[64];
+
+	t.len = MIN(t.len, sizeof(buf) - 1);
+	memcpy(buf, t.s, t.len);
+	buf[t.len] = '\0';
+	return (atoi(buf));
+}
+
+/* tok_dup -- t as a new NUL-terminated string. */
+char		*tok_dup(t_env *e, t_token t)
+{
+	char	*str;
+
+	if (!(str = (char *)malloc(t.len + 1)))
+		err(MALLOC_ERROR, "tok_dup", e);
+	memcpy(str, t.s, t.len);
+	str[t.len] = '\0';
+	return (str);
+}
@@ -77,9 +77,11 @@ t_colour	reflect(t_env *e, int depth)
 
 	++g_tls_stats.rays;
 	++g_tls_stats.reflection_rays;
+	++g_tls_stats.depth[MIN(depth, STATS_DEPTH_BINS - 1)];
 	colour = (t_colour){0.0, 0.0, 0.0, 0.0};
 	refl = *e;
 	refl.p_hit = NULL;
+	refl.vis = NULL;
 	set_reflect_ray(e, &refl);
 	intersect_scene(&refl);
 	colour = find_colour_struct(&refl, depth + 1);
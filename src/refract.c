@@ -215,8 +215,10 @@ t_colour	refract(t_env *e, int depth, t_colour colour)
 	++g_tls_stats.refraction_rays;
 	if (depth > e->maxdepth)
 		return (colour);
+	++g_tls_stats.depth[MIN(depth, STATS_DEPTH_BINS - 1)];
 	refract_env = *e;
 	refract_env.p_hit = NULL;
+	refract_env.vis = NULL;
 	if (e->hit_type == FACE)
 	{
 		set_refract_ray_object(e, &refract_env);
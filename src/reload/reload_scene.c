@@ -0,0 +1,180 @@
+/*
+** reload_scene.c -- Re-read the scene file into the running renderer
+** (--watch).
+**
+** Restarting RT to see an edit re-creates the window, re-reads every OBJ
+** file and rebuilds every BVH. A reload instead parses the file into a
+** scratch t_env and merges it into the live one (scene_diff.c), keeping
+** whatever did not change:
+**
+**   - meshes whose OBJ file is unchanged (same size and modification
+**     time) are taken over with their BVHs, and not read again
+**   - primitives edited in place keep their batches, which are refit
+**   - lights, materials and the camera are swapped in without touching
+**     any acceleration structure
+**
+** and the frame is redrawn only if something changed. When only lights or
+** materials did, no primary hit moved: the frame is reshaded from the
+** G-buffer (src/gbuffer.c) rather than traced.
+**
+** A scene file caught half-written, or with a mistake in it, must not take
+** the renderer down: while it is parsed, err() jumps back here instead of
+** exiting (e->on_error). The error is reported, whatever the parse had
+** allocated is freed, and the live scene is left as it was.
+**
+** The window keeps its size: a new RENDER resolution is reported and
+** takes effect on the next start.
+**
+** Parsing runs alongside the frame being drawn; only the merge pauses the
+** render thread.
+*/
+
+#include "rt.h"
+#include <sys/stat.h>
+
+/*
+** reuse_mesh -- The live scene's mesh for file, taken out of e->spare, if
+** the file is unchanged since the mesh was loaded. NULL otherwise.
+*/
+t_mesh			*reuse_mesh(t_env *e, const char *file)
+{
+	struct stat	st;
+	t_mesh		*m;
+	size_t		i;
+
+	i = -1;
+	while (++i < e->spares)
+		if (e->spare[i] && !strcmp(e->spare[i]->file, file))
+		{
+			m = e->spare[i];
+			if (stat(file, &st) == -1 || st.st_size != m->bytes ||
+				st.st_mtim.tv_sec != m->mtime.tv_sec ||
+				st.st_mtim.tv_nsec != m->mtime.tv_nsec)
+				return (NULL);
+			e->spare[i] = NULL;
+			return (m);
+		}
+	return (NULL);
+}
+
+/*
+** reload_env -- A fresh environment to parse the scene into, with the
+** live meshes on offer for reuse.
+*/
+static t_env	*reload_env(t_env *e)
+{
+	t_env	*n;
+
+	if (!(n = (t_env *)malloc(sizeof(t_env))))
+		err(MALLOC_ERROR, "reload_scene", e);
+	nullify_pointers(n);
+	n->opt = e->opt;
+	n->file_name = e->file_name;
+	if (e->meshes && !(n->spare = (t_mesh **)malloc(sizeof(t_mesh *) *
+		e->meshes)))
+		err(MALLOC_ERROR, "reload_scene", e);
+	if (e->meshes)
+		memcpy(n->spare, e->mesh, sizeof(t_mesh *) * e->meshes);
+	n->spares = e->meshes;
+	return (n);
+}
+
+/*
+** held -- How many elements of the parsed array a (n counted, room for
+** cap) to free: the element of a block cut short is allocated but not yet
+** counted. Unused slots are NULL (scene_slot).
+*/
+static size_t	held(void *a, size_t n, size_t cap)
+{
+	return ((a && n < cap && ((void **)a)[n]) ? n + 1 : n);
+}
+
+/*
+** discard_env -- Free whatever n still holds: all of a failed reload, or
+** what a successful one did not merge into e. Meshes that belong to e are
+** left alone.
+*/
+static void		discard_env(t_env *e, t_env *n)
+{
+	t_scene	*s;
+	size_t	i;
+	size_t	j;
+
+	s = &n->scene;
+	scene_close(s);
+	i = -1;
+	while (++i < n->meshes)
+	{
+		j = -1;
+		while (++j < e->meshes)
+			if (n->mesh[i] == e->mesh[j])
+				n->mesh[i] = NULL;
+	}
+	free_mesh(n->mesh, n->meshes);
+	free_light(n->light, held(n->light, n->lights, s->lights_cap));
+	free_material(n->material, held(n->material, n->materials,
+		s->materials_cap));
+	free_mat_index(n);
+	free_prim(&n->prim, held(n->prim, n->prims, s->prims_cap));
+	free_object(n->object, held(n->object, n->objects, s->objects_cap));
+	free(n->spare);
+	free(n);
+}
+
+/* reload_report -- Print what the reload changed and how long it took. */
+static void		reload_report(t_env *e, int changed, double ms)
+{
+	static const char	*kind[RELOAD_KINDS] = {"settings", "camera",
+		"lights", "materials", "primitives", "primitive set", "objects"};
+	int					i;
+	int					first;
+
+	printf("Reloaded in %.1f ms (parsing %.1f ms): ", ms, e->parse.total_ms);
+	if (!changed)
+		fputs("no changes", stdout);
+	first = 1;
+	i = -1;
+	while (++i < RELOAD_KINDS)
+		if (changed & (1 << i))
+		{
+			printf("%s%s", first ? "" : ", ", kind[i]);
+			first = 0;
+		}
+	puts(changed ? " changed" : "");
+}
+
+/*
+** reload_scene -- Parse the scene file again and merge it into e, then
+** ask for a frame if anything changed. On a parse error the live scene is
+** kept.
+*/
+void			reload_scene(t_env *e)
+{
+	jmp_buf	jump;
+	t_env	*n;
+	double	start;
+	int		changed;
+
+	start = clock_ms();
+	printf("Reloading %s\n", e->file_name);
+	n = reload_env(e);
+	n->on_error = &jump;
+	if (setjmp(jump))
+	{
+		discard_env(e, n);
+		puts("Reload failed, keeping the current scene");
+		return ;
+	}
+	read_scene(n->file_name, n);
+	apply_options(n);
+	n->on_error = NULL;
+	render_pause(e);
+	changed = merge_scene(e, n);
+	render_resume(e);
+	discard_env(e, n);
+	reload_report(e, changed, clock_ms() - start);
+	if (changed & ~(RELOAD_LIGHTS | RELOAD_MATERIALS))
+		schedule_draw(e);
+	else if (changed)
+		schedule_reshade(e);
+}
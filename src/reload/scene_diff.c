@@ -0,0 +1,281 @@
+/*
+** scene_diff.c -- Merge a freshly parsed scene into the live one.
+**
+** Each part of the scene is compared with its live counterpart, field by
+** field as the scene file sets them, and only what differs is replaced:
+**
+**   settings   MAXDEPTH and SUPER are copied
+**   camera     LOC, DIR, UP and the aperture are copied
+**   lights     the array is swapped in whole; the shadows kept for
+**              reshading are forgotten for the lights that moved
+**   materials  the array and its name index are swapped in whole; a change
+**              of transparency forgets all the shadows kept
+**   primitives the same count of the same types: changed ones are copied
+**              in place and the batches refit before the next frame
+**              (update_prim_batches); anything else swaps the array in
+**              and rebuilds the batches
+**   objects    the array is swapped in whole
+**   meshes     the parsed scene's list replaces the live one; live meshes
+**              it did not take over (reuse_mesh) are freed, and new ones
+**              start building their BVHs
+**
+** Whatever is not swapped in stays in n for discard_env to free.
+*/
+
+#include "rt.h"
+
+static int	veq(t_vector a, t_vector b)
+{
+	return (a.x == b.x && a.y == b.y && a.z == b.z);
+}
+
+static int	ceq(t_colour a, t_colour b)
+{
+	return (a.r == b.r && a.g == b.g && a.b == b.b &&
+		a.intensity == b.intensity);
+}
+
+/*
+** same_parts -- Whether the arrays a and b of n parts each are equal part
+** by part under eq.
+*/
+static int	same_parts(void **a, void **b, size_t n, int (*eq)(void *,
+		void *))
+{
+	size_t	i;
+
+	i = -1;
+	while (++i < n)
+		if (!eq(a[i], b[i]))
+			return (0);
+	return (1);
+}
+
+static int	light_eq(void *a, void *b)
+{
+	t_light	*p;
+	t_light	*q;
+
+	p = (t_light *)a;
+	q = (t_light *)b;
+	return (veq(p->loc, q->loc) && ceq(p->colour, q->colour) &&
+		p->lm == q->lm && p->half == q->half);
+}
+
+static int	material_eq(void *a, void *b)
+{
+	t_material	*p;
+	t_material	*q;
+
+	p = (t_material *)a;
+	q = (t_material *)b;
+	return (!strcmp(p->name, q->name) && p->reflect == q->reflect &&
+		p->refract == q->refract && p->ior == q->ior &&
+		ceq(p->diff, q->diff) && ceq(p->spec, q->spec));
+}
+
+static int	prim_eq(void *a, void *b)
+{
+	t_prim	*p;
+	t_prim	*q;
+
+	p = (t_prim *)a;
+	q = (t_prim *)b;
+	return (veq(p->loc, q->loc) && veq(p->dir, q->dir) &&
+		veq(p->normal, q->normal) && p->type == q->type &&
+		p->material == q->material && p->radius == q->radius &&
+		p->angle == q->angle && p->limit == q->limit);
+}
+
+static int	object_eq(void *a, void *b)
+{
+	t_object	*p;
+	t_object	*q;
+
+	p = (t_object *)a;
+	q = (t_object *)b;
+	return (!strcmp(p->name, q->name) && p->mesh == q->mesh &&
+		p->material == q->material && veq(p->loc, q->loc) &&
+		veq(p->rot, q->rot) && veq(p->scale, q->scale));
+}
+
+/*
+** merge_view -- The render settings and the camera. The window cannot
+** change size, so a new RENDER resolution is only reported.
+*/
+static int	merge_view(t_env *e, t_env *n)
+{
+	int		changed;
+
+	changed = 0;
+	if (n->x != e->x || n->y != e->y)
+		printf("RENDER %zu %zu takes effect when RT is restarted\n",
+			n->x, n->y);
+	if (n->maxdepth != e->maxdepth || n->super != e->super)
+	{
+		e->maxdepth = n->maxdepth;
+		e->super = n->super;
+		changed |= RELOAD_SETTINGS;
+	}
+	if (!veq(n->camera.loc, e->camera.loc) ||
+		!veq(n->camera.dir, e->camera.dir) ||
+		!veq(n->camera.up, e->camera.up) || n->camera.a != e->camera.a)
+	{
+		e->camera = n->camera;
+		changed |= RELOAD_CAMERA;
+	}
+	return (changed);
+}
+
+/*
+** forget_shadows -- Forget the shadows kept for reshading (src/gbuffer.c)
+** that n's lights and materials make stale: those of the lights that
+** moved, or all of them when lights come or go or a transparency changes.
+*/
+static void	forget_shadows(t_env *e, t_env *n)
+{
+	size_t	i;
+
+	i = -1;
+	while (n->materials == e->materials && ++i < n->materials)
+		if (n->material[i]->refract != e->material[i]->refract)
+			break ;
+	if (n->lights != e->lights || n->materials != e->materials ||
+		i < n->materials)
+	{
+		gbuf_forget_shadows(e);
+		return ;
+	}
+	i = -1;
+	while (++i < n->lights)
+		if (!veq(n->light[i]->loc, e->light[i]->loc))
+			gbuf_forget_light(e, i);
+}
+
+/* merge_shading -- The lights and the materials. */
+static int	merge_shading(t_env *e, t_env *n)
+{
+	int		changed;
+
+	changed = 0;
+	forget_shadows(e, n);
+	if (n->lights != e->lights || !same_parts((void **)e->light,
+		(void **)n->light, n->lights, light_eq))
+	{
+		free_light(e->light, e->lights);
+		e->light = n->light;
+		e->lights = n->lights;
+		n->light = NULL;
+		n->lights = 0;
+		changed |= RELOAD_LIGHTS;
+	}
+	if (n->materials != e->materials || !same_parts((void **)e->material,
+		(void **)n->material, n->materials, material_eq))
+	{
+		free_material(e->material, e->materials);
+		free_mat_index(e);
+		e->material = n->material;
+		e->materials = n->materials;
+		e->mat_index = n->mat_index;
+		n->material = NULL;
+		n->materials = 0;
+		n->mat_index = (t_mat_index){NULL, 0, 0};
+		changed |= RELOAD_MATERIALS;
+	}
+	return (changed);
+}
+
+/*
+** merge_prims -- The primitives. Edits that keep every primitive's type
+** are made in place, keeping the selection; otherwise the new primitives
+** replace the old, the batches are rebuilt and the selection is cleared.
+*/
+static int	merge_prims(t_env *e, t_env *n)
+{
+	size_t	i;
+	int		s_bool;
+	int		changed;
+
+	i = -1;
+	while (n->prims == e->prims && ++i < n->prims)
+		if (n->prim[i]->type != e->prim[i]->type)
+			break ;
+	if (n->prims == e->prims && i == n->prims)
+	{
+		changed = 0;
+		while (i--)
+			if (!prim_eq(e->prim[i], n->prim[i]))
+			{
+				s_bool = e->prim[i]->s_bool;
+				*e->prim[i] = *n->prim[i];
+				e->prim[i]->s_bool = s_bool;
+				e->prim[i]->loc_bak = e->prim[i]->loc;
+				changed = RELOAD_PRIMS;
+			}
+		return (changed);
+	}
+	free_prim_batches(e);
+	free_prim(&e->prim, e->prims);
+	e->prim = n->prim;
+	e->prims = n->prims;
+	n->prim = NULL;
+	n->prims = 0;
+	e->s_num = 0;
+	if (e->flags & KEY_G)
+		reset_keys(e);
+	build_prim_batches(e);
+	return (RELOAD_PRIM_SET);
+}
+
+/*
+** merge_objects -- The mesh instances, then the meshes: n's list of meshes
+** (the ones it took over and the ones it loaded) becomes the live list.
+** A live mesh no longer used is freed once its builder, if any, is done.
+*/
+static int	merge_objects(t_env *e, t_env *n)
+{
+	int		changed;
+	size_t	i;
+
+	changed = 0;
+	if (n->objects != e->objects || !same_parts((void **)e->object,
+		(void **)n->object, n->objects, object_eq))
+	{
+		free_object(e->object, e->objects);
+		e->object = n->object;
+		e->objects = n->objects;
+		n->object = NULL;
+		n->objects = 0;
+		changed = RELOAD_OBJECTS;
+	}
+	i = -1;
+	while (++i < n->spares)
+		if (n->spare[i] && n->spare[i]->building)
+			pthread_join(n->spare[i]->builder, NULL);
+	free_mesh(n->spare, n->spares);
+	n->spare = NULL;
+	n->spares = 0;
+	free(e->mesh);
+	e->mesh = n->mesh;
+	e->meshes = n->meshes;
+	n->mesh = NULL;
+	n->meshes = 0;
+	start_bvh_builds(e);
+	return (changed);
+}
+
+/*
+** merge_scene -- Merge the scene parsed into n into e. Returns the
+** RELOAD_* bits of what changed.
+*/
+int			merge_scene(t_env *e, t_env *n)
+{
+	int		changed;
+
+	changed = merge_view(e, n);
+	changed |= merge_shading(e, n);
+	changed |= merge_prims(e, n);
+	changed |= merge_objects(e, n);
+	e->parse = n->parse;
+	return (changed);
+}
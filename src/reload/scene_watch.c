@@ -0,0 +1,93 @@
+/*
+** scene_watch.c -- Watch the scene file for changes (--watch).
+**
+** The directory holding the scene file is watched with inotify, for files
+** closed after writing and files renamed into it: an editor either writes
+** the scene in place or writes a new file and renames it over the old
+** one. Events for other files in the directory are ignored.
+**
+** The event loop polls the (non-blocking) descriptor between frames, so a
+** reload never races a render. Several events in one poll, as a save can
+** produce, make a single reload.
+*/
+
+#include "rt.h"
+#include <libgen.h>
+#include <sys/inotify.h>
+
+/*
+** watch_scene -- Start watching e->file_name. Failing to watch is not
+** fatal: the scene just is not reloaded.
+*/
+void		watch_scene(t_env *e)
+{
+	char	*dir;
+	char	*base;
+
+	dir = strdup(e->file_name);
+	base = strdup(e->file_name);
+	if (!dir || !base)
+		err(MALLOC_ERROR, "watch_scene", e);
+	e->watch.dir = strdup(dirname(dir));
+	e->watch.base = strdup(basename(base));
+	free(dir);
+	free(base);
+	if (!e->watch.dir || !e->watch.base)
+		err(MALLOC_ERROR, "watch_scene", e);
+	if ((e->watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1 ||
+		inotify_add_watch(e->watch.fd, e->watch.dir,
+		IN_CLOSE_WRITE | IN_MOVED_TO) == -1)
+	{
+		perror("watch_scene: inotify");
+		watch_close(e);
+		return ;
+	}
+	printf("Watching %s for changes\n", e->file_name);
+}
+
+/*
+** watch_changed -- Drain the pending events. Returns 1 if any of them was
+** for the scene file.
+*/
+static int	watch_changed(t_env *e)
+{
+	char					buf[4096]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event	*ev;
+	ssize_t					len;
+	ssize_t					i;
+	int						changed;
+
+	changed = 0;
+	while ((len = read(e->watch.fd, buf, sizeof(buf))) > 0)
+	{
+		i = 0;
+		while (i < len)
+		{
+			ev = (const struct inotify_event *)(buf + i);
+			if (ev->len && !strcmp(ev->name, e->watch.base))
+				changed = 1;
+			i += sizeof(struct inotify_event) + ev->len;
+		}
+	}
+	return (changed);
+}
+
+/* watch_poll -- Reload the scene if its file changed since the last poll. */
+void		watch_poll(t_env *e)
+{
+	if (e->watch.fd != -1 && watch_changed(e))
+		reload_scene(e);
+}
+
+/* watch_close -- Stop watching. */
+void		watch_close(t_env *e)
+{
+	if (e->watch.fd != -1)
+		close(e->watch.fd);
+	e->watch.fd = -1;
+	free(e->watch.dir);
+	free(e->watch.base);
+	e->watch.dir = NULL;
+	e->watch.base = NULL;
+}
@@ -0,0 +1,314 @@
+/*
+** render_thread.c -- Drawing frames off the event loop.
+**
+** A frame drawn inside an event handler freezes the window for as long as
+** it takes: no input is read and nothing is shown but the blits between
+** tiles. With a window, frames are drawn by a render thread instead:
+**
+**   - draw() asks for a frame (render_request): a snapshot of the
+**     environment is handed over and any frame in flight is cancelled.
+**     Requests made while a frame is drawn replace one another, so only
+**     the latest is drawn next.
+**   - The thread draws the snapshot (draw_frame) and, as tiles finish,
+**     copies them to a front surface (render_publish) instead of touching
+**     the window. A finished tile is no longer written, so the copy never
+**     reads pixels still being drawn.
+**   - The event loop keeps polling at 60 Hz and shows the front surface
+**     whenever it has changed (render_present), so partial frames appear
+**     without the loop ever waiting for one. Only the regions that
+**     changed are copied to the window and updated, at most once per
+**     iteration however many tiles finished.
+**
+** The snapshot copies the camera, the flags and the settings, which the
+** event loop may change at any time. The scene itself is shared: an event
+** handler that edits it (primitives, the selection, a reload) first
+** pauses the thread (render_pause), which cancels the frame in flight and
+** waits for it to wind down, and resumes it after (render_resume). The
+** cancelled frame is asked for again, so an edit that asks for none (a
+** reload that changed nothing) does not leave it unfinished. A request
+** still waiting then is drawn with the scene as edited, never the one its
+** snapshot saw. The primitive batches, heatmap, G-buffer and
+** denoiser buffers belong to the thread while it draws, and are handed
+** back to e between frames.
+*/
+
+#include "rt.h"
+
+/*
+** next_frame -- The snapshot to draw next, with the live scene, batches
+** and buffers: an edit made while the request waited (a reload merged
+** while paused) may have freed and replaced what the snapshot points to.
+** Called with the lock held.
+*/
+static void		next_frame(t_render *r, t_env *frame, SDL_Rect *d)
+{
+	*frame = *r->next;
+	frame->prim = r->e->prim;
+	frame->prims = r->e->prims;
+	frame->s_num = r->e->s_num;
+	frame->object = r->e->object;
+	frame->objects = r->e->objects;
+	frame->mesh = r->e->mesh;
+	frame->meshes = r->e->meshes;
+	frame->light = r->e->light;
+	frame->lights = r->e->lights;
+	frame->material = r->e->material;
+	frame->materials = r->e->materials;
+	frame->mat_index = r->e->mat_index;
+	frame->batch = r->e->batch;
+	frame->heat = r->e->heat;
+	frame->gbuf = r->e->gbuf;
+	frame->denoise = r->e->denoise;
+	*d = r->d;
+	r->pending = 0;
+	r->busy = 1;
+}
+
+/*
+** render_main -- The render thread: draw each frame asked for until told
+** to quit. Whether the last frame was cancelled is carried from one to the
+** next, for draw_frame's dimming.
+*/
+static void		*render_main(void *q)
+{
+	t_render	*r;
+	t_env		frame;
+	SDL_Rect	d;
+	int			cancelled;
+
+	r = (t_render *)q;
+	cancelled = 0;
+	trace_set_main();
+	pthread_mutex_lock(&r->lock);
+	while (!r->quit)
+	{
+		if (!r->pending || r->paused)
+		{
+			pthread_cond_wait(&r->cond, &r->lock);
+			continue ;
+		}
+		next_frame(r, &frame, &d);
+		pthread_mutex_unlock(&r->lock);
+		frame.cancelled = cancelled;
+		draw_frame(&frame, d);
+		cancelled = frame.cancelled;
+		pthread_mutex_lock(&r->lock);
+		r->e->batch = frame.batch;
+		r->e->heat = frame.heat;
+		r->e->gbuf = frame.gbuf;
+		r->e->denoise = frame.denoise;
+		r->busy = 0;
+		pthread_cond_broadcast(&r->cond);
+	}
+	pthread_mutex_unlock(&r->lock);
+	return (NULL);
+}
+
+/* free_render -- Free the render thread's state once it has ended. */
+static void		free_render(t_render *r)
+{
+	pthread_mutex_destroy(&r->show);
+	pthread_cond_destroy(&r->cond);
+	pthread_mutex_destroy(&r->lock);
+	SDL_FreeSurface(r->front);
+	free(r->next);
+	free(r);
+}
+
+/*
+** render_start -- Start the render thread. If it cannot be started,
+** frames are drawn by the caller as before.
+*/
+void			render_start(t_env *e)
+{
+	t_render	*r;
+
+	if (!(r = (t_render *)calloc(1, sizeof(t_render))) ||
+		!(r->next = (t_env *)malloc(sizeof(t_env))))
+		err(MALLOC_ERROR, "render_start", e);
+	if (!(r->front = SDL_CreateRGBSurface(0, e->x, e->y, 32, 0, 0, 0, 0)))
+		err(MALLOC_ERROR, "render_start", e);
+	r->e = e;
+	pthread_mutex_init(&r->lock, NULL);
+	pthread_cond_init(&r->cond, NULL);
+	pthread_mutex_init(&r->show, NULL);
+	if (pthread_create(&r->thread, NULL, render_main, (void *)r))
+	{
+		perror("render_start: pthread_create");
+		free_render(r);
+		return ;
+	}
+	e->render = r;
+}
+
+/*
+** render_request -- Ask for a frame of region d as e is now, cancelling
+** the one in flight. A request it replaces before it was drawn may not
+** have been one that only reshades; the one that replaces it then isn't
+** either.
+*/
+void			render_request(t_env *e, SDL_Rect d)
+{
+	t_render	*r;
+	int			reshade;
+
+	r = e->render;
+	pthread_mutex_lock(&r->lock);
+	reshade = e->reshade && (!r->pending || r->next->reshade);
+	*r->next = *e;
+	r->next->reshade = reshade;
+	r->d = d;
+	r->pending = 1;
+	if (r->busy)
+		atomic_fetch_add(&g_frame_gen, 1);
+	pthread_cond_broadcast(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+}
+
+/*
+** render_pause -- Cancel the frame in flight, ask for it again, and wait
+** until it has wound down; no frame starts until render_resume. Pauses
+** nest.
+*/
+void			render_pause(t_env *e)
+{
+	t_render	*r;
+
+	if (!(r = e->render))
+		return ;
+	pthread_mutex_lock(&r->lock);
+	if (r->paused++ == 0 && r->busy)
+	{
+		atomic_fetch_add(&g_frame_gen, 1);
+		r->pending = 1;
+	}
+	while (r->busy)
+		pthread_cond_wait(&r->cond, &r->lock);
+	pthread_mutex_unlock(&r->lock);
+}
+
+/* render_resume -- Let frames start again after render_pause. */
+void			render_resume(t_env *e)
+{
+	t_render	*r;
+
+	if (!(r = e->render))
+		return ;
+	pthread_mutex_lock(&r->lock);
+	--r->paused;
+	pthread_cond_broadcast(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+}
+
+/*
+** render_wait -- Wait until every frame asked for has been drawn, e.g.
+** before the image is exported.
+*/
+void			render_wait(t_env *e)
+{
+	t_render	*r;
+
+	if (!(r = e->render))
+		return ;
+	pthread_mutex_lock(&r->lock);
+	while (r->busy || r->pending)
+		pthread_cond_wait(&r->cond, &r->lock);
+	pthread_mutex_unlock(&r->lock);
+}
+
+/*
+** add_dirty -- Add d to the regions to update. When there is no room for
+** it, they are all merged into their bounding box.
+*/
+static void		add_dirty(t_render *r, SDL_Rect d)
+{
+	SDL_Rect	box;
+	size_t		i;
+
+	if (r->dirties < PRESENT_RECTS)
+	{
+		r->dirty[r->dirties++] = d;
+		return ;
+	}
+	box = d;
+	i = -1;
+	while (++i < r->dirties)
+		SDL_UnionRect(&box, &r->dirty[i], &box);
+	r->dirty[0] = box;
+	r->dirties = 1;
+}
+
+/*
+** render_publish -- Copy region d of img (all of it if d is NULL), which
+** is no longer being drawn, to the front surface.
+*/
+void			render_publish(t_render *r, SDL_Surface *img, SDL_Rect *d)
+{
+	SDL_Rect	to;
+
+	to = d ? *d : (SDL_Rect){0, 0, img->w, img->h};
+	pthread_mutex_lock(&r->show);
+	if (!d)
+		r->dirties = 0;
+	add_dirty(r, to);
+	SDL_BlitSurface(img, d, r->front, &to);
+	pthread_mutex_unlock(&r->show);
+}
+
+/*
+** render_present -- Copy the regions of the front surface that changed
+** since the last call to the window, and update just those. Called by
+** the event loop every iteration; with --trace, an iteration that shows
+** anything is a slice.
+*/
+void			render_present(t_env *e)
+{
+	t_render	*r;
+	SDL_Rect	dirty[PRESENT_RECTS];
+	SDL_Rect	to;
+	size_t		n;
+	size_t		i;
+	double		span;
+
+	if (!(r = e->render))
+		return ;
+	span = trace_now();
+	pthread_mutex_lock(&r->show);
+	n = r->dirties;
+	i = -1;
+	while (++i < n)
+	{
+		dirty[i] = r->dirty[i];
+		to = dirty[i];
+		SDL_BlitSurface(r->front, &dirty[i], e->win_img, &to);
+	}
+	r->dirties = 0;
+	pthread_mutex_unlock(&r->show);
+	if (!n)
+		return ;
+	SDL_UpdateWindowSurfaceRects(e->win, dirty, n);
+	trace_span("render_present", span, n, -1);
+}
+
+/*
+** render_stop -- Cancel the frame in flight and end the render thread.
+** From the render thread itself (an error while drawing), the thread is
+** only told to quit, as the process is exiting.
+*/
+void			render_stop(t_env *e)
+{
+	t_render	*r;
+
+	if (!(r = e->render))
+		return ;
+	pthread_mutex_lock(&r->lock);
+	r->quit = 1;
+	atomic_fetch_add(&g_frame_gen, 1);
+	pthread_cond_broadcast(&r->cond);
+	pthread_mutex_unlock(&r->lock);
+	if (pthread_equal(pthread_self(), r->thread))
+		return ;
+	pthread_join(r->thread, NULL);
+	free_render(r);
+	e->render = NULL;
+}
@@ -10,15 +10,24 @@
 #include "rt.h"
 
 /*
-** Writes a single OBJECT block: the OBJ file path and its material name.
-** The material index (obj->material) is resolved to a name via the
-** materials array for human-readable output.
+** Writes a single OBJECT block: the OBJ file path and its material name,
+** then its placement unless it has none. The material index
+** (obj->material) is resolved to a name via the materials array for
+** human-readable output.
 */
 static void	save_object(t_object *obj, t_material **mat, int fd)
 {
 	dprintf(fd, "\n\tOBJECT\n");
 	dprintf(fd, "\t\tFILE\t\t%s\n", obj->name);
 	dprintf(fd, "\t\tMATERIAL\t%s\n", mat[obj->material]->name);
+	if (obj->identity)
+		return ;
+	dprintf(fd, "\t\tLOC\t\t\t");
+	write_coord(obj->loc, fd);
+	dprintf(fd, "\t\tROT\t\t\t");
+	write_coord(obj->rot, fd);
+	dprintf(fd, "\t\tSCALE\t\t");
+	write_coord(obj->scale, fd);
 }
 
 /*
@@ -48,10 +48,20 @@ static void	init(t_in_shadow *var, t_env *e, t_light *light)
 	/* vnormalize returns the length and stores it; then we make dir unit-length */
 	var->distance = vnormalize(var->ray.dir);
 	var->ray.dir = vdiv(var->ray.dir, var->distance);
-	var->prim = e->prims;
 	var->object = e->objects;
 }
 
+/*
+** shadow_early_out — Count a shadow ray stopped by an opaque occluder
+** before all objects were tested, and report it fully shadowed.
+*/
+
+static double	shadow_early_out(void)
+{
+	++g_tls_stats.shadow_early_outs;
+	return (1.0);
+}
+
 /*
 ** in_shadow — Test whether a surface point is occluded from a light source.
 **
@@ -66,46 +76,33 @@ double		in_shadow(t_env *e, t_light *light)
 {
 	t_in_shadow	var;
 	double		transmit;
-	double		t_test;
 
 	++g_tls_stats.rays;
 	++g_tls_stats.shadow_rays;
 	init(&var, e, light);
-	transmit = 1.0;
-	/* Test shadow ray against all standalone primitives */
-	while (var.prim--)
-	{
-		t_test = var.distance;
-		/* Only count intersections closer than the light source */
-		if (intersect_prim(e, &var.ray, var.prim, &t_test) && t_test <
-				var.distance)
-		{
-			/* Reduce transmittance by the object's transparency (refract) */
-			transmit *= e->material[e->prim[var.prim]->material]->refract;
-			/* Early exit: fully opaque shadow, no need to test more objects */
-			if (transmit < EPSILON)
-				return (1.0);
-		}
-	}
+	/*
+	** Test shadow ray against all standalone primitives: each one hit closer
+	** than the light reduces transmittance by its transparency (refract).
+	** Early exit: fully opaque shadow, no need to test more objects.
+	*/
+	if ((transmit = shadow_batches(e, &var.ray, var.distance)) < EPSILON)
+		return (shadow_early_out());
 	/* Test shadow ray against mesh objects (OBJ models) */
 	while (var.object--)
 	{
 		var.o = e->object[var.object];
-		/* Bounding box test: skip mesh entirely if ray misses its AABB */
-		if (intersect_box(&var.ray, var.o->box))
+		++g_tls_stats.node_visits;
+		/*
+		** Bounding box test: skip mesh entirely if ray misses its AABB.
+		** One face hit is enough for this mesh (occluded_object stops at
+		** the first), then on to the next object.
+		*/
+		if (intersect_box(&var.ray, var.o->box) &&
+			occluded_object(var.o, &var.ray, var.distance))
 		{
-			var.face = var.o->faces;
-			/* Test individual triangles within the mesh */
-			while (var.face--)
-				if (intersect_triangle(&var.ray, var.o->face[var.face],
-						&t_test) && t_test < var.distance)
-				{
-					transmit *= e->material[var.o->material]->refract;
-					if (transmit < EPSILON)
-						return (1.0);
-					/* One face hit is enough for this mesh — break to next object */
-					break ;
-				}
+			transmit *= e->material[var.o->material]->refract;
+			if (transmit < EPSILON)
+				return (shadow_early_out());
 		}
 	}
 	/* Convert transmittance to shadow factor: 1.0 - transmit */
@@ -0,0 +1,244 @@
+/*
+** stats.c -- Frame statistics: reset, merge, console report, JSON export.
+**
+** Render threads count into g_tls_stats without synchronisation and call
+** stats_merge once per tile to fold their counts into the atomic g_stats.
+** draw() resets g_stats at the start of every full frame, so everything
+** reported describes that frame alone.
+**
+** With --stats FILE, every frame also appends one JSON document, on a
+** single line, to FILE:
+**
+**   {"frame":1,"scene":"scenes/diamond","width":1280,"height":720,
+**    "threads":240,"super":8,"maxdepth":10,
+**    "time_ms":{"camera":0.01,"trace":166817.7,"blit":12.3,"total":...},
+**    "rays":{"total":...,"primary":...,"reflection":...,"refraction":...,
+**            "shadow":...},
+**    "intersection_tests":...,
+**    "prims":{"sphere":{"tests":...,"hits":...},...,"triangle":{...}},
+**    "box":{"tests":...,"rejections":...},"node_visits":...,
+**    "shadow_early_outs":...,"depth_histogram":[...]}
+**
+** Meshes add a "bvh" array, one entry per mesh whose BVH is built:
+**
+**   "bvh":[{"mesh":"scenes/objects/suzanne.obj","nodes":...,"sah":...,
+**           "build_ms":...,"cached":false},...]
+**
+** (build_ms is the cache load time when cached is true.)
+**
+** Every document also carries how long the scene took to load, by phase
+** (see read_scene.c; object includes obj):
+**
+**   "parse_ms":{"map":...,"globals":...,"camera":...,"light":...,
+**               "material":...,"primitive":...,"object":...,"obj":...,
+**               "total":...}
+**
+** With --perf a "perf" object follows: cycles, instructions, cache_misses,
+** branch_misses (null when the counter was unavailable) and ipc.
+**
+** One document per line keeps the file appendable across runs and easy to
+** stream into dashboards (jq, pandas.read_json(lines=True), ...).
+*/
+
+#include "rt.h"
+
+/* JSON key for each PRIM_* id; NULL slots are not primitive types. */
+static const char	*g_prim_name[STATS_PRIM_TYPES] = {NULL, "sphere", "plane",
+	"cone", "cylinder", "triangle", "disk", "hemisphere"};
+
+/*
+** stats_reset -- Zero every counter and timing before a new frame.
+*/
+void		stats_reset(void)
+{
+	size_t	frame;
+
+	frame = g_stats.frame;
+	memset(&g_stats, 0, sizeof(t_stats));
+	g_stats.frame = frame + 1;
+}
+
+/*
+** stats_merge -- Add the calling thread's counters to g_stats and clear
+** them. Called once per rendered tile, so the atomics stay off the hot path.
+*/
+void		stats_merge(void)
+{
+	size_t	i;
+
+	atomic_fetch_add(&g_stats.rays, g_tls_stats.rays);
+	atomic_fetch_add(&g_stats.primary_rays, g_tls_stats.primary_rays);
+	atomic_fetch_add(&g_stats.reflection_rays, g_tls_stats.reflection_rays);
+	atomic_fetch_add(&g_stats.refraction_rays, g_tls_stats.refraction_rays);
+	atomic_fetch_add(&g_stats.shadow_rays, g_tls_stats.shadow_rays);
+	atomic_fetch_add(&g_stats.intersection_tests, g_tls_stats.intersection_tests);
+	atomic_fetch_add(&g_stats.box_tests, g_tls_stats.box_tests);
+	atomic_fetch_add(&g_stats.box_rejects, g_tls_stats.box_rejects);
+	atomic_fetch_add(&g_stats.node_visits, g_tls_stats.node_visits);
+	atomic_fetch_add(&g_stats.shadow_early_outs, g_tls_stats.shadow_early_outs);
+	i = -1;
+	while (++i < STATS_PRIM_TYPES)
+	{
+		atomic_fetch_add(&g_stats.prim_tests[i], g_tls_stats.prim_tests[i]);
+		atomic_fetch_add(&g_stats.prim_hits[i], g_tls_stats.prim_hits[i]);
+	}
+	i = -1;
+	while (++i < STATS_DEPTH_BINS)
+		atomic_fetch_add(&g_stats.depth[i], g_tls_stats.depth[i]);
+	memset(&g_tls_stats, 0, sizeof(t_thread_stats));
+}
+
+/*
+** stats_print -- The console summary printed after every full frame.
+*/
+void		stats_print(void)
+{
+	printf("Frame drawn in %.6f seconds\n", g_stats.frame_ms / 1000.0);
+	printf("Rendered using %zu threads\n", atomic_load(&g_stats.threads));
+	printf("Total rays: %zu\n", atomic_load(&g_stats.rays));
+	printf("Primary rays: %zu\n", atomic_load(&g_stats.primary_rays));
+	printf("Reflection rays: %zu\n", atomic_load(&g_stats.reflection_rays));
+	printf("Refraction rays: %zu\n", atomic_load(&g_stats.refraction_rays));
+	printf("Shadow rays: %zu\n", atomic_load(&g_stats.shadow_rays));
+	printf("Intersection tests: %zu\n", atomic_load(&g_stats.intersection_tests));
+}
+
+/* Write s as a JSON string literal, escaping quotes and control bytes. */
+static void	json_string(FILE *f, const char *s)
+{
+	fputc('"', f);
+	while (*s)
+	{
+		if (*s == '"' || *s == '\\')
+			fprintf(f, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(f, "\\u%04x", (unsigned char)*s);
+		else
+			fputc(*s, f);
+		++s;
+	}
+	fputc('"', f);
+}
+
+/* "prims":{...} and "depth_histogram":[...] */
+static void	json_arrays(FILE *f)
+{
+	size_t	i;
+	int		first;
+
+	fputs(",\"prims\":{", f);
+	first = 1;
+	i = -1;
+	while (++i < STATS_PRIM_TYPES)
+		if (g_prim_name[i])
+		{
+			fprintf(f, "%s\"%s\":{\"tests\":%zu,\"hits\":%zu}",
+				first ? "" : ",", g_prim_name[i],
+				atomic_load(&g_stats.prim_tests[i]),
+				atomic_load(&g_stats.prim_hits[i]));
+			first = 0;
+		}
+	fputs("},\"depth_histogram\":[", f);
+	i = -1;
+	while (++i < STATS_DEPTH_BINS)
+		fprintf(f, "%s%zu", i ? "," : "", atomic_load(&g_stats.depth[i]));
+	fputc(']', f);
+}
+
+/* "bvh":[...], the BVH of each mesh that has one yet. */
+static void	json_bvh(FILE *f, t_env *e)
+{
+	size_t	i;
+	int		first;
+
+	fputs(",\"bvh\":[", f);
+	first = 1;
+	i = -1;
+	while (++i < e->meshes)
+		if (atomic_load_explicit(&e->mesh[i]->ready, memory_order_acquire))
+		{
+			fputs(first ? "{\"mesh\":" : ",{\"mesh\":", f);
+			json_string(f, e->mesh[i]->file);
+			fprintf(f, ",\"nodes\":%zu,\"sah\":%.4f,\"build_ms\":%.3f,"
+				"\"cached\":%s}", e->mesh[i]->bvh.nodes, e->mesh[i]->bvh.sah,
+				e->mesh[i]->build_ms, (e->mesh[i]->map) ? "true" : "false");
+			first = 0;
+		}
+	fputc(']', f);
+}
+
+/* "parse_ms":{...}, the time read_scene took per phase. */
+static void	json_parse(FILE *f, t_env *e)
+{
+	t_parse_times	*p;
+
+	p = &e->parse;
+	fprintf(f, ",\"parse_ms\":{\"map\":%.3f,\"globals\":%.3f,"
+		"\"camera\":%.3f,\"light\":%.3f,\"material\":%.3f,"
+		"\"primitive\":%.3f,\"object\":%.3f,\"obj\":%.3f,\"total\":%.3f}",
+		p->map_ms, p->globals_ms, p->block_ms[PARSE_CAMERA],
+		p->block_ms[PARSE_LIGHT], p->block_ms[PARSE_MATERIAL],
+		p->block_ms[PARSE_PRIMITIVE], p->block_ms[PARSE_OBJECT], p->obj_ms,
+		p->total_ms);
+}
+
+/* "perf":{...}, hardware counters with null for unavailable ones. */
+static void	json_perf(FILE *f)
+{
+	static const char	*name[PERF_COUNTERS] = {"cycles", "instructions",
+		"cache_misses", "branch_misses"};
+	int					i;
+
+	fputs(",\"perf\":{", f);
+	i = -1;
+	while (++i < PERF_COUNTERS)
+		if (perf_valid(i))
+			fprintf(f, "\"%s\":%zu,", name[i], atomic_load(&g_stats.perf[i]));
+		else
+			fprintf(f, "\"%s\":null,", name[i]);
+	if (perf_valid(PERF_CYCLES) && perf_valid(PERF_INSTRUCTIONS))
+		fprintf(f, "\"ipc\":%.4f}", (double)atomic_load(&g_stats.perf[
+			PERF_INSTRUCTIONS]) / MAX(atomic_load(&g_stats.perf[PERF_CYCLES]),
+			1));
+	else
+		fputs("\"ipc\":null}", f);
+}
+
+/*
+** stats_write_json -- Append this frame's document to --stats FILE.
+*/
+void		stats_write_json(t_env *e)
+{
+	FILE	*f;
+
+	if (!(f = fopen(e->opt.stats, "a")))
+		err(FILE_OPEN_ERROR, e->opt.stats, e);
+	fprintf(f, "{\"frame\":%zu,\"scene\":", g_stats.frame);
+	json_string(f, e->file_name);
+	fprintf(f, ",\"width\":%zu,\"height\":%zu,\"threads\":%zu,\"super\":%zu,"
+		"\"maxdepth\":%d", e->x, e->y, atomic_load(&g_stats.threads),
+		e->super, e->maxdepth);
+	fprintf(f, ",\"time_ms\":{\"camera\":%.3f,\"trace\":%.3f,\"blit\":%.3f,"
+		"\"total\":%.3f}", g_stats.camera_ms, g_stats.trace_ms,
+		g_stats.blit_ms, g_stats.frame_ms);
+	json_parse(f, e);
+	fprintf(f, ",\"rays\":{\"total\":%zu,\"primary\":%zu,\"reflection\":%zu,"
+		"\"refraction\":%zu,\"shadow\":%zu}", atomic_load(&g_stats.rays),
+		atomic_load(&g_stats.primary_rays),
+		atomic_load(&g_stats.reflection_rays),
+		atomic_load(&g_stats.refraction_rays),
+		atomic_load(&g_stats.shadow_rays));
+	fprintf(f, ",\"intersection_tests\":%zu",
+		atomic_load(&g_stats.intersection_tests));
+	json_arrays(f);
+	if (e->meshes)
+		json_bvh(f, e);
+	if (e->opt.perf)
+		json_perf(f);
+	fprintf(f, ",\"box\":{\"tests\":%zu,\"rejections\":%zu},"
+		"\"node_visits\":%zu,\"shadow_early_outs\":%zu}\n",
+		atomic_load(&g_stats.box_tests), atomic_load(&g_stats.box_rejects),
+		atomic_load(&g_stats.node_visits),
+		atomic_load(&g_stats.shadow_early_outs));
+	fclose(f);
+}
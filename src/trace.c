@@ -0,0 +1,218 @@
+/*
+** trace.c -- Chrome trace-event timeline of the render loop (--trace FILE).
+**
+** Every thread that records an event gets its own fixed-size ring of
+** t_trace_event, created on first use and linked into a registry (the
+** only lock, taken once per thread). Recording is a thread-local pointer
+** check, a clock read and a store -- no locks or atomics -- so tracing a
+** frame costs microseconds. A full ring overwrites its oldest events and
+** counts the loss. The one exception is the main thread's ring, which
+** the render thread flushes while the event loop may be recording into
+** it: its events are stored under the registry lock.
+**
+** At the end of every frame (grab previews included) draw_frame calls
+** trace_flush, which appends all recorded events to FILE in the Chrome
+** "JSON Array Format" and frees the tile threads' rings. The array is
+** closed by trace_close on exit; chrome://tracing and Perfetto also
+** accept the file without the closing bracket, so a trace from a crashed
+** run is still readable.
+**
+** Threads appear as:
+**   tid 0  = main thread (window updates; without a window, everything
+**            the render thread would record)
+**   tid 1  = render thread (spawn, p_join waits, blits), which calls
+**            trace_set_main
+**   tid 2.. = one per tile thread of the frame, in start order
+** The first two keep a TRACE_RING_MAIN ring for the whole run; a tile
+** thread gets a TRACE_RING_SIZE ring for one frame.
+*/
+
+#include "rt.h"
+#include <pthread.h>
+
+static FILE							*g_trace_file;
+static double						g_trace_t0;
+static t_trace_ring					*g_trace_rings;
+static pthread_mutex_t				g_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t						g_trace_gen;
+static _Atomic int					g_trace_tids;
+static _Thread_local t_trace_ring	*g_trace_ring;
+static _Thread_local int			g_trace_tid = -1;
+
+/*
+** trace_init -- Open FILE and start the clock. Called once from main when
+** --trace is given; until then every trace_* call is a no-op.
+*/
+void			trace_init(t_env *e)
+{
+	if (!(g_trace_file = fopen(e->opt.trace, "w")))
+		err(FILE_OPEN_ERROR, e->opt.trace, e);
+	fputs("[\n", g_trace_file);
+	g_trace_t0 = clock_ms();
+	g_trace_gen = 1;
+	g_trace_tids = 2;
+	g_trace_tid = 0;
+}
+
+/*
+** trace_set_main -- Record the calling thread's events as tid 1, in a ring
+** kept from frame to frame. Called by the render thread as it starts,
+** which may be before trace_init.
+*/
+void			trace_set_main(void)
+{
+	g_trace_tid = 1;
+}
+
+/* Current trace time in ms, or 0 when tracing is off. */
+double			trace_now(void)
+{
+	return (g_trace_file ? clock_ms() : 0);
+}
+
+/*
+** ring -- The calling thread's ring, created and registered on first use.
+** The main and render threads keep theirs; a tile thread's ring left over
+** from a previous (flushed) frame has a stale generation and is replaced.
+*/
+static t_trace_ring	*ring(void)
+{
+	t_trace_ring	*r;
+	size_t			size;
+
+	if ((r = g_trace_ring) && (g_trace_tid >= 0 || r->gen == g_trace_gen))
+		return (r);
+	size = g_trace_tid >= 0 ? TRACE_RING_MAIN : TRACE_RING_SIZE;
+	if (!(r = (t_trace_ring *)calloc(1, sizeof(t_trace_ring) +
+		size * sizeof(t_trace_event))))
+		return (NULL);
+	r->size = size;
+	pthread_mutex_lock(&g_trace_lock);
+	r->gen = g_trace_gen;
+	r->tid = g_trace_tid >= 0 ? g_trace_tid :
+		atomic_fetch_add(&g_trace_tids, 1);
+	r->next = g_trace_rings;
+	g_trace_rings = r;
+	pthread_mutex_unlock(&g_trace_lock);
+	g_trace_ring = r;
+	return (r);
+}
+
+/*
+** trace_span -- Record a complete event: name ran from start (a
+** trace_now() value) until now. a and b are optional arguments, -1 for
+** none: with both they are shown as tile coordinates {x, y}, with only a
+** as a count or index {n}.
+*/
+void			trace_span(const char *name, double start, int a, int b)
+{
+	t_trace_ring	*r;
+	t_trace_event	*ev;
+
+	if (!g_trace_file || !(r = ring()))
+		return ;
+	if (r->tid == 0)
+		pthread_mutex_lock(&g_trace_lock);
+	ev = &r->ev[r->head];
+	ev->name = name;
+	ev->start = start;
+	ev->end = clock_ms();
+	ev->a = a;
+	ev->b = b;
+	r->head = (r->head + 1) % r->size;
+	if (r->count < r->size)
+		++r->count;
+	else
+		++r->dropped;
+	if (r->tid == 0)
+		pthread_mutex_unlock(&g_trace_lock);
+}
+
+/*
+** write_ring -- Write one ring's events, oldest first, plus its thread
+** name, and empty it.
+*/
+static void		write_ring(t_trace_ring *r)
+{
+	static const char	*names[] = {"main", "render thread", "tile thread"};
+	t_trace_event		*ev;
+	size_t				i;
+
+	fprintf(g_trace_file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+		"\"tid\":%d,\"args\":{\"name\":\"%s %d\"}},\n", r->tid,
+		names[r->tid < 2 ? r->tid : 2], r->tid);
+	i = (r->head + r->size - r->count) % r->size;
+	while (r->count--)
+	{
+		ev = &r->ev[i];
+		fprintf(g_trace_file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+			"\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", ev->name, r->tid,
+			(ev->start - g_trace_t0) * 1000.0, (ev->end - ev->start) * 1000.0);
+		if (ev->b >= 0)
+			fprintf(g_trace_file, ",\"args\":{\"x\":%d,\"y\":%d}", ev->a, ev->b);
+		else if (ev->a >= 0)
+			fprintf(g_trace_file, ",\"args\":{\"n\":%d}", ev->a);
+		fputs("},\n", g_trace_file);
+		i = (i + 1) % r->size;
+	}
+	if (r->dropped)
+		fprintf(g_trace_file, "{\"name\":\"ring overflow\",\"ph\":\"i\","
+			"\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+			"\"args\":{\"dropped\":%zu}},\n", r->tid,
+			(clock_ms() - g_trace_t0) * 1000.0, r->dropped);
+	r->head = 0;
+	r->count = 0;
+	r->dropped = 0;
+}
+
+/*
+** trace_flush -- Append every ring to FILE, and free the tile threads'.
+** Called by the thread that draws frames once all tile threads of the
+** frame have been joined, and by trace_close.
+*/
+void			trace_flush(void)
+{
+	t_trace_ring	*r;
+	t_trace_ring	*next;
+	t_trace_ring	*kept;
+
+	if (!g_trace_file)
+		return ;
+	pthread_mutex_lock(&g_trace_lock);
+	r = g_trace_rings;
+	kept = NULL;
+	while (r)
+	{
+		next = r->next;
+		write_ring(r);
+		if (r->tid < 2)
+		{
+			r->next = kept;
+			kept = r;
+		}
+		else
+			free(r);
+		r = next;
+	}
+	g_trace_rings = kept;
+	++g_trace_gen;
+	atomic_store(&g_trace_tids, 2);
+	pthread_mutex_unlock(&g_trace_lock);
+	fflush(g_trace_file);
+}
+
+/*
+** trace_close -- Flush anything left and terminate the JSON array. The
+** final entry is a dummy instant event so the preceding ",\n" is valid.
+*/
+void			trace_close(void)
+{
+	if (!g_trace_file)
+		return ;
+	trace_flush();
+	fprintf(g_trace_file, "{\"name\":\"exit\",\"ph\":\"i\",\"s\":\"g\","
+		"\"pid\":1,\"tid\":0,\"ts\":%.3f}\n]\n",
+		(clock_ms() - g_trace_t0) * 1000.0);
+	fclose(g_trace_file);
+	g_trace_file = NULL;
+}
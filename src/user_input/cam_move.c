@@ -10,7 +10,8 @@
 ** adjusting the look-at point. This is an orbiting/panning rotation, not a
 ** true arcball -- it modifies dir.x and dir.z linearly from mouse deltas.
 **
-** Translation: WASD/Space/Ctrl move the camera along world-space axes.
+** Translation: WASD/Space/Ctrl move the camera along world-space axes, at
+** FRAME_RATE units per second.
 ** Both loc and dir are moved together so the view direction stays constant.
 **
 ** Coordinate system:
@@ -26,42 +27,42 @@
 ** - Horizontal mouse motion (xrel) rotates around Z axis -> modifies dir.x
 ** - Vertical mouse motion (yrel) tilts up/down -> modifies dir.z
 ** The 0.1 factor controls rotation sensitivity (degrees per pixel of motion).
-** SDL_FlushEvent discards queued motion events to prevent rotation buildup
-** while the scene is being re-rendered.
+** Queued motion is merged in first (motion_merge). The frame is drawn by
+** the event loop's frame_tick, with any other input until then.
 */
 void			cam_rot(t_env *e, SDL_Event event)
 {
 	SDL_SetRelativeMouseMode(1);
+	motion_merge(&event);
 	e->camera.dir.x += (double)event.motion.xrel * 0.1;
 	e->camera.dir.z -= (double)event.motion.yrel * 0.1;
-	draw(e, (SDL_Rect){0, 0, e->x, e->y});
-	SDL_FlushEvent(SDL_MOUSEMOTION);
+	schedule_draw(e);
 }
 
 /*
-** Translates camera in the negative direction along world axes.
+** Translates camera step units in the negative direction along world axes.
 ** Both loc and dir are decremented together so the view direction
 ** (dir - loc) remains unchanged -- the camera slides without rotating.
 **   A key -> -X (move left)
 **   S key -> -Y (move backward)
 **   Ctrl  -> -Z (move down)
 */
-static void		cam_move_minus(t_env *e)
+static void		cam_move_minus(t_env *e, double step)
 {
 	if (e->flags & KEY_A)
 	{
-		--e->camera.loc.x;
-		--e->camera.dir.x;
+		e->camera.loc.x -= step;
+		e->camera.dir.x -= step;
 	}
 	if (e->flags & KEY_S)
 	{
-		--e->camera.loc.y;
-		--e->camera.dir.y;
+		e->camera.loc.y -= step;
+		e->camera.dir.y -= step;
 	}
 	if (e->flags & KEY_CTRL)
 	{
-		--e->camera.loc.z;
-		--e->camera.dir.z;
+		e->camera.loc.z -= step;
+		e->camera.dir.z -= step;
 	}
 }
 
@@ -72,33 +73,34 @@ static void		cam_move_minus(t_env *e)
 **   W key   -> +Y (move forward)
 **   Space   -> +Z (move up)
 */
-static void		cam_move_plus(t_env *e)
+static void		cam_move_plus(t_env *e, double step)
 {
 	if (e->flags & KEY_D)
 	{
-		++e->camera.loc.x;
-		++e->camera.dir.x;
+		e->camera.loc.x += step;
+		e->camera.dir.x += step;
 	}
 	if (e->flags & KEY_W)
 	{
-		++e->camera.loc.y;
-		++e->camera.dir.y;
+		e->camera.loc.y += step;
+		e->camera.dir.y += step;
 	}
 	if (e->flags & KEY_SPACE)
 	{
-		++e->camera.loc.z;
-		++e->camera.dir.z;
+		e->camera.loc.z += step;
+		e->camera.dir.z += step;
 	}
 }
 
 /*
-** Called each frame during camera movement mode. Applies all active
-** movement flags (multiple keys can be held simultaneously for diagonal
-** movement) and re-renders the scene.
+** Called by the event loop once per tick while movement keys are held in
+** camera movement mode, with step the distance covered since the last
+** tick. Applies all active movement flags (multiple keys can be held
+** simultaneously for diagonal movement) and asks for a frame.
 */
-void			cam_move(t_env *e)
+void			cam_move(t_env *e, double step)
 {
-	cam_move_plus(e);
-	cam_move_minus(e);
-	draw(e, (SDL_Rect){0, 0, e->x, e->y});
+	cam_move_plus(e, step);
+	cam_move_minus(e, step);
+	schedule_draw(e);
 }
@@ -17,66 +17,105 @@
 ** The scale factor 0.015 converts pixel deltas to world units, providing
 ** fine-grained control. Scroll wheel uses a larger factor (0.5) since
 ** wheel ticks are coarser than pixel movements.
+**
+** Motion and wheel ticks are gathered as they arrive and applied once per
+** event loop tick (grab_apply), so the frame drawn shows all of them.
 */
 
 #include "rt.h"
 
 /*
-** Scroll wheel handler: moves selected objects along the Y axis (depth).
-** Only active when the Y axis flag is set (not constrained away from Y).
-** The negative sign means scrolling "up" (positive wheel.y) moves objects
-** toward the camera (decreasing Y in the scene's coordinate system).
-** SDL_FlushEvent prevents scroll event buildup during rendering.
+** Scroll wheel handler: the ticks are gathered for grab_apply, which moves
+** the selected objects along the Y axis (depth).
 */
 void	m_wheel(t_env *e, SDL_Event *event)
 {
-	size_t index;
+	if (e->s_num)
+	{
+		e->sched.wheel += event->wheel.y;
+		schedule_draw(e);
+	}
+}
+
+/*
+** Adds the relative motion of every queued motion event to event's, taking
+** them off the queue: the mouse moved that far in all.
+*/
+void	motion_merge(SDL_Event *event)
+{
+	SDL_Event	next;
+
+	while (SDL_PeepEvents(&next, 1, SDL_GETEVENT, SDL_MOUSEMOTION,
+		SDL_MOUSEMOTION) > 0)
+	{
+		event->motion.xrel += next.motion.xrel;
+		event->motion.yrel += next.motion.yrel;
+	}
+}
 
+/*
+** Mouse motion handler: the motion, with any queued behind it
+** (motion_merge), is gathered for grab_apply.
+*/
+void	grab(t_env *e, SDL_Event *event)
+{
+	SDL_SetRelativeMouseMode(1);
 	if (e->s_num)
 	{
-		index = e->prims;
-		while (index--)
-			if ((e->flags & KEY_Y) && e->prim[index]->s_bool)
-				e->prim[index]->loc.y -= (double)event->wheel.y * 0.5;
-		SDL_FlushEvent(SDL_MOUSEWHEEL);
-		draw(e, (SDL_Rect){0, 0, e->x, e->y});
+		motion_merge(event);
+		e->sched.grab_x += event->motion.xrel;
+		e->sched.grab_y += event->motion.yrel;
+		schedule_draw(e);
 	}
 }
 
 /*
-** Moves all selected primitives based on mouse motion delta.
+** Moves all selected primitives by the mouse motion and wheel ticks
+** gathered since the last call (grab, m_wheel). Called by the event loop
+** once per tick, so a burst of motion moves them once, and by anything
+** about to end or change the grab so that the motion made so far counts.
 ** Only the axes whose flags are set in e->flags are affected, allowing
 ** axis-constrained movement (e.g., press X to move only along X).
 **
 ** The mapping is:
 **   mouse xrel -> world X (positive xrel = move right = +X)
 **   mouse yrel -> world Z (positive yrel = move down on screen = -Z)
+**   wheel      -> world Y (positive wheel.y = toward the camera = -Y)
 **
 ** The 0.015 scale factor provides fine control: ~67 pixels of mouse
-** movement equals 1 world unit.
+** movement equals 1 world unit. The wheel uses a larger factor (0.5) since
+** wheel ticks are coarser than pixel movements.
 **
-** SDL_FlushEvent discards queued motion events so movement doesn't
-** accumulate while the scene is re-rendering.
+** Motion gathered outside grab mode (it ended meanwhile) is dropped. The
+** render thread is paused while the primitives move.
 */
-void	grab(t_env *e, SDL_Event *event)
+void	grab_apply(t_env *e)
 {
+	t_sched	*s;
 	size_t	index;
 
-	SDL_SetRelativeMouseMode(1);
-	if (e->s_num)
+	s = &e->sched;
+	if (!s->grab_x && !s->grab_y && !s->wheel)
+		return ;
+	if ((e->flags & KEY_G) && e->s_num)
 	{
+		render_pause(e);
 		index = e->prims;
 		while (index--)
 			if (e->prim[index]->s_bool)
 			{
 				if (e->flags & KEY_X)
-					e->prim[index]->loc.x += (double)event->motion.xrel * 0.015;
+					e->prim[index]->loc.x += (double)s->grab_x * 0.015;
 				if (e->flags & KEY_Z)
-					e->prim[index]->loc.z -= (double)event->motion.yrel * 0.015;
+					e->prim[index]->loc.z -= (double)s->grab_y * 0.015;
+				if (e->flags & KEY_Y)
+					e->prim[index]->loc.y -= (double)s->wheel * 0.5;
 			}
-		SDL_FlushEvent(SDL_MOUSEMOTION);
-		draw(e, (SDL_Rect){0, 0, e->x, e->y});
+		render_resume(e);
 	}
+	s->grab_x = 0;
+	s->grab_y = 0;
+	s->wheel = 0;
 }
 
 /*
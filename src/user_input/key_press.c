@@ -43,9 +43,11 @@ void		key_release(t_env *e, SDL_Keycode key)
 ** Toggles between selecting all and deselecting all primitives.
 ** If any primitives are currently selected (s_num > 0), deselect all;
 ** otherwise, select all. Re-renders the scene to show selection highlighting.
+** The render thread is paused while the selection changes.
 */
 static void	key_press_a(t_env *e)
 {
+	render_pause(e);
 	if (e->s_num)
 	{
 		fputs("Deselecting all primitives\n", stdout);
@@ -56,7 +58,8 @@ static void	key_press_a(t_env *e)
 		fputs("Selecting all primitives\n", stdout);
 		select_all(e);
 	}
-	draw(e, (SDL_Rect){0, 0, e->x, e->y});
+	render_resume(e);
+	schedule_draw(e);
 }
 
 /*
@@ -99,17 +102,19 @@ static void	key_press_xyz(t_env *e, SDL_Keycode key)
 ** S key: Toggles scale flag (XOR ^= so pressing again turns it off).
 ** R key: Toggles rotate flag (same XOR toggle pattern).
 **
-** X/Y/Z keys: Delegated to key_press_xyz for axis constraint logic.
+** X/Y/Z keys: Delegated to key_press_xyz for axis constraint logic. Grab
+** motion not yet applied is applied first, along the axes it was made on.
 */
 void		key_press(t_env *e, SDL_Keycode key)
 {
+	grab_apply(e);
 	if (key == SDLK_LSHIFT)
 		e->flags |= KEY_SHIFT;
 	else if (e->s_num && key == SDLK_g)
 	{
 		e->flags |= KEY_G;
 		SDL_SetRelativeMouseMode(1);
-		draw(e, (SDL_Rect){0, 0, e->x, e->y});
+		schedule_draw(e);
 	}
 	else if (!(e->flags & KEY_G) && key == SDLK_a)
 		key_press_a(e);
@@ -40,7 +40,9 @@ static void	reset_loc(t_env *e)
 /*
 ** Casts a pick ray through the clicked pixel and selects/deselects the hit.
 **
-** 1. Get mouse coordinates from SDL
+** 1. Get mouse coordinates from SDL, and set up the camera plane and
+**    primitive batches as the next frame will (the render thread draws
+**    from its own copy of the camera)
 ** 2. Build a ray from the camera through that pixel (get_ray_dir)
 ** 3. Test the ray against all scene objects (intersect_scene)
 ** 4. If something was hit (p_hit != NULL):
@@ -55,6 +57,8 @@ static void	click_select(t_env *e)
 	int	y;
 
 	SDL_GetMouseState(&x, &y);
+	update_prim_batches(e);
+	setup_camera_plane(e);
 	get_ray_dir(e, x, y);
 	intersect_scene(e);
 	if (e->p_hit)
@@ -102,11 +106,16 @@ void		click_release(t_env *e, SDL_Event event)
 ** Middle button: Enter camera rotation mode (KEY_MID_CLICK flag).
 **               Disables relative mouse so cursor stays visible.
 **
-** After any click, reset_keys() clears transient state (grab/scale/rotate)
-** and re-enables all axes, then the scene is re-rendered.
+** Grab motion not yet applied is applied first, so that confirming keeps
+** it and cancelling reverts it. After any click, reset_keys() clears
+** transient state (grab/scale/rotate) and re-enables all axes, then a
+** frame is asked for. The render thread is paused meanwhile, as selecting
+** and cancelling edit primitives.
 */
 void		mouse_click(t_env *e, uint8_t button)
 {
+	grab_apply(e);
+	render_pause(e);
 	if (button == SDL_BUTTON_LEFT)
 	{
 		if (!(e->flags & KEY_G))
@@ -123,5 +132,6 @@ void		mouse_click(t_env *e, uint8_t button)
 		SDL_SetRelativeMouseMode(0);
 	}
 	reset_keys(e);
-	draw(e, (SDL_Rect){0, 0, e->x, e->y});
+	render_resume(e);
+	schedule_draw(e);
 }
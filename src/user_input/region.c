@@ -0,0 +1,60 @@
+/*
+** region.c -- Rendering a selected part of the image.
+**
+** Drawing the whole frame to look at one detail wastes most of the work.
+** Pressing B and dragging out a rectangle with the left button makes that
+** rectangle the region every frame is drawn in (the rest of the window
+** keeps what was last drawn there); pressing B again goes back to the
+** whole image. --crop starts with a region set.
+*/
+
+#include "rt.h"
+
+/*
+** region_key -- B: forget the region if there is one, otherwise wait for
+** one to be dragged out.
+*/
+void		region_key(t_env *e)
+{
+	if (e->region.w != (int)e->x || e->region.h != (int)e->y)
+	{
+		e->region = (SDL_Rect){0, 0, e->x, e->y};
+		e->flags &= ~KEY_B;
+		puts("Rendering the whole image");
+		schedule_draw(e);
+		return ;
+	}
+	e->flags ^= KEY_B;
+	if (e->flags & KEY_B)
+		puts("Drag out the region to render with the left button");
+}
+
+/*
+** region_mouse -- While waiting for a region (KEY_B), the left button's
+** press and release are its corners. Returns whether the event was used.
+*/
+int			region_mouse(t_env *e, SDL_Event *event)
+{
+	SDL_Rect	full;
+	SDL_Rect	r;
+
+	if (!(e->flags & KEY_B) || event->button.button != SDL_BUTTON_LEFT)
+		return (0);
+	if (event->type == SDL_MOUSEBUTTONDOWN)
+	{
+		e->drag_x = event->button.x;
+		e->drag_y = event->button.y;
+		return (1);
+	}
+	e->flags &= ~KEY_B;
+	r = (SDL_Rect){MIN(e->drag_x, event->button.x),
+		MIN(e->drag_y, event->button.y), abs(event->button.x - e->drag_x) + 1,
+		abs(event->button.y - e->drag_y) + 1};
+	full = (SDL_Rect){0, 0, e->x, e->y};
+	if (!SDL_IntersectRect(&r, &full, &e->region))
+		e->region = full;
+	printf("Rendering %d x %d at (%d, %d)\n", e->region.w, e->region.h,
+		e->region.x, e->region.y);
+	schedule_draw(e);
+	return (1);
+}
@@ -0,0 +1,102 @@
+#!/bin/sh
+#
+# golden.sh -- Golden-image regression and performance check.
+#
+# Renders every scene in scenes/ headlessly at a small, fixed quality
+# (./RT --output), compares each image against tests/golden/<scene>.ppm
+# with tests/imgcmp, and compares render time against the time recorded in
+# tests/golden/baseline.csv. Run from the repository root (scenes refer to
+# their OBJ files relative to it); `make check` does that for you.
+#
+# A scene fails when
+#   - its PSNR against the reference drops below MIN_PSNR, or
+#   - its render time exceeds TIME_TOLERANCE x baseline + TIME_SLACK_MS.
+# Ray-count changes are reported but do not fail: acceleration work should
+# not change them, shading work legitimately does.
+#
+# Environment:
+#   UPDATE=1          re-render the references and baseline.csv instead
+#   CHECK_TIME=0      skip the timing check (e.g. on a loaded machine)
+#   MIN_PSNR          default 40 (dB)
+#   TIME_TOLERANCE    default 1.5
+#   TIME_SLACK_MS     default 100
+#   GOLDEN_SIZE       default "128 72"; GOLDEN_SUPER default 1;
+#   GOLDEN_MAXDEPTH   default 5 -- changing these requires UPDATE=1
+#
+# Timings are machine-specific: after moving to new hardware, re-record
+# the baseline with `make golden` before trusting the timing check.
+# Outputs, stats and difference images are left in tests/out/.
+
+RT=./RT
+CMP=tests/imgcmp
+REF=tests/golden
+OUT=tests/out
+MIN_PSNR=${MIN_PSNR:-40}
+TIME_TOLERANCE=${TIME_TOLERANCE:-1.5}
+TIME_SLACK_MS=${TIME_SLACK_MS:-100}
+GOLDEN_SIZE=${GOLDEN_SIZE:-"128 72"}
+GOLDEN_SUPER=${GOLDEN_SUPER:-1}
+GOLDEN_MAXDEPTH=${GOLDEN_MAXDEPTH:-5}
+
+mkdir -p "$OUT" "$REF"
+if [ "$UPDATE" = 1 ]; then
+	echo "scene,time_ms,rays" > "$REF/baseline.csv.new"
+fi
+failed=0
+total=0
+
+for scene in scenes/*; do
+	[ -f "$scene" ] || continue
+	name=$(basename "$scene")
+	total=$((total + 1))
+	rm -f "$OUT/$name.json"
+	# shellcheck disable=SC2086
+	if ! "$RT" --output "$OUT/$name.ppm" --stats "$OUT/$name.json" \
+		--size $GOLDEN_SIZE --super "$GOLDEN_SUPER" \
+		--maxdepth "$GOLDEN_MAXDEPTH" "$scene" > "$OUT/$name.log" 2>&1; then
+		echo "FAIL $name: render failed (see $OUT/$name.log)"
+		failed=$((failed + 1))
+		continue
+	fi
+	ms=$(sed -n 's/.*"time_ms":{[^}]*"total":\([0-9.]*\)}.*/\1/p' "$OUT/$name.json")
+	rays=$(sed -n 's/.*"rays":{"total":\([0-9]*\).*/\1/p' "$OUT/$name.json")
+	if [ "$UPDATE" = 1 ]; then
+		cp "$OUT/$name.ppm" "$REF/$name.ppm"
+		echo "$name,$ms,$rays" >> "$REF/baseline.csv.new"
+		printf "%-24s recorded  %10.1f ms  %12s rays\n" "$name" "$ms" "$rays"
+		continue
+	fi
+	status=ok
+	if [ ! -f "$REF/$name.ppm" ]; then
+		result="no reference image"
+		status=FAIL
+	elif ! result=$("$CMP" "$REF/$name.ppm" "$OUT/$name.ppm" "$MIN_PSNR" \
+		"$OUT/$name.diff.ppm"); then
+		status=FAIL
+	fi
+	base=$(awk -F, -v n="$name" '$1 == n { print $2 " " $3 }' \
+		"$REF/baseline.csv" 2>/dev/null)
+	base_ms=${base% *}
+	base_rays=${base#* }
+	note=""
+	if [ -n "$base" ]; then
+		if [ "$CHECK_TIME" != 0 ] && awk -v t="$ms" -v b="$base_ms" \
+			-v k="$TIME_TOLERANCE" -v s="$TIME_SLACK_MS" \
+			'BEGIN { exit !(t > b * k + s) }'; then
+			note="$note time regressed (baseline $base_ms ms)"
+			status=FAIL
+		fi
+		[ "$rays" != "$base_rays" ] && note="$note rays changed (was $base_rays)"
+	fi
+	printf "%-4s %-24s %-28s %10.1f ms  %12s rays%s\n" "$status" "$name" \
+		"$result" "$ms" "$rays" "$note"
+	[ "$status" = ok ] || failed=$((failed + 1))
+done
+
+if [ "$UPDATE" = 1 ]; then
+	mv "$REF/baseline.csv.new" "$REF/baseline.csv"
+	echo "References updated in $REF/"
+	exit 0
+fi
+echo "$((total - failed))/$total scenes passed"
+[ "$failed" = 0 ]
@@ -0,0 +1,139 @@
+/*
+** imgcmp.c -- Compare two PPM (P6) images for the golden-image tests.
+**
+** Usage: imgcmp REFERENCE CANDIDATE MIN_PSNR [DIFF.ppm]
+**
+** Prints the PSNR (dB, over all RGB channels) and the largest per-channel
+** difference, then exits 0 if the PSNR is at least MIN_PSNR, 1 if it is
+** lower (or the sizes differ) and 2 if an image cannot be read. Identical
+** images report "inf". If DIFF.ppm is given a difference image is written:
+** each channel is |a - b| scaled by 8, so small drifts are visible.
+**
+** PSNR tolerates the tiny, evenly spread changes that float-precision or
+** traversal-order work may introduce, while a missing object, a wrong
+** shadow or a broken material costs several dB and fails the test.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct	s_ppm
+{
+	int				w;
+	int				h;
+	unsigned char	*px;
+}				t_ppm;
+
+/* Read the next header integer, skipping whitespace and # comments. */
+static int		header_int(FILE *f)
+{
+	int		c;
+	int		n;
+
+	while ((c = fgetc(f)) != EOF && (c == '#' || c == ' ' || c == '\t' ||
+		c == '\n' || c == '\r'))
+		if (c == '#')
+			while ((c = fgetc(f)) != EOF && c != '\n')
+				;
+	n = -1;
+	if (c >= '0' && c <= '9')
+	{
+		n = 0;
+		while (c >= '0' && c <= '9')
+		{
+			n = n * 10 + c - '0';
+			c = fgetc(f);
+		}
+	}
+	return (n);
+}
+
+/* Load a binary P6 PPM with maxval 255. Returns 0 on success. */
+static int		read_ppm(const char *path, t_ppm *img)
+{
+	FILE	*f;
+	size_t	n;
+
+	if (!(f = fopen(path, "rb")))
+		return (-1);
+	if (fgetc(f) != 'P' || fgetc(f) != '6' || (img->w = header_int(f)) <= 0 ||
+		(img->h = header_int(f)) <= 0 || header_int(f) != 255)
+	{
+		fclose(f);
+		return (-1);
+	}
+	n = (size_t)img->w * img->h * 3;
+	if (!(img->px = malloc(n)) || fread(img->px, 1, n, f) != n)
+	{
+		fclose(f);
+		return (-1);
+	}
+	fclose(f);
+	return (0);
+}
+
+/* Write the amplified absolute difference of a and b to path. */
+static void		write_diff(const char *path, t_ppm *a, t_ppm *b)
+{
+	FILE	*f;
+	size_t	i;
+	int		d;
+
+	if (!(f = fopen(path, "wb")))
+		return ;
+	fprintf(f, "P6\n%d %d\n255\n", a->w, a->h);
+	i = 0;
+	while (i < (size_t)a->w * a->h * 3)
+	{
+		d = abs(a->px[i] - b->px[i]) * 8;
+		fputc(d > 255 ? 255 : d, f);
+		++i;
+	}
+	fclose(f);
+}
+
+int				main(int ac, char **av)
+{
+	t_ppm	a;
+	t_ppm	b;
+	double	mse;
+	double	psnr;
+	int		max;
+	size_t	i;
+
+	if (ac < 4 || ac > 5)
+	{
+		fputs("usage: imgcmp REFERENCE CANDIDATE MIN_PSNR [DIFF.ppm]\n", stderr);
+		return (2);
+	}
+	if (read_ppm(av[1], &a) || read_ppm(av[2], &b))
+	{
+		fprintf(stderr, "imgcmp: cannot read %s or %s\n", av[1], av[2]);
+		return (2);
+	}
+	if (a.w != b.w || a.h != b.h)
+	{
+		printf("size mismatch %dx%d vs %dx%d\n", a.w, a.h, b.w, b.h);
+		return (1);
+	}
+	mse = 0;
+	max = 0;
+	i = -1;
+	while (++i < (size_t)a.w * a.h * 3)
+	{
+		mse += (double)(a.px[i] - b.px[i]) * (a.px[i] - b.px[i]);
+		if (abs(a.px[i] - b.px[i]) > max)
+			max = abs(a.px[i] - b.px[i]);
+	}
+	mse /= (double)a.w * a.h * 3;
+	psnr = mse ? 10.0 * log10(255.0 * 255.0 / mse) : INFINITY;
+	if (ac == 5 && mse)
+		write_diff(av[4], &a, &b);
+	if (isinf(psnr))
+		printf("psnr=inf max_diff=0\n");
+	else
+		printf("psnr=%.2f max_diff=%d\n", psnr, max);
+	return (psnr >= atof(av[3]) ? 0 : 1);
+}
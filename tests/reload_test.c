@@ -0,0 +1,176 @@
+/*
+** reload_test.c -- A frame asked for before a reload is drawn after it.
+**
+** Usage: make check
+**        tests/reload_test [SCENE]
+**
+** With a window, frames are drawn by the render thread from a snapshot of
+** the environment (src/render_thread.c). A frame asked for just before the
+** scene file is reloaded can still be waiting when the reload frees the
+** lights, materials and primitives the snapshot saw. This test makes that
+** happen every time: with the render thread paused it asks for a frame,
+** rewrites a copy of SCENE (default scenes/showcase_primitives) with a
+** light, a material and a primitive added, reloads it, and only then lets
+** the frame be drawn. That frame must be the edited scene's, pixel for
+** pixel the same as a frame asked for afterwards; drawing the freed scene
+** shows up as a difference, a crash or a sanitizer report.
+**
+** Then it asks for another frame and, once it is being drawn, reloads the
+** file unchanged. The reload pauses the render thread, which cancels that
+** frame, and asks for none itself: the cancelled frame must still be
+** drawn in full.
+**
+** Runs on SDL's dummy video driver unless SDL_VIDEODRIVER is set, so no
+** display is needed. What the renderer prints goes to tests/out/
+** reload_test.log; exit status is 1 if the frames differ.
+*/
+
+#include "rt.h"
+#include <sched.h>
+#include <sys/stat.h>
+
+/* The renderer defines these in main.c. */
+t_stats							g_stats;
+_Thread_local t_thread_stats	g_tls_stats;
+_Atomic size_t					g_frame_gen;
+
+#define TEST_SCENE	"tests/out/reload_test.scene"
+#define TEST_LOG	"tests/out/reload_test.log"
+
+/*
+** copy_scene -- Copy the scene from to TEST_SCENE, followed by extra, by
+** way of a file renamed over it, as an editor saving it would.
+*/
+static void		copy_scene(const char *from, const char *extra)
+{
+	FILE	*in;
+	FILE	*out;
+	char	buf[4096];
+	size_t	n;
+
+	if (!(in = fopen(from, "r")) ||
+		!(out = fopen(TEST_SCENE ".new", "w")))
+	{
+		perror("reload_test");
+		exit(1);
+	}
+	while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+		fwrite(buf, 1, n, out);
+	fputs(extra, out);
+	fclose(in);
+	if (fclose(out) || rename(TEST_SCENE ".new", TEST_SCENE))
+	{
+		perror("reload_test");
+		exit(1);
+	}
+}
+
+/* frame -- Ask for a frame of the whole region and wait for it. */
+static void		frame(t_env *e)
+{
+	draw(e, e->region);
+	render_wait(e);
+}
+
+/*
+** cancel_frame -- Ask for a frame and, once the render thread has started
+** it, reload the unchanged scene, which cancels it. Wait for the frames
+** that follow.
+*/
+static void		cancel_frame(t_env *e)
+{
+	t_render	*r;
+
+	r = e->render;
+	draw(e, e->region);
+	pthread_mutex_lock(&r->lock);
+	while (r->pending)
+	{
+		pthread_mutex_unlock(&r->lock);
+		sched_yield();
+		pthread_mutex_lock(&r->lock);
+	}
+	pthread_mutex_unlock(&r->lock);
+	reload_scene(e);
+	render_wait(e);
+}
+
+/* count_diffs -- Pixels of the frame in e->img that differ from px. */
+static size_t	count_diffs(t_env *e, uint32_t *px)
+{
+	size_t	n;
+	size_t	i;
+
+	n = 0;
+	i = -1;
+	while (++i < e->x * e->y)
+		if ((e->px[i] & 0xFFFFFF) != (px[i] & 0xFFFFFF))
+			++n;
+	return (n);
+}
+
+int				main(int ac, char **av)
+{
+	t_env		e;
+	uint32_t	*pending;
+	size_t		diffs;
+	size_t		cancelled;
+	char		*args[8];
+
+	memset(&g_stats, 0, sizeof(t_stats));
+	mkdir("tests/out", 0755);
+	if (!freopen(TEST_LOG, "w", stdout))
+	{
+		perror("reload_test: " TEST_LOG);
+		return (1);
+	}
+	setenv("SDL_VIDEODRIVER", "dummy", 0);
+	copy_scene(ac > 1 ? av[1] : "scenes/showcase_primitives", "");
+	args[0] = av[0];
+	args[1] = "--watch";
+	args[2] = "--size";
+	args[3] = "96";
+	args[4] = "54";
+	args[5] = "--super";
+	args[6] = "2";
+	args[7] = TEST_SCENE;
+	parse_options(&e, 8, args);
+	init_env(&e);
+	if (!e.render)
+	{
+		fputs("FAIL reload_test: no window, no render thread\n", stderr);
+		return (1);
+	}
+	frame(&e);
+	render_pause(&e);
+	draw(&e, e.region);
+	copy_scene(ac > 1 ? av[1] : "scenes/showcase_primitives",
+		"\tLIGHT\n\t\tLOC\t\t\t2 -12 4\n\t\tCOLOUR\t\tFFFFFF\n"
+		"\t\tINTENSITY\t0.7\n\t\tHALF\t\t40\n\n"
+		"\tMATERIAL\n\t\tNAME\t\treload_test\n\t\tDIFFUSE\t\t22CC44 1.0\n\n"
+		"\tPRIMITIVE\n\t\tTYPE\t\tsphere\n\t\tLOC\t\t\t0 -6 3\n"
+		"\t\tRADIUS\t\t1.5\n\t\tMATERIAL\treload_test\n\n");
+	reload_scene(&e);
+	render_resume(&e);
+	render_wait(&e);
+	if (!(pending = (uint32_t *)malloc(e.x * e.y * sizeof(uint32_t))))
+		err(MALLOC_ERROR, "reload_test", &e);
+	memcpy(pending, e.px, e.x * e.y * sizeof(uint32_t));
+	frame(&e);
+	diffs = count_diffs(&e, pending);
+	fprintf(stderr, "%-4s reload_test: %zu pixels differ from the edited "
+		"scene\n", diffs ? "FAIL" : "ok", diffs);
+	memcpy(pending, e.px, e.x * e.y * sizeof(uint32_t));
+	cancel_frame(&e);
+	cancelled = count_diffs(&e, pending);
+	free(pending);
+	fprintf(stderr, "%-4s reload_test: %zu pixels differ after a frame "
+		"cancelled by a reload\n", cancelled ? "FAIL" : "ok", cancelled);
+	if (diffs || cancelled)
+	{
+		render_stop(&e);
+		return (1);
+	}
+	exit_rt(&e, 0);
+	return (0);
+}